@@ -0,0 +1,96 @@
+"""Measure response header serialization throughput.
+
+Starts a velocem server in a child process whose app returns a configurable
+number of response headers, then drives it over a single pipelined keep-alive
+connection and reports requests per second. Header values can be made long to
+stress value validation, and --vary defeats the header block cache so the
+full validation path is measured.
+"""
+
+import argparse
+import itertools
+import multiprocessing
+import socket
+import time
+
+import velocem
+
+REQUEST = b'GET / HTTP/1.1\r\nHost: localhost\r\n\r\n'
+
+
+def make_app(count, length, vary):
+  value = 'v' * length
+  headers = [(f'X-Bench-{i}', value) for i in range(count)]
+  counter = itertools.count()
+
+  def app(environ, start_response):
+    hdrs = headers
+    if vary:
+      hdrs = headers + [('X-Request', str(next(counter)))]
+    start_response('200 OK', hdrs)
+    return b''
+
+  return app
+
+
+def serve(port, count, length, vary):
+  velocem.wsgi(make_app(count, length, vary), port=str(port))
+
+
+def wait_for_server(port):
+  while True:
+    try:
+      socket.create_connection(('localhost', port)).close()
+    except OSError:
+      time.sleep(0.1)
+    else:
+      return
+
+
+def drive(port, requests, depth):
+  s = socket.create_connection(('localhost', port))
+  s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+  batch = REQUEST * depth
+  buf = b''
+  start = time.perf_counter()
+  for _ in range(requests // depth):
+    s.sendall(batch)
+    seen = 0
+    while seen < depth:
+      buf += s.recv(1 << 16)
+      seen += buf.count(b'\r\n\r\n')
+      buf = buf[buf.rfind(b'\r\n\r\n') + 4:]
+  elapsed = time.perf_counter() - start
+  s.close()
+  return (requests // depth * depth) / elapsed
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('-n', '--requests', type=int, default=200000)
+  parser.add_argument('-c', '--count', type=int, default=8,
+                      help='headers per response')
+  parser.add_argument('-l', '--length', type=int, default=32,
+                      help='bytes per header value')
+  parser.add_argument('-d', '--depth', type=int, default=16,
+                      help='pipelined requests per batch')
+  parser.add_argument('--vary', action='store_true',
+                      help='add a per-request header to miss the cache')
+  parser.add_argument('-p', '--port', type=int, default=8011)
+  args = parser.parse_args()
+
+  proc = multiprocessing.Process(target=serve, args=(args.port, args.count,
+                                                     args.length, args.vary))
+  proc.start()
+  try:
+    wait_for_server(args.port)
+    drive(args.port, args.requests // 10, args.depth)
+    rps = drive(args.port, args.requests, args.depth)
+    print(f'headers/resp: {args.count} x {args.length} bytes')
+    print(f'requests/sec: {rps:.0f}')
+  finally:
+    proc.kill()
+
+
+if __name__ == '__main__':
+  main()
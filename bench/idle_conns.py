@@ -0,0 +1,93 @@
+"""Report resident memory per idle keep-alive connection.
+
+Starts a velocem server in a child process, opens a batch of keep-alive
+connections which each complete one request and then sit idle, and divides
+the growth in the server's RSS by the number of connections.
+
+RSS is read from /proc, so this only runs on Linux.
+"""
+
+import argparse
+import multiprocessing
+import socket
+import time
+
+import velocem
+
+REQUEST = b'GET / HTTP/1.1\r\nHost: localhost\r\n\r\n'
+
+
+def app(environ, start_response):
+  start_response('200 OK', [])
+  return b''
+
+
+def serve(port):
+  velocem.wsgi(app, port=str(port))
+
+
+def rss(pid):
+  with open(f'/proc/{pid}/status') as f:
+    for line in f:
+      if line.startswith('VmRSS:'):
+        return int(line.split()[1]) * 1024
+  raise RuntimeError('VmRSS not found')
+
+
+def wait_for_server(port):
+  while True:
+    try:
+      socket.create_connection(('localhost', port)).close()
+    except OSError:
+      time.sleep(0.1)
+    else:
+      return
+
+
+def open_idle(port, count):
+  conns = []
+  for _ in range(count):
+    s = socket.create_connection(('localhost', port))
+    s.sendall(REQUEST)
+    resp = b''
+    while not resp.endswith(b'\r\n\r\n'):
+      resp += s.recv(4096)
+    conns.append(s)
+  return conns
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('-n', '--connections', type=int, default=5000)
+  parser.add_argument('-p', '--port', type=int, default=8010)
+  parser.add_argument('--warmup', type=int, default=100)
+  args = parser.parse_args()
+
+  proc = multiprocessing.Process(target=serve, args=(args.port,))
+  proc.start()
+  try:
+    wait_for_server(args.port)
+
+    # Prime the pools and allocator so they don't count against the batch
+    for s in open_idle(args.port, args.warmup):
+      s.close()
+    time.sleep(0.5)
+
+    before = rss(proc.pid)
+    conns = open_idle(args.port, args.connections)
+    time.sleep(0.5)
+    after = rss(proc.pid)
+
+    print(f'connections:     {len(conns)}')
+    print(f'rss before:      {before} bytes')
+    print(f'rss after:       {after} bytes')
+    print(f'bytes/idle conn: {(after-before) / len(conns):.1f}')
+
+    for s in conns:
+      s.close()
+  finally:
+    proc.kill()
+
+
+if __name__ == '__main__':
+  main()
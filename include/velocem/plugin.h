@@ -0,0 +1,144 @@
+#ifndef VELOCEM_PLUGIN_H
+#define VELOCEM_PLUGIN_H
+
+/*
+ * Native request handler plugins.
+ *
+ * A plugin is a shared library exporting velocem_plugin_init(), passed to
+ * velocem.wsgi() or velocem.http() in the plugins keyword argument. The init
+ * function registers handlers for exact paths or path prefixes, requests
+ * matching one are handed to it as soon as they're parsed, before the Python
+ * app is consulted.
+ *
+ * Handlers run on the server thread, with the GIL held but without any Python
+ * objects having been created for the request. They must not block and must
+ * not call into Python. Everything a handler receives is only valid until it
+ * returns.
+ *
+ * Requests whose bodies were large enough to be spilled to disk, see the
+ * body_spill argument, are never offered to plugins. They go straight to the
+ * Python app, so a handler's body is always complete and in memory.
+ *
+ * Only the functions in velocem_host are provided by the server, plugins
+ * don't link against it. The ABI version is bumped whenever a struct in this
+ * file changes incompatibly, plugins built against another version are
+ * refused. A minimal plugin:
+ *
+ *   #include <velocem/plugin.h>
+ *
+ *   VELOCEM_PLUGIN_DECLARE
+ *
+ *   static int pong(void* ctx, const velocem_request* req,
+ *       velocem_response* resp) {
+ *     const velocem_host* host = ctx;
+ *     host->add_header(resp, "Content-Type", 12, "text/plain", 10);
+ *     host->write(resp, "pong", 4);
+ *     return VELOCEM_HANDLED;
+ *   }
+ *
+ *   int velocem_plugin_init(const velocem_host* host, velocem_registrar* reg) {
+ *     return host->add_route(reg, "GET", "/ping", 0, pong, (void*) host);
+ *   }
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VELOCEM_PLUGIN_ABI_VERSION 1
+
+#if defined(_WIN32)
+#define VELOCEM_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define VELOCEM_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* Handler return values */
+#define VELOCEM_HANDLED 0  /* The response is complete */
+#define VELOCEM_DECLINED 1 /* Discard the response, pass to the Python app */
+/* Any other value discards the response and answers 500 */
+
+typedef struct velocem_str {
+  const char* data;
+  size_t len;
+} velocem_str;
+
+/* Names are in their CGI form, "HTTP_USER_AGENT", as seen in a WSGI environ */
+typedef struct velocem_header {
+  velocem_str name;
+  velocem_str value;
+} velocem_header;
+
+typedef struct velocem_request {
+  velocem_str method;
+  velocem_str path;  /* Percent-decoded */
+  velocem_str query; /* Raw, empty if there wasn't one */
+  int http_minor;
+  int keep_alive;
+  const velocem_header* headers;
+  size_t header_count;
+  velocem_str body; /* Complete, however it was transferred, never spilled */
+} velocem_request;
+
+/* Response being built by a handler, status defaults to 200 */
+typedef struct velocem_response velocem_response;
+
+typedef int (*velocem_handler)(void* ctx, const velocem_request* req,
+    velocem_response* resp);
+
+/* Registration handle, only valid during velocem_plugin_init() */
+typedef struct velocem_registrar velocem_registrar;
+
+#define VELOCEM_ANY_METHOD NULL
+
+typedef struct velocem_host {
+  uint32_t abi_version;
+
+  /*
+   * Routes path, or with prefix set every path starting with it, for method
+   * ("GET", "POST", ...) or any method. Exact paths are tried first, then the
+   * longest matching prefix. Returns 0, or -1 if the route was already taken.
+   */
+  int (*add_route)(velocem_registrar* reg, const char* method,
+      const char* path, int prefix, velocem_handler handler, void* ctx);
+
+  /* Value of the named request header, "User-Agent", or a NULL data pointer */
+  velocem_str (*header)(const velocem_request* req, const char* name);
+
+  /* Any three digit code, the reason phrase is supplied for known ones */
+  void (*set_status)(velocem_response* resp, int status);
+
+  /*
+   * Content-Length, Date, Server and Connection are owned by the server and
+   * ignored. Returns 0, or -1 for an invalid name or value.
+   */
+  int (*add_header)(velocem_response* resp, const char* name, size_t name_len,
+      const char* value, size_t value_len);
+
+  /* Appends to the body, which is dropped for HEAD requests */
+  void (*write)(velocem_response* resp, const void* data, size_t len);
+} velocem_host;
+
+/*
+ * Called once when the plugin is loaded. Returns 0, anything else fails the
+ * server start. The host table outlives the plugin and may be kept.
+ */
+VELOCEM_PLUGIN_EXPORT int velocem_plugin_init(const velocem_host* host,
+    velocem_registrar* reg);
+
+/* Defined by VELOCEM_PLUGIN_DECLARE, checked before init is called */
+VELOCEM_PLUGIN_EXPORT uint32_t velocem_plugin_abi(void);
+
+#define VELOCEM_PLUGIN_DECLARE                                                 \
+  uint32_t velocem_plugin_abi(void) {                                          \
+    return VELOCEM_PLUGIN_ABI_VERSION;                                         \
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VELOCEM_PLUGIN_H */
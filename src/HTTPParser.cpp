@@ -15,6 +15,18 @@
 
 namespace velocem {
 
+const llhttp_settings_t HTTPParser::settings_ {
+    .on_url = on_url_tr,
+    .on_header_field = on_header_field_tr,
+    .on_header_value = on_header_value_tr,
+    .on_headers_complete = on_headers_complete_tr,
+    .on_body = on_body_tr,
+    .on_message_complete = on_message_complete_tr,
+    .on_url_complete = on_url_complete_tr,
+    .on_header_field_complete = on_header_field_complete_tr,
+    .on_header_value_complete = on_header_value_complete_tr,
+};
+
 HTTPParser::HTTPParser() {
   llhttp_init(static_cast<llhttp_t*>(this), HTTP_REQUEST, &settings_);
 }
@@ -25,18 +37,12 @@ HTTPParser::HTTPParser(WSGIRequest* req) : req_ {req} {
 
 void HTTPParser::reset(WSGIRequest* request) {
   req_ = request;
+  url_state_ = UrlState::Start;
+  in_field_ = false;
+  in_value_ = false;
+  skip_value_ = false;
   done_ = false;
   keep_alive_ = false;
-  settings_ = {
-      .on_url = on_url_tr,
-      .on_header_field = on_header_field_tr,
-      .on_header_value = on_header_value_tr,
-      .on_body = on_body_tr,
-      .on_message_complete = on_message_complete_tr,
-      .on_url_complete = on_url_complete_tr,
-      .on_header_field_complete = on_header_field_complete_tr,
-      .on_header_value_complete = on_header_value_complete_tr,
-  };
 }
 
 llhttp_errno_t HTTPParser::parse(asio::mutable_buffer buffer) {
@@ -44,6 +50,7 @@ llhttp_errno_t HTTPParser::parse(asio::mutable_buffer buffer) {
 }
 
 llhttp_errno_t HTTPParser::parse(char* data, std::size_t len) {
+  parse_end_ = data + len;
   auto ret {llhttp_execute(static_cast<llhttp_t*>(this), data, len)};
   if(ret != HPE_OK && ret != HPE_PAUSED)
     throw std::runtime_error {"HTTP error"};
@@ -72,24 +79,44 @@ bool HTTPParser::keep_alive() {
   return keep_alive_;
 }
 
-std::span<char> HTTPParser::get_rem(std::size_t offset) {
+std::span<char> HTTPParser::get_rem() {
   const char* endp = llhttp_get_error_pos(static_cast<llhttp_t*>(this));
-  const char* used = req_->buf_.data() + offset;
-  std::size_t dist = used - endp;
+  std::size_t dist = parse_end_ - endp;
   return {const_cast<char*>(endp), dist};
 }
 
 int HTTPParser::on_url(const char* at, std::size_t length) {
-  char* cur {(char*) std::memchr(at, '?', length)};
-  if(cur) {
-    std::ptrdiff_t inc {cur - at};
-    req_->url().from(const_cast<char*>(at), inc);
-    ++cur;
-    req_->query().from(cur, length - inc);
-    settings_.on_url = on_query_next_tr;
-  } else {
-    req_->url().from(const_cast<char*>(at), length);
-    settings_.on_url = on_url_next_tr;
+  switch(url_state_) {
+    case UrlState::Start: {
+      char* cur {(char*) std::memchr(at, '?', length)};
+      if(cur) {
+        std::ptrdiff_t inc {cur - at};
+        req_->url().from(const_cast<char*>(at), inc);
+        ++cur;
+        req_->query().from(cur, length - inc - 1);
+        url_state_ = UrlState::Query;
+      } else {
+        req_->url().from(const_cast<char*>(at), length);
+        url_state_ = UrlState::Path;
+      }
+    } break;
+
+    case UrlState::Path: {
+      char* cur {(char*) std::memchr(at, '?', length)};
+      if(cur) {
+        std::ptrdiff_t inc {cur - at};
+        req_->url().extend(inc);
+        ++cur;
+        req_->query().from(cur, length - inc - 1);
+        url_state_ = UrlState::Query;
+      } else {
+        req_->url().extend(length);
+      }
+    } break;
+
+    case UrlState::Query:
+      req_->query().extend(length);
+      break;
   }
   return 0;
 }
@@ -99,37 +126,8 @@ int HTTPParser::on_url_tr(llhttp_t* parser, const char* at,
   return static_cast<HTTPParser*>(parser)->on_url(at, length);
 }
 
-int HTTPParser::on_url_next(const char* at, std::size_t length) {
-  char* cur {(char*) std::memchr(at, '?', length)};
-  if(cur) {
-    std::ptrdiff_t inc {cur - at};
-    req_->url().extend(inc);
-    ++cur;
-    req_->query().from(cur, length - inc);
-    settings_.on_url = on_query_next_tr;
-  } else {
-    req_->url().extend(length);
-  }
-  return 0;
-}
-
-int HTTPParser::on_url_next_tr(llhttp_t* parser, const char* at,
-    std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_url_next(at, length);
-}
-
-int HTTPParser::on_query_next(const char*, std::size_t length) {
-  req_->query().extend(length);
-  return 0;
-}
-
-int HTTPParser::on_query_next_tr(llhttp_t* parser, const char* at,
-    std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_query_next(at, length);
-}
-
 int HTTPParser::on_url_complete() {
-  settings_.on_url = on_url_tr;
+  url_state_ = UrlState::Start;
   return req_->process_url();
 }
 
@@ -138,8 +136,12 @@ int HTTPParser::on_url_complete_tr(llhttp_t* parser) {
 }
 
 int HTTPParser::on_header_field(const char* at, std::size_t length) {
-  req_->next_header(const_cast<char*>(at), length);
-  settings_.on_header_field = on_header_field_next_tr;
+  if(in_field_) {
+    req_->last_header().extend(length);
+  } else {
+    req_->next_header(const_cast<char*>(at), length);
+    in_field_ = true;
+  }
   return 0;
 }
 
@@ -148,21 +150,9 @@ int HTTPParser::on_header_field_tr(llhttp_t* parser, const char* at,
   return static_cast<HTTPParser*>(parser)->on_header_field(at, length);
 }
 
-int HTTPParser::on_header_field_next(const char*, std::size_t length) {
-  req_->last_header().extend(length);
-  return 0;
-}
-
-int HTTPParser::on_header_field_next_tr(llhttp_t* parser, const char* at,
-    std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_header_field_next(at, length);
-}
-
 int HTTPParser::on_header_field_complete() {
-  if(!req_->process_header()) {
-    settings_.on_header_value = nullptr;
-  }
-  settings_.on_header_field = on_header_field_tr;
+  skip_value_ = !req_->process_header();
+  in_field_ = false;
   return 0;
 }
 
@@ -171,8 +161,15 @@ int HTTPParser::on_header_field_complete_tr(llhttp_t* parser) {
 }
 
 int HTTPParser::on_header_value(const char* at, std::size_t length) {
-  req_->next_value(const_cast<char*>(at), length);
-  settings_.on_header_value = on_header_value_next_tr;
+  if(skip_value_)
+    return 0;
+
+  if(in_value_) {
+    req_->last_value().extend(length);
+  } else {
+    req_->next_value(const_cast<char*>(at), length);
+    in_value_ = true;
+  }
   return 0;
 }
 
@@ -181,18 +178,9 @@ int HTTPParser::on_header_value_tr(llhttp_t* parser, const char* at,
   return static_cast<HTTPParser*>(parser)->on_header_value(at, length);
 }
 
-int HTTPParser::on_header_value_next(const char*, std::size_t length) {
-  req_->last_value().extend(length);
-  return 0;
-}
-
-int HTTPParser::on_header_value_next_tr(llhttp_t* parser, const char* at,
-    std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_header_value_next(at, length);
-}
-
 int HTTPParser::on_header_value_complete() {
-  settings_.on_header_value = on_header_value_tr;
+  in_value_ = false;
+  skip_value_ = false;
   return 0;
 }
 
@@ -200,31 +188,30 @@ int HTTPParser::on_header_value_complete_tr(llhttp_t* parser) {
   return static_cast<HTTPParser*>(parser)->on_header_value_complete();
 }
 
-int HTTPParser::on_body(const char* at, std::size_t length) {
-  req_->input_.set_body(const_cast<char*>(at), length);
-  settings_.on_body = on_body_next_tr;
+int HTTPParser::on_headers_complete() {
+  if((flags & F_CONTENT_LENGTH) && !(flags & F_CHUNKED) && content_length)
+    req_->expect_body(content_length);
   return 0;
 }
 
-int HTTPParser::on_body_tr(llhttp_t* parser, const char* at,
-    std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_body(at, length);
+int HTTPParser::on_headers_complete_tr(llhttp_t* parser) {
+  return static_cast<HTTPParser*>(parser)->on_headers_complete();
 }
 
-int HTTPParser::on_body_next(const char*, std::size_t length) {
-  req_->input_.extend_body(length);
-  return 0;
+int HTTPParser::on_body(const char* at, std::size_t length) {
+  return req_->append_body(const_cast<char*>(at), length) ? 0 : -1;
 }
 
-int HTTPParser::on_body_next_tr(llhttp_t* parser, const char* at,
+int HTTPParser::on_body_tr(llhttp_t* parser, const char* at,
     std::size_t length) {
-  return static_cast<HTTPParser*>(parser)->on_body_next(at, length);
+  return static_cast<HTTPParser*>(parser)->on_body(at, length);
 }
 
 int HTTPParser::on_message_complete() {
+  if(!req_->finish_body()) [[unlikely]]
+    return -1;
   done_ = true;
   keep_alive_ = llhttp_should_keep_alive(static_cast<llhttp_t*>(this));
-  settings_.on_body = on_body_tr;
   return keep_alive_ ? HPE_PAUSED : 0;
 }
 
@@ -33,20 +33,12 @@ struct HTTPParser : llhttp_t {
 
   bool keep_alive();
 
-  std::span<char> get_rem(std::size_t offset);
+  std::span<char> get_rem();
 
 private:
   int on_url(const char* at, std::size_t length);
   static int on_url_tr(llhttp_t* parser, const char* at, std::size_t length);
 
-  int on_url_next(const char* at, std::size_t length);
-  static int on_url_next_tr(llhttp_t* parser, const char* at,
-      std::size_t length);
-
-  int on_query_next(const char*, std::size_t length);
-  static int on_query_next_tr(llhttp_t* parser, const char* at,
-      std::size_t length);
-
   int on_url_complete();
   static int on_url_complete_tr(llhttp_t* parser);
 
@@ -54,10 +46,6 @@ private:
   static int on_header_field_tr(llhttp_t* parser, const char* at,
       std::size_t length);
 
-  int on_header_field_next(const char*, std::size_t length);
-  static int on_header_field_next_tr(llhttp_t* parser, const char* at,
-      std::size_t length);
-
   int on_header_field_complete();
   static int on_header_field_complete_tr(llhttp_t* parser);
 
@@ -65,37 +53,36 @@ private:
   static int on_header_value_tr(llhttp_t* parser, const char* at,
       std::size_t length);
 
-  int on_header_value_next(const char*, std::size_t length);
-  static int on_header_value_next_tr(llhttp_t* parser, const char* at,
-      std::size_t length);
-
   int on_header_value_complete();
   static int on_header_value_complete_tr(llhttp_t* parser);
 
+  int on_headers_complete();
+  static int on_headers_complete_tr(llhttp_t* parser);
+
   int on_body(const char* at, std::size_t length);
   static int on_body_tr(llhttp_t* parser, const char* at, std::size_t length);
 
-  int on_body_next(const char*, std::size_t length);
-  static int on_body_next_tr(llhttp_t* parser, const char* at,
-      std::size_t length);
-
   int on_message_complete();
   static int on_message_complete_tr(llhttp_t* parser);
 
-  llhttp_settings_t settings_ {
-      .on_url = on_url_tr,
-      .on_header_field = on_header_field_tr,
-      .on_header_value = on_header_value_tr,
-      .on_body = on_body_tr,
-      .on_message_complete = on_message_complete_tr,
-      .on_url_complete = on_url_complete_tr,
-      .on_header_field_complete = on_header_field_complete_tr,
-      .on_header_value_complete = on_header_value_complete_tr,
+  // Shared by every parser, per-parser progress is tracked in the state
+  // fields below rather than by swapping out callbacks
+  static const llhttp_settings_t settings_;
+
+  enum class UrlState : unsigned char {
+    Start,
+    Path,
+    Query,
   };
 
+  UrlState url_state_ {UrlState::Start};
+  bool in_field_ {false};
+  bool in_value_ {false};
+  bool skip_value_ {false};
   bool done_ {false};
   bool keep_alive_ {false};
   WSGIRequest* req_;
+  const char* parse_end_ {nullptr};
 };
 
 } // namespace velocem
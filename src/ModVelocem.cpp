@@ -1,5 +1,8 @@
 #include <Python.h>
 
+#include "form/Multipart.hpp"
+#include "http/Request.hpp"
+#include "http/Response.hpp"
 #include "util/Constants.hpp"
 #include "wsgi/Server.hpp"
 
@@ -8,6 +11,14 @@ namespace {
 PyMethodDef VelocemMethods[] {
     {"wsgi", (PyCFunction) velocem::run_wsgi_server,
         METH_FASTCALL | METH_KEYWORDS},
+    {"http", (PyCFunction) velocem::run_http_server,
+        METH_FASTCALL | METH_KEYWORDS},
+    {"json_response", (PyCFunction) velocem::json_response,
+        METH_FASTCALL | METH_KEYWORDS},
+    {"json_body", (PyCFunction) velocem::json_body, METH_O},
+    {"parse_multipart", (PyCFunction) velocem::parse_multipart,
+        METH_FASTCALL | METH_KEYWORDS},
+    {"pool_stats", (PyCFunction) velocem::pool_stats, METH_NOARGS},
     {0},
 };
 
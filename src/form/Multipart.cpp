@@ -0,0 +1,418 @@
+#include "Multipart.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Python.h>
+
+#define Py_BUILD_CORE
+#include <internal/pycore_modsupport.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VELOCEM_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VELOCEM_NEON
+#endif
+
+#include "http/Request.hpp"
+#include "util/Constants.hpp"
+#include "wsgi/Input.hpp"
+
+namespace velocem {
+
+namespace {
+
+// RFC 2046 limits boundaries to 70 characters
+constexpr std::size_t boundary_max {70};
+
+// Offset of needle in hay, or npos. Candidates are positions where both the
+// first and last byte of needle match, 16 at a time, and are then verified in
+// full. Delimiters start with CR, which is rare in most uploaded data.
+std::size_t find_delim(std::string_view hay, std::string_view needle) {
+  std::size_t n {needle.size()};
+  if(hay.size() < n)
+    return hay.npos;
+
+  auto p {reinterpret_cast<const unsigned char*>(hay.data())};
+  std::size_t last {hay.size() - n};
+  std::size_t i {0};
+
+#if defined(VELOCEM_SSE2)
+  const __m128i first {_mm_set1_epi8(needle.front())};
+  const __m128i final {_mm_set1_epi8(needle.back())};
+  for(; i + 16 <= last + 1; i += 16) {
+    __m128i a {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))};
+    __m128i b {
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + n - 1))};
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final)));
+    for(; mask; mask &= mask - 1) {
+      std::size_t at {i + std::countr_zero(mask)};
+      if(!std::memcmp(p + at + 1, needle.data() + 1, n - 2))
+        return at;
+    }
+  }
+#elif defined(VELOCEM_NEON)
+  const uint8x16_t first {vdupq_n_u8(needle.front())};
+  const uint8x16_t final {vdupq_n_u8(needle.back())};
+  for(; i + 16 <= last + 1; i += 16) {
+    uint8x16_t hit {vandq_u8(vceqq_u8(vld1q_u8(p + i), first),
+        vceqq_u8(vld1q_u8(p + i + n - 1), final))};
+    std::uint64_t mask {vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0)};
+    for(mask &= 0x8888888888888888ull; mask; mask &= mask - 1) {
+      std::size_t at {i + (std::countr_zero(mask) >> 2)};
+      if(!std::memcmp(p + at + 1, needle.data() + 1, n - 2))
+        return at;
+    }
+  }
+#endif
+
+  std::size_t at {hay.substr(i).find(needle)};
+  return at == hay.npos ? at : i + at;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  if(a.size() != b.size())
+    return false;
+  for(std::size_t i {0}; i < a.size(); ++i)
+    if((a[i] | 0x20) != (b[i] | 0x20))
+      return false;
+  return true;
+}
+
+std::string_view trim(std::string_view sv) {
+  while(!sv.empty() && (sv.front() == ' ' || sv.front() == '\t'))
+    sv.remove_prefix(1);
+  while(!sv.empty() && (sv.back() == ' ' || sv.back() == '\t'))
+    sv.remove_suffix(1);
+  return sv;
+}
+
+// Walks the ;-separated parameters of a header value, calling f(name, value)
+// with quoted values still escaped. Returns false if a quote is unterminated.
+template <typename F> bool for_each_param(std::string_view val, F f) {
+  std::size_t semi {val.find(';')};
+  if(semi == val.npos)
+    return true;
+  val.remove_prefix(semi + 1);
+
+  while(!val.empty()) {
+    std::size_t eq {val.find_first_of("=;")};
+    std::string_view name {trim(val.substr(0, eq))};
+    if(eq == val.npos || val[eq] == ';') {
+      val.remove_prefix(eq == val.npos ? val.size() : eq + 1);
+      continue;
+    }
+
+    val = trim(val.substr(eq + 1));
+    std::string_view pval;
+    if(!val.empty() && val.front() == '"') {
+      std::size_t i {1};
+      for(; i < val.size() && val[i] != '"'; ++i)
+        if(val[i] == '\\')
+          ++i;
+      if(i >= val.size())
+        return false;
+      pval = val.substr(1, i - 1);
+      val.remove_prefix(i + 1);
+    } else {
+      pval = trim(val.substr(0, val.find(';')));
+      val.remove_prefix(pval.size());
+    }
+    f(name, pval);
+
+    std::size_t next {val.find(';')};
+    val.remove_prefix(next == val.npos ? val.size() : next + 1);
+  }
+  return true;
+}
+
+const char* parse_part_headers(std::string_view headers, MultipartPart& part) {
+  bool disposition {false};
+  while(!headers.empty()) {
+    std::size_t eol {headers.find("\r\n")};
+    std::string_view line {headers.substr(0, eol)};
+    headers.remove_prefix(eol == headers.npos ? headers.size() : eol + 2);
+
+    std::size_t colon {line.find(':')};
+    if(colon == line.npos)
+      return "Malformed part header";
+    std::string_view name {line.substr(0, colon)};
+    std::string_view value {trim(line.substr(colon + 1))};
+
+    if(iequals(name, "content-disposition")) {
+      if(!iequals(trim(value.substr(0, value.find(';'))), "form-data"))
+        return "Part is not form-data";
+      disposition = true;
+      bool ok {for_each_param(value, [&](auto pname, auto pval) {
+        if(iequals(pname, "name")) {
+          part.name = pval;
+        } else if(iequals(pname, "filename")) {
+          part.filename = pval;
+          part.has_filename = true;
+        }
+      })};
+      if(!ok)
+        return "Unterminated quote in Content-Disposition";
+    } else if(iequals(name, "content-type")) {
+      part.content_type = value;
+    }
+  }
+
+  if(!disposition)
+    return "Part is missing Content-Disposition";
+  return nullptr;
+}
+
+} // namespace
+
+std::string_view multipart_boundary(std::string_view content_type) {
+  std::size_t semi {content_type.find(';')};
+  if(!iequals(trim(content_type.substr(0, semi)), "multipart/form-data"))
+    return {};
+
+  std::string_view boundary;
+  bool ok {for_each_param(content_type, [&](auto name, auto val) {
+    if(iequals(name, "boundary"))
+      boundary = val;
+  })};
+  if(!ok || boundary.empty() || boundary.size() > boundary_max ||
+      boundary.find('\\') != boundary.npos)
+    return {};
+  return boundary;
+}
+
+const char* split_multipart(std::string_view body, std::string_view boundary,
+    std::vector<MultipartPart>& parts, std::size_t max_parts) {
+  // Every delimiter but a first one at the very start of the body is
+  // preceded by CRLF, which belongs to the delimiter and not the part
+  std::string delim {"\r\n--"};
+  delim.append(boundary);
+
+  std::size_t pos;
+  std::string_view open {std::string_view {delim}.substr(2)};
+  if(body.starts_with(open)) {
+    pos = open.size();
+  } else {
+    pos = find_delim(body, delim);
+    if(pos == body.npos)
+      return "Multipart body has no boundary";
+    pos += delim.size();
+  }
+
+  for(;;) {
+    std::string_view rest {body.substr(pos)};
+    if(rest.starts_with("--"))
+      return nullptr;
+
+    // Transport padding may follow the boundary
+    std::size_t eol {rest.find("\r\n")};
+    if(eol == rest.npos || !trim(rest.substr(0, eol)).empty())
+      return "Malformed multipart boundary line";
+    pos += eol + 2;
+
+    std::size_t hdr_end {body.find("\r\n\r\n", pos)};
+    std::size_t data_begin;
+    std::string_view headers;
+    if(body.substr(pos).starts_with("\r\n")) {
+      // No headers at all, rejected below
+      data_begin = pos + 2;
+    } else if(hdr_end == body.npos) {
+      return "Unterminated part headers";
+    } else {
+      headers = body.substr(pos, hdr_end - pos);
+      data_begin = hdr_end + 4;
+    }
+
+    if(parts.size() == max_parts)
+      return "Too many multipart parts";
+    MultipartPart& part {parts.emplace_back()};
+    if(const char* err {parse_part_headers(headers, part)})
+      return err;
+
+    std::size_t end {find_delim(body.substr(data_begin), delim)};
+    if(end == body.npos)
+      return "Multipart body is missing its closing boundary";
+    part.data = body.substr(data_begin, end);
+    pos = data_begin + end + delim.size();
+  }
+}
+
+namespace {
+
+// Quoted-string contents with their backslash escapes removed
+PyObject* unquote(std::string_view sv) {
+  if(sv.find('\\') == sv.npos)
+    return PyUnicode_DecodeUTF8(sv.data(), sv.size(), "replace");
+
+  std::string out;
+  out.reserve(sv.size());
+  for(std::size_t i {0}; i < sv.size(); ++i) {
+    if(sv[i] == '\\' && i + 1 < sv.size())
+      ++i;
+    out.push_back(sv[i]);
+  }
+  return PyUnicode_DecodeUTF8(out.data(), out.size(), "replace");
+}
+
+// The object exporting the body, and its Content-Type if it carries one
+bool unpack_source(PyObject* src, PyObject*& body, PyObject*& ctype) {
+  body = nullptr;
+  ctype = nullptr;
+
+  if(Py_IS_TYPE(src, &gVT.HTTPRequestType)) {
+    ctype = PyObject_CallMethod(src, "header", "s", "Content-Type");
+    if(!ctype)
+      return false;
+    body = static_cast<HTTPRequest*>(src)->input();
+    return true;
+  }
+
+  if(!PyDict_Check(src)) {
+    body = Py_NewRef(src);
+    return true;
+  }
+
+  ctype = Py_XNewRef(PyDict_GetItemWithError(src, gPO.contype));
+  if(!ctype && PyErr_Occurred())
+    return false;
+
+  PyObject* input {PyDict_GetItemWithError(src, gPO.wsgi_input)};
+  if(!input) {
+    if(!PyErr_Occurred())
+      PyErr_SetString(PyExc_KeyError, "environ is missing wsgi.input");
+    return false;
+  }
+
+  // Velocem's input exports the whole body, which may be a mapping of the
+  // file it was spilled to. Any other stream is read.
+  if(Py_IS_TYPE(input, &gVT.WSGIInputType))
+    body = Py_NewRef(input);
+  else
+    body = PyObject_CallMethod(input, "read", nullptr);
+  return body;
+}
+
+PyObject* build_parts(const std::vector<MultipartPart>& parts,
+    PyObject* view, const char* base, Py_ssize_t max_field,
+    Py_ssize_t max_file) {
+  PyObject* list {PyList_New(parts.size())};
+  if(!list)
+    return nullptr;
+
+  for(std::size_t i {0}; i < parts.size(); ++i) {
+    const MultipartPart& part {parts[i]};
+    Py_ssize_t size {static_cast<Py_ssize_t>(part.data.size())};
+    Py_ssize_t limit {part.has_filename ? max_file : max_field};
+    if(limit >= 0 && size > limit) {
+      PyErr_Format(PyExc_ValueError, "Multipart %s exceeds %zd bytes",
+          part.has_filename ? "file" : "field", limit);
+      Py_DECREF(list);
+      return nullptr;
+    }
+
+    PyObject* value;
+    if(part.has_filename) {
+      Py_ssize_t off {part.data.data() - base};
+      value = PySequence_GetSlice(view, off, off + size);
+    } else {
+      value = PyUnicode_DecodeUTF8(part.data.data(), size, "replace");
+    }
+
+    PyObject* name {value ? unquote(part.name) : nullptr};
+    PyObject* filename {name && part.has_filename
+            ? unquote(part.filename)
+            : Py_NewRef(Py_None)};
+    PyObject* ctype {filename && !part.content_type.empty()
+            ? PyUnicode_DecodeUTF8(part.content_type.data(),
+                  part.content_type.size(), "replace")
+            : Py_NewRef(Py_None)};
+    PyObject* item {name && filename && ctype
+            ? PyTuple_Pack(4, name, filename, ctype, value)
+            : nullptr};
+    Py_XDECREF(value);
+    Py_XDECREF(name);
+    Py_XDECREF(filename);
+    Py_XDECREF(ctype);
+
+    if(!item) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  return list;
+}
+
+constexpr const char* _mp_keywords[] {"source", "content_type", "max_parts",
+    "max_field_size", "max_file_size", nullptr};
+_PyArg_Parser _mp_parser {.format = "O|O$nnn:parse_multipart",
+    .keywords = _mp_keywords};
+
+} // namespace
+
+PyObject* parse_multipart(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames) {
+  PyObject* src;
+  PyObject* ctype_arg {Py_None};
+  Py_ssize_t max_parts {1000};
+  Py_ssize_t max_field {Py_ssize_t {1} << 20};
+  Py_ssize_t max_file {-1};
+  if(!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &_mp_parser, &src,
+         &ctype_arg, &max_parts, &max_field, &max_file))
+    return nullptr;
+
+  PyObject* body;
+  PyObject* ctype;
+  if(!unpack_source(src, body, ctype)) {
+    Py_XDECREF(body);
+    Py_XDECREF(ctype);
+    return nullptr;
+  }
+  if(ctype_arg != Py_None)
+    Py_XSETREF(ctype, Py_NewRef(ctype_arg));
+
+  PyObject* ret {nullptr};
+  PyObject* view {nullptr};
+  std::string_view boundary;
+  const char* ct {nullptr};
+  Py_ssize_t ct_len;
+
+  if(!ctype || ctype == Py_None) {
+    PyErr_SetString(PyExc_ValueError, "No multipart Content-Type");
+  } else if((ct = PyUnicode_AsUTF8AndSize(ctype, &ct_len))) {
+    boundary = multipart_boundary({ct, static_cast<std::size_t>(ct_len)});
+    if(boundary.empty())
+      PyErr_SetString(PyExc_ValueError,
+          "Content-Type is not multipart/form-data with a boundary");
+    else
+      view = PyMemoryView_FromObject(body);
+  }
+
+  if(view) {
+    Py_buffer* buf {PyMemoryView_GET_BUFFER(view)};
+    auto base {static_cast<const char*>(buf->buf)};
+    std::vector<MultipartPart> parts;
+    const char* err {split_multipart({base, static_cast<std::size_t>(buf->len)},
+        boundary, parts, max_parts < 0 ? parts.max_size() : max_parts)};
+    if(err)
+      PyErr_SetString(PyExc_ValueError, err);
+    else
+      ret = build_parts(parts, view, base, max_field, max_file);
+    Py_DECREF(view);
+  }
+
+  Py_XDECREF(ctype);
+  Py_DECREF(body);
+  return ret;
+}
+
+} // namespace velocem
@@ -0,0 +1,43 @@
+#ifndef VELOCEM_FORM_MULTIPART_HPP
+#define VELOCEM_FORM_MULTIPART_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include <Python.h>
+
+namespace velocem {
+
+// One part of a multipart/form-data body. Everything points into the body,
+// name and filename are still quoted-string contents with their backslash
+// escapes in place.
+struct MultipartPart {
+  std::string_view name;
+  std::string_view filename;
+  std::string_view content_type;
+  std::string_view data;
+  bool has_filename;
+};
+
+// The boundary parameter of a multipart Content-Type, empty if there isn't a
+// usable one
+std::string_view multipart_boundary(std::string_view content_type);
+
+// Splits body into its parts, the preamble and epilogue are ignored. Returns
+// nullptr on success, or a description of what's malformed. Stops with an
+// error once max_parts would be exceeded.
+const char* split_multipart(std::string_view body, std::string_view boundary,
+    std::vector<MultipartPart>& parts, std::size_t max_parts);
+
+// velocem.parse_multipart(source, content_type=None, *, max_parts=1000,
+// max_field_size=1048576, max_file_size=-1). source is a WSGI environ, a
+// velocem.Request or a bytes-like body. Returns a list of
+// (name, filename, content_type, value) tuples. Fields without a filename
+// have a str value, file values are memoryviews into the received body.
+PyObject* parse_multipart(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames);
+
+} // namespace velocem
+
+#endif // VELOCEM_FORM_MULTIPART_HPP
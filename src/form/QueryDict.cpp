@@ -0,0 +1,394 @@
+#include "QueryDict.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Python.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VELOCEM_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VELOCEM_NEON
+#endif
+
+#include "util/Constants.hpp"
+
+namespace velocem {
+
+namespace {
+
+using Pair = QueryDict::Pair;
+
+constexpr std::array<bool, 256> make_special_table() {
+  std::array<bool, 256> tbl {};
+  tbl['&'] = true;
+  tbl['='] = true;
+  tbl['%'] = true;
+  tbl['+'] = true;
+  return tbl;
+}
+
+constexpr auto special_table {make_special_table()};
+
+// Index of the first '&', '=', '%' or '+', or len
+std::size_t find_special(const unsigned char* p, std::size_t len) {
+  std::size_t i {0};
+
+#if defined(VELOCEM_SSE2)
+  const __m128i amp {_mm_set1_epi8('&')};
+  const __m128i eq {_mm_set1_epi8('=')};
+  const __m128i pct {_mm_set1_epi8('%')};
+  const __m128i plus {_mm_set1_epi8('+')};
+  for(; i + 16 <= len; i += 16) {
+    __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))};
+    __m128i hit {_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, eq))};
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, pct));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, plus));
+    if(unsigned mask = _mm_movemask_epi8(hit))
+      return i + std::countr_zero(mask);
+  }
+#elif defined(VELOCEM_NEON)
+  for(; i + 16 <= len; i += 16) {
+    uint8x16_t v {vld1q_u8(p + i)};
+    uint8x16_t hit {vorrq_u8(vceqq_u8(v, vdupq_n_u8('&')),
+        vceqq_u8(v, vdupq_n_u8('=')))};
+    hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8('%')));
+    hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8('+')));
+    std::uint64_t mask {vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0)};
+    if(mask)
+      return i + (std::countr_zero(mask) >> 2);
+  }
+#endif
+
+  for(; i < len; ++i)
+    if(special_table[p[i]])
+      return i;
+  return len;
+}
+
+void split_pairs(const char* data, std::size_t len, std::vector<Pair>& out) {
+  auto p {reinterpret_cast<const unsigned char*>(data)};
+
+  std::size_t start {0};
+  std::size_t eq {len};
+  bool key_esc {false};
+  bool val_esc {false};
+
+  auto finish {[&](std::size_t end) {
+    if(end != start) {
+      std::size_t key_end {eq < end ? eq : end};
+      std::size_t val {eq < end ? eq + 1 : end};
+      out.push_back({static_cast<std::uint32_t>(start),
+          static_cast<std::uint32_t>(key_end - start),
+          static_cast<std::uint32_t>(val),
+          static_cast<std::uint32_t>(end - val), key_esc, val_esc});
+    }
+    start = end + 1;
+    eq = len;
+    key_esc = val_esc = false;
+  }};
+
+  for(std::size_t i {0};; ++i) {
+    i += find_special(p + i, len - i);
+    if(i == len)
+      break;
+
+    switch(p[i]) {
+      case '&':
+        finish(i);
+        break;
+      case '=':
+        if(eq == len)
+          eq = i;
+        break;
+      default:
+        (eq == len ? key_esc : val_esc) = true;
+    }
+  }
+  finish(len);
+}
+
+int hex_value(unsigned char c) {
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// As urllib.parse.unquote_plus(), invalid escapes are kept as they are
+void unquote_plus(const char* p, std::size_t len, std::string& out) {
+  out.clear();
+  out.reserve(len);
+  for(std::size_t i {0}; i < len; ++i) {
+    char c {p[i]};
+    if(c == '+') {
+      c = ' ';
+    } else if(c == '%' && i + 2 < len) {
+      int hi {hex_value(p[i + 1])};
+      int lo {hex_value(p[i + 2])};
+      if(hi >= 0 && lo >= 0) {
+        c = static_cast<char>((hi << 4) | lo);
+        i += 2;
+      }
+    }
+    out.push_back(c);
+  }
+}
+
+PyObject* decode(const char* base, std::uint32_t off, std::uint32_t len,
+    bool escaped) {
+  if(!escaped)
+    return PyUnicode_DecodeUTF8(base + off, len, "replace");
+
+  std::string buf;
+  unquote_plus(base + off, len, buf);
+  return PyUnicode_DecodeUTF8(buf.data(), buf.size(), "replace");
+}
+
+bool unpack_key(PyObject* key, std::string_view& out) {
+  if(!PyUnicode_Check(key)) {
+    PyErr_SetString(PyExc_TypeError, "QueryDict keys must be str");
+    return false;
+  }
+
+  Py_ssize_t len;
+  const char* data {PyUnicode_AsUTF8AndSize(key, &len)};
+  if(!data)
+    return false;
+  out = {data, static_cast<std::size_t>(len)};
+  return true;
+}
+
+// Calls f with each pair whose decoded key is key, until f returns false
+template <typename F> void for_each_match(QueryDict* self, std::string_view key,
+    F f) {
+  const char* base {self->data()};
+  std::string scratch;
+  for(const Pair& pair : *self->pairs) {
+    std::string_view raw {base + pair.key, pair.key_len};
+    if(pair.key_escaped) {
+      // Decoding never lengthens a key
+      if(raw.size() < key.size())
+        continue;
+      unquote_plus(raw.data(), raw.size(), scratch);
+      raw = scratch;
+    }
+    if(raw == key && !f(pair))
+      return;
+  }
+}
+
+} // namespace
+
+QueryDict* QueryDict::create(PyObject* source) {
+  const char* data;
+  Py_ssize_t len;
+  Py_buffer view {};
+
+  if(PyUnicode_Check(source)) {
+    data = PyUnicode_AsUTF8AndSize(source, &len);
+    if(!data)
+      return nullptr;
+  } else {
+    if(PyObject_GetBuffer(source, &view, PyBUF_SIMPLE))
+      return nullptr;
+    data = static_cast<const char*>(view.buf);
+    len = view.len;
+  }
+
+  if(static_cast<std::size_t>(len) > std::numeric_limits<std::uint32_t>::max())
+      [[unlikely]] {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, "QueryDict source is too large");
+    return nullptr;
+  }
+
+  PyTypeObject* type {&gVT.QueryDictType};
+  auto self {reinterpret_cast<QueryDict*>(type->tp_alloc(type, 0))};
+  if(!self) {
+    PyBuffer_Release(&view);
+    return nullptr;
+  }
+
+  self->source = Py_NewRef(source);
+  self->view = view;
+  self->pairs = new std::vector<Pair>;
+  split_pairs(data, len, *self->pairs);
+  return self;
+}
+
+const char* QueryDict::data() {
+  if(view.obj)
+    return static_cast<const char*>(view.buf);
+  // Cached by the str, and kept current if it's a view into a request
+  return PyUnicode_AsUTF8(source);
+}
+
+PyObject* QueryDict::new_(PyTypeObject* /* type */, PyObject* args,
+    PyObject* kwds) {
+  static const char* kwlist[] {"source", nullptr};
+  PyObject* source {gPO.empty};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|O:QueryDict",
+         const_cast<char**>(kwlist), &source))
+    return nullptr;
+  return create(source);
+}
+
+void QueryDict::dealloc(QueryDict* self) {
+  delete self->pairs;
+  PyBuffer_Release(&self->view);
+  Py_DECREF(self->source);
+  Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* QueryDict::get(QueryDict* self, PyObject* const* args,
+    Py_ssize_t nargs) {
+  if(nargs < 1 || nargs > 2) {
+    PyErr_SetString(PyExc_TypeError, "get() takes a key and a default");
+    return nullptr;
+  }
+
+  std::string_view key;
+  if(!unpack_key(args[0], key))
+    return nullptr;
+
+  const Pair* found {nullptr};
+  for_each_match(self, key, [&](const Pair& pair) {
+    found = &pair;
+    return false;
+  });
+
+  if(!found)
+    return Py_NewRef(nargs == 2 ? args[1] : Py_None);
+  return decode(self->data(), found->val, found->val_len,
+      found->val_escaped);
+}
+
+PyObject* QueryDict::getlist(QueryDict* self, PyObject* key) {
+  std::string_view sv;
+  if(!unpack_key(key, sv))
+    return nullptr;
+
+  PyObject* list {PyList_New(0)};
+  if(!list)
+    return nullptr;
+
+  const char* base {self->data()};
+  bool ok {true};
+  for_each_match(self, sv, [&](const Pair& pair) {
+    PyObject* val {decode(base, pair.val, pair.val_len, pair.val_escaped)};
+    ok = val && !PyList_Append(list, val);
+    Py_XDECREF(val);
+    return ok;
+  });
+
+  if(!ok) {
+    Py_DECREF(list);
+    return nullptr;
+  }
+  return list;
+}
+
+PyObject* QueryDict::items(QueryDict* self, PyObject*) {
+  const char* base {self->data()};
+  PyObject* list {PyList_New(self->pairs->size())};
+  if(!list)
+    return nullptr;
+
+  for(std::size_t i {0}; i < self->pairs->size(); ++i) {
+    const Pair& pair {(*self->pairs)[i]};
+    PyObject* key {decode(base, pair.key, pair.key_len, pair.key_escaped)};
+    PyObject* val {
+        key ? decode(base, pair.val, pair.val_len, pair.val_escaped) : nullptr};
+    PyObject* item {val ? PyTuple_Pack(2, key, val) : nullptr};
+    Py_XDECREF(key);
+    Py_XDECREF(val);
+    if(!item) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  return list;
+}
+
+Py_ssize_t QueryDict::length(QueryDict* self) {
+  return self->pairs->size();
+}
+
+PyObject* QueryDict::subscript(QueryDict* self, PyObject* key) {
+  std::string_view sv;
+  if(!unpack_key(key, sv))
+    return nullptr;
+
+  const Pair* found {nullptr};
+  for_each_match(self, sv, [&](const Pair& pair) {
+    found = &pair;
+    return false;
+  });
+
+  if(!found) {
+    PyErr_SetObject(PyExc_KeyError, key);
+    return nullptr;
+  }
+  return decode(self->data(), found->val, found->val_len,
+      found->val_escaped);
+}
+
+int QueryDict::contains(QueryDict* self, PyObject* key) {
+  std::string_view sv;
+  if(!unpack_key(key, sv))
+    return -1;
+
+  bool found {false};
+  for_each_match(self, sv, [&](const Pair&) {
+    found = true;
+    return false;
+  });
+  return found;
+}
+
+void QueryDict::init_type(PyTypeObject* QueryDictType) {
+  static std::array<PyMethodDef, 4> meths {
+      PyMethodDef {"get", (PyCFunction) get, METH_FASTCALL},
+      {"getlist", (PyCFunction) getlist, METH_O},
+      {"items", (PyCFunction) items, METH_NOARGS},
+      {nullptr, nullptr},
+  };
+
+  static PyMappingMethods mapping {
+      .mp_length = (lenfunc) length,
+      .mp_subscript = (binaryfunc) subscript,
+  };
+
+  static PySequenceMethods sequence {
+      .sq_contains = (objobjproc) contains,
+  };
+
+  *QueryDictType = PyTypeObject {
+      .tp_name = "velocem.QueryDict",
+      .tp_basicsize = sizeof(QueryDict),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_as_sequence = &sequence,
+      .tp_as_mapping = &mapping,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_doc = "Lazily decoded multi-dict over a urlencoded query or form",
+      .tp_methods = meths.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(QueryDictType);
+}
+
+} // namespace velocem
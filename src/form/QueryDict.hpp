@@ -0,0 +1,60 @@
+#ifndef VELOCEM_FORM_QUERYDICT_HPP
+#define VELOCEM_FORM_QUERYDICT_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <Python.h>
+
+namespace velocem {
+
+// velocem.QueryDict(source), a read-only multi-dict over an
+// application/x-www-form-urlencoded query string or form body. source is a
+// str, such as QUERY_STRING, or any bytes-like object, such as wsgi.input.
+//
+// Construction only splits the source into pairs. Keys and values are
+// percent-decoded, '+' as a space, and decoded from UTF-8 when they're looked
+// up, so parameters the app never asks for cost nothing. Pairs without an '='
+// have an empty value, empty pairs are skipped.
+struct QueryDict : PyObject {
+  // Offsets into the source, which may move if it's a view into a request
+  // buffer
+  struct Pair {
+    std::uint32_t key;
+    std::uint32_t key_len;
+    std::uint32_t val;
+    std::uint32_t val_len;
+    bool key_escaped; // Contains '%' or '+'
+    bool val_escaped;
+  };
+
+  PyObject* source;
+  Py_buffer view; // Held for bytes-like sources
+  std::vector<Pair>* pairs;
+
+  // New QueryDict over source, which it keeps a reference to
+  static QueryDict* create(PyObject* source);
+
+  // Current address of the source's bytes
+  const char* data();
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* QueryDictType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(QueryDict* self);
+
+  static PyObject* get(QueryDict* self, PyObject* const* args,
+      Py_ssize_t nargs);
+  static PyObject* getlist(QueryDict* self, PyObject* key);
+  static PyObject* items(QueryDict* self, PyObject*);
+
+  static Py_ssize_t length(QueryDict* self);
+  static PyObject* subscript(QueryDict* self, PyObject* key);
+  static int contains(QueryDict* self, PyObject* key);
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_FORM_QUERYDICT_HPP
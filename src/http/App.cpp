@@ -0,0 +1,280 @@
+#include "App.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include <Python.h>
+
+#include "router/Router.hpp"
+#include "util/Constants.hpp"
+#include "util/HeaderCheck.hpp"
+#include "util/Json.hpp"
+#include "util/OutputBuffer.hpp"
+#include "util/Util.hpp"
+#include "wsgi/App.hpp"
+#include "wsgi/HeaderCache.hpp"
+#include "wsgi/Request.hpp"
+
+#include "Request.hpp"
+#include "Response.hpp"
+
+namespace velocem {
+
+namespace {
+
+[[noreturn]] void throw_py(PyObject* type, const char* msg) {
+  PyErr_SetString(type, msg);
+  throw std::runtime_error {"Python response error"};
+}
+
+void insert_status_code(OutputBuffer& buf, long status) {
+  if(status < 100 || status > 999) [[unlikely]]
+    throw_py(PyExc_ValueError, "Status must be a three digit int");
+
+  std::string_view line {common_status_line(static_cast<int>(status))};
+  if(!line.empty()) {
+    buf.append(line);
+  } else {
+    // The reason phrase is optional, but the space before it isn't
+    buf.append("HTTP/1.1 ");
+    buf.append_dec(status);
+    buf.append(" \r\n");
+  }
+}
+
+bool is_content_type(const char* name, std::size_t len) {
+  constexpr std::string_view ct {"content-type"};
+  if(len != ct.size())
+    return false;
+  for(std::size_t i {0}; i < len; ++i)
+    if((name[i] | 0x20) != ct[i])
+      return false;
+  return true;
+}
+
+// Content-Length, Date, Server and Connection belong to the server and are
+// dropped. Returns true for a Content-Type.
+bool insert_header(OutputBuffer& buf, PyObject* name, PyObject* value) {
+  const char* nbase;
+  Py_ssize_t nlen;
+  unpack_unicode(name, &nbase, &nlen, "Header names must be str objects");
+
+  switch(classify_header_name(nbase, nlen)) {
+    case HeaderName::Other:
+      break;
+    case HeaderName::Invalid:
+      throw_py(PyExc_ValueError, "Invalid header field name");
+    default:
+      return false;
+  }
+
+  const char* vbase;
+  Py_ssize_t vlen;
+  unpack_unicode(value, &vbase, &vlen, "Header values must be str objects");
+
+  // Nothing is committed until the value has been checked
+  buf.reserve(nlen + vlen + 4);
+  char* out {buf.tail()};
+  if(!copy_field_value(out + nlen + 2, vbase, vlen)) [[unlikely]]
+    throw_py(PyExc_ValueError,
+        "Header values must not contain control characters");
+  std::memcpy(out, nbase, nlen);
+  std::memcpy(out + nlen, ": ", 2);
+  std::memcpy(out + nlen + 2 + vlen, "\r\n", 2);
+  buf.commit(nlen + vlen + 4);
+  return is_content_type(nbase, nlen);
+}
+
+// Returns true if the headers included a Content-Type
+bool insert_headers(OutputBuffer& buf, PyObject* headers) {
+  if(headers == Py_None)
+    return false;
+
+  bool has_ct {false};
+  if(PyDict_Check(headers)) {
+    PyObject* name;
+    PyObject* value;
+    for(Py_ssize_t pos {0}; PyDict_Next(headers, &pos, &name, &value);)
+      has_ct |= insert_header(buf, name, value);
+    return has_ct;
+  }
+
+  if(!PyList_Check(headers) && !PyTuple_Check(headers)) [[unlikely]]
+    throw_py(PyExc_TypeError, "Headers must be a dict, list or None");
+
+  for(Py_ssize_t i {0}, end {PySequence_Fast_GET_SIZE(headers)}; i < end;
+      ++i) {
+    PyObject* pair {PySequence_Fast_GET_ITEM(headers, i)};
+    if(!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2) [[unlikely]]
+      throw_py(PyExc_TypeError, "Headers must be size two tuples");
+    has_ct |= insert_header(buf, PyTuple_GET_ITEM(pair, 0),
+        PyTuple_GET_ITEM(pair, 1));
+  }
+  return has_ct;
+}
+
+bool insert_head(OutputBuffer& buf, long status, PyObject* headers,
+    bool keepalive) {
+  insert_status_code(buf, status);
+  buf.append(gRequiredHeaders);
+  if(keepalive)
+    buf.append("Connection: keep-alive\r\n");
+  else
+    buf.append("Connection: close\r\n");
+  return insert_headers(buf, headers);
+}
+
+bool bodiless_status(long status) {
+  return status < 200 || status == 204 || status == 304;
+}
+
+} // namespace
+
+HTTPApp::HTTPApp(PyObject* app) : app_ {app} {
+  if(Router::check(app))
+    router_ = static_cast<Router*>(app);
+}
+
+WSGIAppRet* HTTPApp::run(WSGIRequest* req, int http_minor, int meth,
+    bool keepalive) {
+  PyObject* handler {app_};
+  PyObject* caps {nullptr};
+  if(router_) {
+    auto result {router_->tree->match(req->url().view(), meth, handler, caps_,
+        &allowed_)};
+    if(result != RouteTree::Result::Found) {
+      WSGIAppRet* ret {gAppRetPool.pop()};
+      Router::write_miss(ret->buf, result, allowed_, keepalive);
+      gRequestPool.push(req);
+      return ret;
+    }
+
+    caps = Router::captures(caps_);
+    if(!caps) [[unlikely]] {
+      PyErr_Print();
+      PyErr_Clear();
+      gRequestPool.push(req);
+      return nullptr;
+    }
+  }
+
+  // The request object is the only thing handed out, it holds the request
+  // alive until the handler and the response are done with it
+  HTTPRequest* pyreq {&req->native_};
+  pyreq->prepare(meth, http_minor);
+  pyreq->set_captures(caps);
+  Py_INCREF(pyreq);
+  req->adopt_refs();
+
+  PyObject* arg {pyreq};
+  PyObject* result {PyObject_Vectorcall(handler, &arg, 1, nullptr)};
+
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  bool ok {false};
+  if(result) [[likely]] {
+    try {
+      build_response(ret, result, keepalive,
+          meth == static_cast<int>(HTTPMethod::Head));
+      ok = true;
+    } catch(...) {
+    }
+    Py_DECREF(result);
+  }
+  Py_DECREF(pyreq);
+
+  if(!ok) [[unlikely]] {
+    PyErr_Print();
+    PyErr_Clear();
+    gAppRetPool.push(ret);
+    return nullptr;
+  }
+  return ret;
+}
+
+void HTTPApp::build_response(WSGIAppRet* ret, PyObject* result,
+    bool keepalive, bool head) {
+  long status {200};
+  PyObject* headers {Py_None};
+  PyObject* body {result};
+
+  if(HTTPResponse::check(result)) {
+    auto resp {static_cast<HTTPResponse*>(result)};
+    if(resp->json) {
+      build_json(ret, resp, keepalive, head);
+      return;
+    }
+    status = resp->status;
+    headers = resp->headers;
+    body = resp->body;
+  } else if(PyTuple_Check(result)) {
+    if(PyTuple_GET_SIZE(result) != 3) [[unlikely]]
+      throw_py(PyExc_TypeError,
+          "Handlers must return a (status, headers, body) tuple");
+    status = PyLong_AsLong(PyTuple_GET_ITEM(result, 0));
+    if(status == -1 && PyErr_Occurred()) [[unlikely]]
+      throw std::runtime_error {"Python response error"};
+    headers = PyTuple_GET_ITEM(result, 1);
+    body = PyTuple_GET_ITEM(result, 2);
+  }
+
+  OutputBuffer& buf {ret->buf};
+  insert_head(buf, status, headers, keepalive);
+
+  // These never have a body or a Content-Length
+  if(bodiless_status(status)) {
+    buf.append("\r\n");
+    return;
+  }
+
+  if(body == Py_None) {
+    insert_conlen(buf, 0);
+  } else if(PyUnicode_Check(body)) {
+    Py_ssize_t len;
+    const char* str {PyUnicode_AsUTF8AndSize(body, &len)};
+    if(!str) [[unlikely]]
+      throw std::runtime_error {"Python str object error"};
+    insert_conlen(buf, len);
+    if(!head)
+      buf.append(str, len);
+  } else {
+    PyBufferView& view {ret->body};
+    view.acquire(body, "Response body must be bytes-like, str or None");
+    insert_conlen(buf, view.size());
+    if(head || view.size() < body_view_min) {
+      if(!head)
+        buf.append(view.data(), view.size());
+      view.release();
+    }
+  }
+}
+
+// The body is serialized first, straight into the response buffer, and the
+// head is prepended once its Content-Length is known
+void HTTPApp::build_json(WSGIAppRet* ret, HTTPResponse* resp, bool keepalive,
+    bool head) {
+  OutputBuffer& buf {ret->buf};
+  bool bodiless {bodiless_status(resp->status)};
+  std::size_t len {0};
+  if(!bodiless) {
+    json_dump(resp->body, buf);
+    len = buf.size();
+    if(head)
+      buf.clear();
+  }
+
+  OutputBuffer& hdr {head_scratch_};
+  hdr.clear();
+  bool has_ct {insert_head(hdr, resp->status, resp->headers, keepalive)};
+  if(bodiless) {
+    hdr.append("\r\n");
+  } else {
+    if(!has_ct)
+      hdr.append("Content-Type: application/json\r\n");
+    insert_conlen(hdr, len);
+  }
+  buf.prepend(hdr.data(), hdr.size());
+}
+
+} // namespace velocem
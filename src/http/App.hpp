@@ -0,0 +1,56 @@
+#ifndef VELOCEM_HTTP_APP_HPP
+#define VELOCEM_HTTP_APP_HPP
+
+#include <vector>
+
+#include <Python.h>
+
+#include "router/RouteTree.hpp"
+#include "util/OutputBuffer.hpp"
+
+namespace velocem {
+struct HTTPResponse;
+struct Router;
+struct WSGIAppRet;
+struct WSGIRequest;
+} // namespace velocem
+
+namespace velocem {
+
+// Velocem's own interface. A handler is called with a single velocem.Request
+// and returns a velocem.Response, a (status, headers, body) tuple, or just a
+// body. Status is an int, headers are a dict or a list of (name, value) pairs
+// or None, and the body is bytes-like, str (sent as UTF-8) or None.
+//
+// Content-Length is always computed by the server. There's no environ, no
+// start_response() and no body iteration, the response is serialized straight
+// from the returned objects.
+struct HTTPApp {
+  explicit HTTPApp(PyObject* app);
+
+  HTTPApp(HTTPApp&) = delete;
+  HTTPApp(HTTPApp&&) = delete;
+
+  WSGIAppRet* run(WSGIRequest* req, int http_minor, int meth, bool keepalive);
+
+private:
+  void build_response(WSGIAppRet* ret, PyObject* result, bool keepalive,
+      bool head);
+  void build_json(WSGIAppRet* ret, HTTPResponse* resp, bool keepalive,
+      bool head);
+
+  // Head of a JSON response, written after its body
+  OutputBuffer head_scratch_;
+
+  // Set when the app is a velocem.Router, its handlers take the request and
+  // find their captures on it
+  Router* router_ {nullptr};
+  std::vector<RouteTree::Capture> caps_;
+  std::vector<int> allowed_;
+
+  PyObject* app_;
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_HTTP_APP_HPP
@@ -0,0 +1,200 @@
+#include "Request.hpp"
+
+#include <array>
+#include <cstddef>
+#include <ranges>
+#include <string_view>
+
+#include <Python.h>
+
+#define Py_BUILD_CORE
+#include <internal/pycore_modsupport.h>
+
+#include "form/QueryDict.hpp"
+#include "util/Constants.hpp"
+#include "util/HeaderCheck.hpp"
+#include "util/Json.hpp"
+#include "wsgi/Input.hpp"
+#include "wsgi/Request.hpp"
+
+namespace velocem {
+
+HTTPRequest::HTTPRequest(WSGIRequest* owner) : owner_ {owner} {
+  ob_refcnt = 0;
+  ob_type = &gVT.HTTPRequestType;
+}
+
+void HTTPRequest::prepare(int meth, int http_minor) {
+  meth_ = meth;
+  http_minor_ = http_minor;
+}
+
+void HTTPRequest::set_captures(PyObject* captures) {
+  Py_XSETREF(captures_, captures);
+}
+
+void HTTPRequest::reset() {
+  Py_CLEAR(captures_);
+}
+
+// The body is parsed where it was received, not copied into a bytes first
+PyObject* HTTPRequest::parse_json() {
+  char* begin {owner_->input_.body_begin()};
+  return json_load(begin, owner_->input_.body_end() - begin);
+}
+
+PyObject* HTTPRequest::input() {
+  return owner_->share(&owner_->input_);
+}
+
+void HTTPRequest::dealloc(HTTPRequest* self) {
+  self->owner_->release();
+}
+
+PyObject* HTTPRequest::get_method(HTTPRequest* self, void*) {
+  return Py_NewRef(gPO.methods[self->meth_]);
+}
+
+PyObject* HTTPRequest::get_path(HTTPRequest* self, void*) {
+  return self->owner_->share((PyObject*) &self->owner_->url());
+}
+
+PyObject* HTTPRequest::get_query(HTTPRequest* self, void*) {
+  if(!self->owner_->has_query())
+    return Py_NewRef(gPO.empty);
+  return self->owner_->share((PyObject*) &self->owner_->query());
+}
+
+PyObject* HTTPRequest::get_version(HTTPRequest* self, void*) {
+  return Py_NewRef(self->http_minor_ ? gPO.http11 : gPO.http10);
+}
+
+// Bodies received straight into a bytes object are handed out as-is
+PyObject* HTTPRequest::get_body(HTTPRequest* self, void*) {
+  WSGIRequest* req {self->owner_};
+  char* begin {req->input_.body_begin()};
+  char* end {req->input_.body_end()};
+  if(begin == end)
+    return Py_NewRef(gPO.empty_bytes);
+
+  if(req->body_ && end - begin == PyBytes_GET_SIZE(req->body_))
+    return Py_NewRef(req->body_);
+  return PyBytes_FromStringAndSize(begin, end - begin);
+}
+
+PyObject* HTTPRequest::get_captures(HTTPRequest* self, void*) {
+  if(!self->captures_)
+    Py_RETURN_NONE;
+  return Py_NewRef(self->captures_);
+}
+
+// Both are views over the request, holding it alive, and built on every
+// access. Caching them here would have the request hold itself.
+PyObject* HTTPRequest::get_params(HTTPRequest* self, void*) {
+  if(!self->owner_->has_query())
+    return QueryDict::create(gPO.empty);
+  PyObject* query {self->owner_->share((PyObject*) &self->owner_->query())};
+  PyObject* ret {QueryDict::create(query)};
+  Py_DECREF(query);
+  return ret;
+}
+
+PyObject* HTTPRequest::get_form(HTTPRequest* self, void*) {
+  PyObject* input {self->input()};
+  PyObject* ret {QueryDict::create(input)};
+  Py_DECREF(input);
+  return ret;
+}
+
+PyObject* HTTPRequest::header(HTTPRequest* self, PyObject* const* args,
+    Py_ssize_t nargs) {
+  PyObject* name;
+  PyObject* def {Py_None};
+  if(!_PyArg_ParseStack(args, nargs, "U|O:header", &name, &def))
+    return nullptr;
+
+  Py_ssize_t len;
+  const char* str {PyUnicode_AsUTF8AndSize(name, &len)};
+  if(!str)
+    return nullptr;
+  std::string_view sv {str, static_cast<std::size_t>(len)};
+
+  // Repeated headers resolve to the last one, as they do in the environ
+  for(auto& hdr : self->owner_->headers_ | std::views::reverse)
+    if(cgi_header_matches(hdr.field.view(), sv))
+      return self->owner_->share((PyObject*) &hdr.value);
+  return Py_NewRef(def);
+}
+
+PyObject* HTTPRequest::json(HTTPRequest* self, PyObject*) {
+  return self->parse_json();
+}
+
+void HTTPRequest::init_type(PyTypeObject* HTTPRequestType) {
+  static std::array<PyMethodDef, 3> meths {
+      PyMethodDef {"header", (PyCFunction) header, METH_FASTCALL},
+      {"json", (PyCFunction) json, METH_NOARGS},
+      {nullptr, nullptr},
+  };
+
+  static std::array<PyGetSetDef, 9> getset {
+      PyGetSetDef {"method", (getter) get_method},
+      {"path", (getter) get_path},
+      {"query", (getter) get_query},
+      {"version", (getter) get_version},
+      {"body", (getter) get_body},
+      {"captures", (getter) get_captures},
+      {"params", (getter) get_params},
+      {"form", (getter) get_form},
+      {nullptr},
+  };
+
+  *HTTPRequestType = PyTypeObject {
+      .tp_name = "velocem.Request",
+      .tp_basicsize = sizeof(HTTPRequest),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_doc = "HTTP request passed to velocem.http handlers",
+      .tp_methods = meths.data(),
+      .tp_getset = getset.data(),
+  };
+  PyType_Ready(HTTPRequestType);
+}
+
+PyObject* json_body(PyObject* /* self */, PyObject* obj) {
+  if(Py_IS_TYPE(obj, &gVT.HTTPRequestType))
+    return static_cast<HTTPRequest*>(obj)->parse_json();
+
+  if(!PyDict_Check(obj)) {
+    PyErr_SetString(PyExc_TypeError,
+        "json_body() takes a velocem.Request or a WSGI environ");
+    return nullptr;
+  }
+
+  PyObject* input {PyDict_GetItemWithError(obj, gPO.wsgi_input)};
+  if(!input) {
+    if(!PyErr_Occurred())
+      PyErr_SetString(PyExc_KeyError, "environ is missing wsgi.input");
+    return nullptr;
+  }
+
+  if(Py_IS_TYPE(input, &gVT.WSGIInputType))
+    return static_cast<WSGIInput*>(input)->parse_json();
+
+  // Any other stream, from another server or replaced by middleware
+  PyObject* data {PyObject_CallMethod(input, "read", nullptr)};
+  if(!data)
+    return nullptr;
+
+  Py_buffer view;
+  if(PyObject_GetBuffer(data, &view, PyBUF_SIMPLE)) {
+    Py_DECREF(data);
+    return nullptr;
+  }
+  PyObject* ret {json_load(static_cast<const char*>(view.buf), view.len)};
+  PyBuffer_Release(&view);
+  Py_DECREF(data);
+  return ret;
+}
+
+} // namespace velocem
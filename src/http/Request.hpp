@@ -0,0 +1,58 @@
+#ifndef VELOCEM_HTTP_REQUEST_HPP
+#define VELOCEM_HTTP_REQUEST_HPP
+
+#include <Python.h>
+
+namespace velocem {
+struct WSGIRequest;
+}
+
+namespace velocem {
+
+// velocem.Request, the request object handed to velocem.http handlers. It
+// lives inside the WSGIRequest and shares its refcount, attributes are views
+// into the parsed request rather than copies.
+struct HTTPRequest : PyObject {
+  HTTPRequest(WSGIRequest* owner);
+
+  void prepare(int meth, int http_minor);
+  void set_captures(PyObject* captures);
+  void reset();
+
+  PyObject* parse_json();
+
+  // New reference to the request's wsgi.input, which exports the body
+  PyObject* input();
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* HTTPRequestType);
+
+  static void dealloc(HTTPRequest* self);
+
+  static PyObject* get_method(HTTPRequest* self, void*);
+  static PyObject* get_path(HTTPRequest* self, void*);
+  static PyObject* get_query(HTTPRequest* self, void*);
+  static PyObject* get_version(HTTPRequest* self, void*);
+  static PyObject* get_body(HTTPRequest* self, void*);
+  static PyObject* get_captures(HTTPRequest* self, void*);
+  static PyObject* get_params(HTTPRequest* self, void*);
+  static PyObject* get_form(HTTPRequest* self, void*);
+
+  static PyObject* header(HTTPRequest* self, PyObject* const* args,
+      Py_ssize_t nargs);
+  static PyObject* json(HTTPRequest* self, PyObject*);
+
+  WSGIRequest* owner_;
+  PyObject* captures_ {nullptr};
+  int meth_ {0};
+  int http_minor_ {1};
+};
+
+// velocem.json_body(request_or_environ), the request body parsed as JSON. A
+// WSGI environ's wsgi.input is consumed.
+PyObject* json_body(PyObject* /* self */, PyObject* obj);
+
+} // namespace velocem
+
+#endif // VELOCEM_HTTP_REQUEST_HPP
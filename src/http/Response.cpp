@@ -0,0 +1,104 @@
+#include "Response.hpp"
+
+#include <array>
+#include <cstddef>
+
+#include <Python.h>
+
+#define Py_BUILD_CORE
+#include <internal/pycore_modsupport.h>
+
+#include "util/Constants.hpp"
+
+namespace velocem {
+
+bool HTTPResponse::check(PyObject* obj) {
+  return Py_IS_TYPE(obj, &gVT.HTTPResponseType);
+}
+
+PyObject* HTTPResponse::new_(PyTypeObject* /* type */, PyObject* args,
+    PyObject* kwds) {
+  static const char* kwlist[] {"body", "status", "headers", nullptr};
+  PyObject* body {gPO.empty_bytes};
+  int status {200};
+  PyObject* headers {Py_None};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|OiO:Response",
+         const_cast<char**>(kwlist), &body, &status, &headers))
+    return nullptr;
+
+  return create(body, status, headers);
+}
+
+HTTPResponse* HTTPResponse::create(PyObject* body, int status,
+    PyObject* headers) {
+  PyTypeObject* type {&gVT.HTTPResponseType};
+  auto self {reinterpret_cast<HTTPResponse*>(type->tp_alloc(type, 0))};
+  if(!self)
+    return nullptr;
+  self->status = status;
+  self->headers = Py_NewRef(headers);
+  self->body = Py_NewRef(body);
+  self->json = false;
+  return self;
+}
+
+void HTTPResponse::dealloc(HTTPResponse* self) {
+  Py_XDECREF(self->headers);
+  Py_XDECREF(self->body);
+  Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* HTTPResponse::get_status(HTTPResponse* self, void*) {
+  return PyLong_FromLong(self->status);
+}
+
+PyObject* HTTPResponse::get_headers(HTTPResponse* self, void*) {
+  return Py_NewRef(self->headers);
+}
+
+PyObject* HTTPResponse::get_body(HTTPResponse* self, void*) {
+  return Py_NewRef(self->body);
+}
+
+namespace {
+constexpr const char* _jr_keywords[] {"obj", "status", "headers", nullptr};
+_PyArg_Parser _jr_parser {.format = "O|iO:json_response",
+    .keywords = _jr_keywords};
+} // namespace
+
+PyObject* json_response(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames) {
+  PyObject* obj;
+  int status {200};
+  PyObject* headers {Py_None};
+  if(!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &_jr_parser, &obj,
+         &status, &headers))
+    return nullptr;
+
+  HTTPResponse* resp {HTTPResponse::create(obj, status, headers)};
+  if(resp)
+    resp->json = true;
+  return resp;
+}
+
+void HTTPResponse::init_type(PyTypeObject* HTTPResponseType) {
+  static std::array<PyGetSetDef, 4> getset {
+      PyGetSetDef {"status", (getter) get_status},
+      {"headers", (getter) get_headers},
+      {"body", (getter) get_body},
+      {nullptr},
+  };
+
+  *HTTPResponseType = PyTypeObject {
+      .tp_name = "velocem.Response",
+      .tp_basicsize = sizeof(HTTPResponse),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_doc = "HTTP response returned from velocem.http handlers",
+      .tp_getset = getset.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(HTTPResponseType);
+}
+
+} // namespace velocem
@@ -0,0 +1,40 @@
+#ifndef VELOCEM_HTTP_RESPONSE_HPP
+#define VELOCEM_HTTP_RESPONSE_HPP
+
+#include <Python.h>
+
+namespace velocem {
+
+// velocem.Response(body=b'', status=200, headers=None), a response returned
+// from a velocem.http handler. The fields are only validated when the
+// response is serialized.
+struct HTTPResponse : PyObject {
+  int status;
+  PyObject* headers;
+  PyObject* body;
+  bool json; // body is an object to serialize as JSON
+
+  static bool check(PyObject* obj);
+
+  static HTTPResponse* create(PyObject* body, int status, PyObject* headers);
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* HTTPResponseType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(HTTPResponse* self);
+
+  static PyObject* get_status(HTTPResponse* self, void*);
+  static PyObject* get_headers(HTTPResponse* self, void*);
+  static PyObject* get_body(HTTPResponse* self, void*);
+};
+
+// velocem.json_response(obj, status=200, headers=None). obj is serialized
+// when the response is, straight into the output buffer.
+PyObject* json_response(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames);
+
+} // namespace velocem
+
+#endif // VELOCEM_HTTP_RESPONSE_HPP
@@ -1,7 +1,105 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <stdexcept>
+#include <string>
 
-#include <asio.hpp>
+#include <asio/ip/tcp.hpp>
+
+#include "plat.hpp"
 
 int set_reuse_port(asio::ip::tcp::acceptor& sock) {
   throw std::logic_error {"SO_REUSEPORT unavailable on generic"};
 }
+
+void* alloc_slab(std::size_t size, bool /* huge */) {
+  return ::operator new(size, std::align_val_t {4096}, std::nothrow);
+}
+
+void* map_shared(std::size_t size) {
+  void* ptr {::operator new(size, std::align_val_t {4096}, std::nothrow)};
+  if(ptr)
+    std::memset(ptr, 0, size);
+  return ptr;
+}
+
+void unmap_shared(void* ptr, std::size_t /* size */) {
+  ::operator delete(ptr, std::align_val_t {4096});
+}
+
+// No mmap guarantees here, spill through stdio and read the file back in
+struct SpillFile {
+  std::FILE* file;
+  char* map {nullptr};
+};
+
+SpillFile* spill_open() {
+  std::FILE* file {std::tmpfile()};
+  if(!file)
+    return nullptr;
+  return new SpillFile {file};
+}
+
+bool spill_write(SpillFile* file, const char* data, std::size_t len) {
+  return std::fwrite(data, 1, len, file->file) == len;
+}
+
+char* spill_map(SpillFile* file, std::size_t len) {
+  auto ptr {static_cast<char*>(std::malloc(len))};
+  if(!ptr)
+    return nullptr;
+  std::rewind(file->file);
+  if(std::fread(ptr, 1, len, file->file) != len) {
+    std::free(ptr);
+    return nullptr;
+  }
+  file->map = ptr;
+  return ptr;
+}
+
+void spill_close(SpillFile* file) {
+  std::free(file->map);
+  std::fclose(file->file);
+  delete file;
+}
+
+std::int64_t file_size(int /* fd */) {
+  return -1;
+}
+
+std::ptrdiff_t read_at(int /* fd */, char* /* buf */, std::size_t /* len */,
+    std::uint64_t /* off */) {
+  return -1;
+}
+
+void* load_library(const char* /* path */, std::string& err) {
+  err = "Plugins are unsupported on this platform";
+  return nullptr;
+}
+
+void* library_symbol(void* /* lib */, const char* /* name */) {
+  return nullptr;
+}
+
+std::ptrdiff_t transmit_file(asio::ip::tcp::socket& /* sock */, int /* fd */,
+    std::uint64_t /* off */, std::size_t /* len */) {
+  return -1;
+}
+
+// Without descriptor based file IO there's nothing to serve files from
+int open_file(const char* /* path */) {
+  return -1;
+}
+
+void close_file(int /* fd */) {}
+
+bool stat_file(int /* fd */, FileStat& /* st */) {
+  return false;
+}
+
+bool stat_path(const char* /* path */, FileStat& /* st */) {
+  return false;
+}
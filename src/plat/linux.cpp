@@ -1,8 +1,196 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
 #include <asio/ip/tcp.hpp>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
+#include <unistd.h>
+
+#include "plat.hpp"
 
 int set_reuse_port(asio::ip::tcp::acceptor& sock) {
   auto native {sock.native_handle()};
   int optval {1};
   return setsockopt(native, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
 }
+
+void* alloc_slab(std::size_t size, bool huge) {
+  constexpr std::size_t huge_sz {std::size_t {2} << 20};
+
+  if(!huge) {
+    void* ptr {mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  // Transparent huge pages need 2M alignment, over-allocate and trim
+  size = (size + huge_sz - 1) & ~(huge_sz - 1);
+  void* ptr {mmap(nullptr, size + huge_sz, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  if(ptr == MAP_FAILED)
+    return nullptr;
+
+  auto base {reinterpret_cast<std::uintptr_t>(ptr)};
+  auto aligned {(base + huge_sz - 1) & ~(huge_sz - 1)};
+  if(aligned != base)
+    munmap(ptr, aligned - base);
+  if(std::size_t tail {huge_sz - (aligned - base)})
+    munmap(reinterpret_cast<void*>(aligned + size), tail);
+
+  madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+  return reinterpret_cast<void*>(aligned);
+}
+
+void* map_shared(std::size_t size) {
+  void* ptr {mmap(nullptr, size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS, -1, 0)};
+  return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void unmap_shared(void* ptr, std::size_t size) {
+  munmap(ptr, size);
+}
+
+struct SpillFile {
+  int fd;
+  void* map {nullptr};
+  std::size_t len {0};
+};
+
+SpillFile* spill_open() {
+  const char* dir {std::getenv("TMPDIR")};
+  if(!dir || !*dir)
+    dir = "/tmp";
+
+  int fd {open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)};
+  if(fd != -1)
+    return new SpillFile {fd};
+
+  std::string path {std::string {dir} + "/velocem-XXXXXX"};
+  fd = mkostemp(path.data(), O_CLOEXEC);
+  if(fd == -1)
+    return nullptr;
+  unlink(path.c_str());
+  return new SpillFile {fd};
+}
+
+bool spill_write(SpillFile* file, const char* data, std::size_t len) {
+  while(len) {
+    ssize_t n {write(file->fd, data, len)};
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+char* spill_map(SpillFile* file, std::size_t len) {
+  void* ptr {mmap(nullptr, len, PROT_READ, MAP_SHARED, file->fd, 0)};
+  if(ptr == MAP_FAILED)
+    return nullptr;
+  madvise(ptr, len, MADV_SEQUENTIAL);
+  file->map = ptr;
+  file->len = len;
+  return static_cast<char*>(ptr);
+}
+
+void spill_close(SpillFile* file) {
+  if(file->map)
+    munmap(file->map, file->len);
+  close(file->fd);
+  delete file;
+}
+
+std::int64_t file_size(int fd) {
+  struct stat st;
+  if(fstat(fd, &st) || !S_ISREG(st.st_mode))
+    return -1;
+  return st.st_size;
+}
+
+std::ptrdiff_t read_at(int fd, char* buf, std::size_t len, std::uint64_t off) {
+  for(;;) {
+    ssize_t n {pread(fd, buf, len, static_cast<off_t>(off))};
+    if(n >= 0 || errno != EINTR)
+      return n;
+  }
+}
+
+void* load_library(const char* path, std::string& err) {
+  void* lib {dlopen(path, RTLD_NOW | RTLD_LOCAL)};
+  if(!lib)
+    err = dlerror();
+  return lib;
+}
+
+void* library_symbol(void* lib, const char* name) {
+  return dlsym(lib, name);
+}
+
+std::ptrdiff_t transmit_file(asio::ip::tcp::socket& sock, int fd,
+    std::uint64_t off, std::size_t len) {
+  off_t pos {static_cast<off_t>(off)};
+  for(;;) {
+    ssize_t n {sendfile(sock.native_handle(), fd, &pos, len)};
+    if(n > 0)
+      return n;
+    if(n == 0)
+      return -1; // The file is shorter than promised
+    if(errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    if(errno != EINTR)
+      return -1;
+  }
+}
+
+int open_file(const char* path) {
+  int fd;
+  do
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  while(fd == -1 && errno == EINTR);
+  return fd;
+}
+
+void close_file(int fd) {
+  close(fd);
+}
+
+namespace {
+
+void fill_stat(const struct stat& st, FileStat& out) {
+  out.size = static_cast<std::uint64_t>(st.st_size);
+  out.mtime = st.st_mtim.tv_sec;
+  out.mtime_ns = st.st_mtim.tv_nsec;
+  out.id = static_cast<std::uint64_t>(st.st_ino) ^
+      (static_cast<std::uint64_t>(st.st_dev) << 40);
+  out.regular = S_ISREG(st.st_mode);
+}
+
+} // namespace
+
+bool stat_file(int fd, FileStat& out) {
+  struct stat st;
+  if(fstat(fd, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
+
+bool stat_path(const char* path, FileStat& out) {
+  struct stat st;
+  if(stat(path, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
@@ -1,7 +1,175 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <stdexcept>
+#include <string>
 
-#include <asio.hpp>
+#include <asio/ip/tcp.hpp>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "plat.hpp"
 
 int set_reuse_port(asio::ip::tcp::acceptor& sock) {
   throw std::logic_error {"SO_REUSEPORT unavailable on MacOS"};
 }
+
+void* alloc_slab(std::size_t size, bool /* huge */) {
+  void* ptr {mmap(nullptr, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANON, -1, 0)};
+  return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void* map_shared(std::size_t size) {
+  void* ptr {mmap(nullptr, size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANON, -1, 0)};
+  return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void unmap_shared(void* ptr, std::size_t size) {
+  munmap(ptr, size);
+}
+
+struct SpillFile {
+  int fd;
+  void* map {nullptr};
+  std::size_t len {0};
+};
+
+SpillFile* spill_open() {
+  const char* dir {std::getenv("TMPDIR")};
+  if(!dir || !*dir)
+    dir = "/tmp";
+
+  // No O_TMPFILE, unlink as soon as the file is created
+  std::string path {std::string {dir} + "/velocem-XXXXXX"};
+  int fd {mkstemp(path.data())};
+  if(fd == -1)
+    return nullptr;
+  unlink(path.c_str());
+  return new SpillFile {fd};
+}
+
+bool spill_write(SpillFile* file, const char* data, std::size_t len) {
+  while(len) {
+    ssize_t n {write(file->fd, data, len)};
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+char* spill_map(SpillFile* file, std::size_t len) {
+  void* ptr {mmap(nullptr, len, PROT_READ, MAP_SHARED, file->fd, 0)};
+  if(ptr == MAP_FAILED)
+    return nullptr;
+  madvise(ptr, len, MADV_SEQUENTIAL);
+  file->map = ptr;
+  file->len = len;
+  return static_cast<char*>(ptr);
+}
+
+void spill_close(SpillFile* file) {
+  if(file->map)
+    munmap(file->map, file->len);
+  close(file->fd);
+  delete file;
+}
+
+std::int64_t file_size(int fd) {
+  struct stat st;
+  if(fstat(fd, &st) || !S_ISREG(st.st_mode))
+    return -1;
+  return st.st_size;
+}
+
+std::ptrdiff_t read_at(int fd, char* buf, std::size_t len, std::uint64_t off) {
+  for(;;) {
+    ssize_t n {pread(fd, buf, len, static_cast<off_t>(off))};
+    if(n >= 0 || errno != EINTR)
+      return n;
+  }
+}
+
+void* load_library(const char* path, std::string& err) {
+  void* lib {dlopen(path, RTLD_NOW | RTLD_LOCAL)};
+  if(!lib)
+    err = dlerror();
+  return lib;
+}
+
+void* library_symbol(void* lib, const char* name) {
+  return dlsym(lib, name);
+}
+
+std::ptrdiff_t transmit_file(asio::ip::tcp::socket& sock, int fd,
+    std::uint64_t off, std::size_t len) {
+  for(;;) {
+    off_t sent {static_cast<off_t>(len)};
+    int rc {sendfile(fd, sock.native_handle(), static_cast<off_t>(off), &sent,
+        nullptr, 0)};
+    if(!rc)
+      return sent ? sent : -1; // Zero means the file is shorter than promised
+    if(errno == EAGAIN || errno == EINTR) {
+      if(sent)
+        return sent;
+      if(errno == EAGAIN)
+        return 0;
+      continue;
+    }
+    return -1;
+  }
+}
+
+int open_file(const char* path) {
+  int fd;
+  do
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  while(fd == -1 && errno == EINTR);
+  return fd;
+}
+
+void close_file(int fd) {
+  close(fd);
+}
+
+namespace {
+
+void fill_stat(const struct stat& st, FileStat& out) {
+  out.size = static_cast<std::uint64_t>(st.st_size);
+  out.mtime = st.st_mtimespec.tv_sec;
+  out.mtime_ns = st.st_mtimespec.tv_nsec;
+  out.id = static_cast<std::uint64_t>(st.st_ino) ^
+      (static_cast<std::uint64_t>(st.st_dev) << 40);
+  out.regular = S_ISREG(st.st_mode);
+}
+
+} // namespace
+
+bool stat_file(int fd, FileStat& out) {
+  struct stat st;
+  if(fstat(fd, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
+
+bool stat_path(const char* path, FileStat& out) {
+  struct stat st;
+  if(stat(path, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
@@ -1,8 +1,76 @@
 #ifndef VELOCEM_PLAT_HPP
 #define VELOCEM_PLAT_HPP
 
-#include <asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <asio/ip/tcp.hpp>
 
 int set_reuse_port(asio::ip::tcp::acceptor& sock);
 
+// Page-aligned memory that is never returned to the system, optionally backed
+// by huge pages where the platform supports them. Returns nullptr on failure.
+void* alloc_slab(std::size_t size, bool huge);
+
+// Zero-filled memory which stays shared with any processes forked after the
+// call. Where processes aren't forked the memory is simply private. Returns
+// nullptr on failure.
+void* map_shared(std::size_t size);
+
+void unmap_shared(void* ptr, std::size_t size);
+
+// Anonymous, already unlinked, temporary file which large request bodies are
+// spilled into. Once written the contents are mapped read-only, mappings are
+// released by spill_close().
+struct SpillFile;
+
+SpillFile* spill_open();
+
+// Blocking, it runs on the server thread and holds up every other connection
+// until the data is in the page cache
+bool spill_write(SpillFile* file, const char* data, std::size_t len);
+
+char* spill_map(SpillFile* file, std::size_t len);
+
+void spill_close(SpillFile* file);
+
+// Size of the regular file open as fd, or -1 if it isn't one or the platform
+// can't serve files by descriptor
+std::int64_t file_size(int fd);
+
+// Positional read which leaves the file offset alone. Returns bytes read, 0 at
+// end of file and -1 on error.
+std::ptrdiff_t read_at(int fd, char* buf, std::size_t len, std::uint64_t off);
+
+// Sends up to len bytes of the file from off straight to a connected socket,
+// which must be in non-blocking mode. Returns bytes sent, 0 if the socket
+// isn't writable, or -1 on error or where the platform has no such call.
+std::ptrdiff_t transmit_file(asio::ip::tcp::socket& sock, int fd,
+    std::uint64_t off, std::size_t len);
+
+struct FileStat {
+  std::uint64_t size;
+  std::int64_t mtime;    // Seconds since the epoch
+  std::int64_t mtime_ns; // Sub-second part, 0 where unavailable
+  std::uint64_t id;      // Identifies the file itself, 0 where unavailable
+  bool regular;
+};
+
+// Opens a file read-only, -1 on failure
+int open_file(const char* path);
+
+void close_file(int fd);
+
+bool stat_file(int fd, FileStat& st);
+
+bool stat_path(const char* path, FileStat& st);
+
+// Shared library which stays loaded for the life of the process. Returns
+// nullptr with a description of the failure in err.
+void* load_library(const char* path, std::string& err);
+
+// Address of an exported function, or nullptr
+void* library_symbol(void* lib, const char* name);
+
 #endif
@@ -1,7 +1,165 @@
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 
-#include <asio.hpp>
+#include <asio/ip/tcp.hpp>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <windows.h>
+
+#include "plat.hpp"
 
 int set_reuse_port(asio::ip::tcp::acceptor& sock) {
   throw std::logic_error {"SO_REUSEPORT unavailable on Windows"};
 }
+
+void* alloc_slab(std::size_t size, bool /* huge */) {
+  // Large pages require SeLockMemoryPrivilege, which we won't have
+  return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+// Windows never forks, workers can't inherit an unnamed mapping
+void* map_shared(std::size_t size) {
+  return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void unmap_shared(void* ptr, std::size_t /* size */) {
+  VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+struct SpillFile {
+  HANDLE file;
+  HANDLE mapping {nullptr};
+  void* map {nullptr};
+};
+
+SpillFile* spill_open() {
+  wchar_t dir[MAX_PATH + 1];
+  wchar_t path[MAX_PATH + 1];
+  if(!GetTempPathW(MAX_PATH + 1, dir) ||
+      !GetTempFileNameW(dir, L"vlc", 0, path))
+    return nullptr;
+
+  HANDLE file {CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+      CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+      nullptr)};
+  if(file == INVALID_HANDLE_VALUE)
+    return nullptr;
+  return new SpillFile {file};
+}
+
+bool spill_write(SpillFile* file, const char* data, std::size_t len) {
+  while(len) {
+    DWORD chunk {len > 0x40000000 ? 0x40000000 : static_cast<DWORD>(len)};
+    DWORD written;
+    if(!WriteFile(file->file, data, chunk, &written, nullptr))
+      return false;
+    data += written;
+    len -= written;
+  }
+  return true;
+}
+
+char* spill_map(SpillFile* file, std::size_t len) {
+  file->mapping =
+      CreateFileMappingW(file->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(!file->mapping)
+    return nullptr;
+  file->map = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, len);
+  return static_cast<char*>(file->map);
+}
+
+void spill_close(SpillFile* file) {
+  if(file->map)
+    UnmapViewOfFile(file->map);
+  if(file->mapping)
+    CloseHandle(file->mapping);
+  CloseHandle(file->file);
+  delete file;
+}
+
+std::int64_t file_size(int fd) {
+  HANDLE h {reinterpret_cast<HANDLE>(_get_osfhandle(fd))};
+  if(h == INVALID_HANDLE_VALUE || GetFileType(h) != FILE_TYPE_DISK)
+    return -1;
+  LARGE_INTEGER sz;
+  if(!GetFileSizeEx(h, &sz))
+    return -1;
+  return sz.QuadPart;
+}
+
+std::ptrdiff_t read_at(int fd, char* buf, std::size_t len, std::uint64_t off) {
+  HANDLE h {reinterpret_cast<HANDLE>(_get_osfhandle(fd))};
+  OVERLAPPED ov {};
+  ov.Offset = static_cast<DWORD>(off);
+  ov.OffsetHigh = static_cast<DWORD>(off >> 32);
+  DWORD n;
+  DWORD want {len > 0x40000000 ? 0x40000000 : static_cast<DWORD>(len)};
+  if(!ReadFile(h, buf, want, &n, &ov))
+    return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+  return n;
+}
+
+void* load_library(const char* path, std::string& err) {
+  HMODULE lib {LoadLibraryA(path)};
+  if(!lib) {
+    char msg[256];
+    DWORD len {FormatMessageA(
+        FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr,
+        GetLastError(), 0, msg, sizeof(msg), nullptr)};
+    err.assign(msg, len);
+    while(!err.empty() && (err.back() == '\n' || err.back() == '\r'))
+      err.pop_back();
+  }
+  return lib;
+}
+
+void* library_symbol(void* lib, const char* name) {
+  return reinterpret_cast<void*>(
+      GetProcAddress(static_cast<HMODULE>(lib), name));
+}
+
+// TransmitFile() wants overlapped IO on the socket, files are read instead
+std::ptrdiff_t transmit_file(asio::ip::tcp::socket& /* sock */, int /* fd */,
+    std::uint64_t /* off */, std::size_t /* len */) {
+  return -1;
+}
+
+int open_file(const char* path) {
+  return _open(path, _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+}
+
+void close_file(int fd) {
+  _close(fd);
+}
+
+namespace {
+
+void fill_stat(const struct _stat64& st, FileStat& out) {
+  out.size = static_cast<std::uint64_t>(st.st_size);
+  out.mtime = st.st_mtime;
+  out.mtime_ns = 0;
+  out.id = 0;
+  out.regular = (st.st_mode & _S_IFMT) == _S_IFREG;
+}
+
+} // namespace
+
+bool stat_file(int fd, FileStat& out) {
+  struct _stat64 st;
+  if(_fstat64(fd, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
+
+bool stat_path(const char* path, FileStat& out) {
+  struct _stat64 st;
+  if(_stat64(path, &st))
+    return false;
+  fill_stat(st, out);
+  return true;
+}
@@ -0,0 +1,309 @@
+#include "Plugin.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <Python.h>
+
+#include <velocem/plugin.h>
+
+#include "plat/plat.hpp"
+#include "router/RouteTree.hpp"
+#include "util/Constants.hpp"
+#include "util/HeaderCheck.hpp"
+#include "util/OutputBuffer.hpp"
+#include "wsgi/App.hpp"
+#include "wsgi/HeaderCache.hpp"
+#include "wsgi/Request.hpp"
+
+struct velocem_response {
+  velocem::OutputBuffer& body;
+  velocem::OutputBuffer& headers;
+  int status;
+};
+
+struct velocem_registrar {
+  velocem::PluginTable& table;
+};
+
+namespace velocem {
+
+PluginTable gPlugins;
+
+namespace {
+
+using plugin_init_fn = int (*)(const velocem_host*, velocem_registrar*);
+using plugin_abi_fn = std::uint32_t (*)();
+
+int host_add_route(velocem_registrar* reg, const char* method,
+    const char* path, int prefix, velocem_handler handler, void* ctx) {
+  return reg->table.add_route(method, path, prefix, handler, ctx) ? 0 : -1;
+}
+
+velocem_str host_header(const velocem_request* req, const char* name) {
+  // Repeated headers resolve to the last one, as they do in the environ
+  for(std::size_t i {req->header_count}; i--;) {
+    const velocem_header& hdr {req->headers[i]};
+    if(cgi_header_matches({hdr.name.data, hdr.name.len}, name))
+      return hdr.value;
+  }
+  return {nullptr, 0};
+}
+
+void host_set_status(velocem_response* resp, int status) {
+  resp->status = status;
+}
+
+int host_add_header(velocem_response* resp, const char* name,
+    std::size_t name_len, const char* value, std::size_t value_len) {
+  switch(classify_header_name(name, name_len)) {
+    case HeaderName::Other:
+      break;
+    case HeaderName::Invalid:
+      return -1;
+    default:
+      return 0;
+  }
+
+  if(!valid_field_value(value, value_len))
+    return -1;
+
+  OutputBuffer& buf {resp->headers};
+  buf.reserve(name_len + value_len + 4);
+  buf.append_unchecked(name, name_len);
+  buf.append_unchecked(": ", 2);
+  buf.append_unchecked(value, value_len);
+  buf.append_unchecked("\r\n", 2);
+  return 0;
+}
+
+void host_write(velocem_response* resp, const void* data, std::size_t len) {
+  if(len)
+    resp->body.append(static_cast<const char*>(data), len);
+}
+
+constexpr velocem_host host_table {
+    .abi_version = VELOCEM_PLUGIN_ABI_VERSION,
+    .add_route = host_add_route,
+    .header = host_header,
+    .set_status = host_set_status,
+    .add_header = host_add_header,
+    .write = host_write,
+};
+
+velocem_str to_str(std::string_view sv) {
+  return {sv.data(), sv.size()};
+}
+
+void insert_status_code(OutputBuffer& buf, int status) {
+  std::string_view line {common_status_line(status)};
+  if(!line.empty()) {
+    buf.append(line);
+  } else {
+    buf.append("HTTP/1.1 ");
+    buf.append_dec(status);
+    // The reason phrase is optional, but the space before it isn't
+    buf.append(" \r\n");
+  }
+}
+
+} // namespace
+
+bool PluginTable::load(PyObject* path) {
+  PyObject* bytes;
+  if(!PyUnicode_FSConverter(path, &bytes))
+    return false;
+
+  const char* file {PyBytes_AS_STRING(bytes)};
+  std::string err;
+  void* lib {load_library(file, err)};
+  if(!lib) {
+    PyErr_Format(PyExc_ImportError, "Couldn't load plugin %s: %s", file,
+        err.c_str());
+    Py_DECREF(bytes);
+    return false;
+  }
+
+  auto abi {reinterpret_cast<plugin_abi_fn>(
+      library_symbol(lib, "velocem_plugin_abi"))};
+  auto init {reinterpret_cast<plugin_init_fn>(
+      library_symbol(lib, "velocem_plugin_init"))};
+  if(!abi || !init) {
+    PyErr_Format(PyExc_ImportError,
+        "Plugin %s doesn't export velocem_plugin_abi and velocem_plugin_init",
+        file);
+    Py_DECREF(bytes);
+    return false;
+  }
+
+  if(std::uint32_t ver {abi()}; ver != VELOCEM_PLUGIN_ABI_VERSION) {
+    PyErr_Format(PyExc_ImportError,
+        "Plugin %s was built for ABI version %u, this is version %u", file,
+        static_cast<unsigned>(ver), VELOCEM_PLUGIN_ABI_VERSION);
+    Py_DECREF(bytes);
+    return false;
+  }
+
+  velocem_registrar reg {*this};
+  if(int rc {init(&host_table, &reg)}) {
+    PyErr_Format(PyExc_RuntimeError, "Plugin %s failed to initialize (%d)",
+        file, rc);
+    Py_DECREF(bytes);
+    return false;
+  }
+
+  Py_DECREF(bytes);
+  return true;
+}
+
+void PluginTable::clear() {
+  exact_.clear();
+  prefixes_.clear();
+}
+
+bool PluginTable::add_route(const char* method, const char* path,
+    bool prefix, velocem_handler handler, void* ctx) {
+  if(!path || !handler)
+    return false;
+
+  int meth {RouteTree::any_method};
+  if(method) {
+    meth = static_cast<int>(str2meth(method));
+    if(meth == static_cast<int>(HTTPMethod::INVALID))
+      return false;
+  }
+
+  RouteList* routes;
+  if(prefix) {
+    std::string_view pv {path};
+    auto it {std::ranges::find_if(prefixes_,
+        [&](const auto& p) { return p.first == pv; })};
+    if(it == prefixes_.end()) {
+      // Kept ordered longest first, so the first match is the most specific
+      auto pos {std::ranges::find_if(prefixes_,
+          [&](const auto& p) { return p.first.size() < pv.size(); })};
+      it = prefixes_.emplace(pos, std::string {pv}, RouteList {});
+    }
+    routes = &it->second;
+  } else {
+    routes = &exact_[path];
+  }
+
+  if(std::ranges::any_of(*routes,
+         [&](const Route& route) { return route.meth == meth; }))
+    return false;
+  routes->push_back({meth, handler, ctx});
+  return true;
+}
+
+const PluginTable::Route* PluginTable::find_method(const RouteList& routes,
+    int meth) {
+  const Route* any {nullptr};
+  const Route* get {nullptr};
+  for(const Route& route : routes) {
+    if(route.meth == meth)
+      return &route;
+    if(route.meth == RouteTree::any_method)
+      any = &route;
+    else if(route.meth == static_cast<int>(HTTPMethod::Get))
+      get = &route;
+  }
+  if(any)
+    return any;
+  // HEAD falls back to GET, as it does for the Router
+  return meth == static_cast<int>(HTTPMethod::Head) ? get : nullptr;
+}
+
+const PluginTable::Route* PluginTable::match(std::string_view path,
+    int meth) const {
+  if(auto it {exact_.find(path)}; it != exact_.end())
+    if(const Route* route {find_method(it->second, meth)})
+      return route;
+
+  for(const auto& [pre, routes] : prefixes_)
+    if(path.starts_with(pre))
+      if(const Route* route {find_method(routes, meth)})
+        return route;
+  return nullptr;
+}
+
+WSGIAppRet* PluginTable::dispatch(WSGIRequest* req, int meth, int http_minor,
+    bool keepalive) {
+  // Spilled bodies are disk backed, reading one could block the handler
+  if(meth < 0 || req->spill_) [[unlikely]]
+    return nullptr;
+
+  const Route* route {match(req->url().view(), meth)};
+  if(!route)
+    return nullptr;
+
+  headers_.clear();
+  for(WSGIHeader& hdr : req->headers_)
+    headers_.push_back({to_str(hdr.field.view()), to_str(hdr.value.view())});
+
+  char* body {req->input_.body_begin()};
+  velocem_request creq {
+      .method = to_str(meth2str(static_cast<HTTPMethod>(meth))),
+      .path = to_str(req->url().view()),
+      .query = req->has_query() ? to_str(req->query().view())
+                                : velocem_str {"", 0},
+      .http_minor = http_minor,
+      .keep_alive = keepalive,
+      .headers = headers_.data(),
+      .header_count = headers_.size(),
+      .body = {body, static_cast<std::size_t>(req->input_.body_end() - body)},
+  };
+
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  OutputBuffer& buf {ret->buf};
+  hdr_scratch_.clear();
+  velocem_response resp {buf, hdr_scratch_, 200};
+
+  int rc {route->handler(route->ctx, &creq, &resp)};
+  if(rc == VELOCEM_DECLINED) {
+    gAppRetPool.push(ret);
+    return nullptr;
+  }
+
+  gRequestPool.push(req);
+
+  if(rc != VELOCEM_HANDLED || resp.status < 100 || resp.status > 999)
+      [[unlikely]] {
+    buf.clear();
+    hdr_scratch_.clear();
+    resp.status = 500;
+  }
+
+  // The body was written straight into the response buffer, the head is
+  // prepended once its length is known
+  std::size_t len {buf.size()};
+  bool bodiless {resp.status < 200 || resp.status == 204 ||
+      resp.status == 304};
+  if(bodiless || meth == static_cast<int>(HTTPMethod::Head))
+    buf.clear();
+
+  OutputBuffer& head {head_scratch_};
+  head.clear();
+  insert_status_code(head, resp.status);
+  head.append(gRequiredHeaders);
+  if(keepalive)
+    head.append("Connection: keep-alive\r\n");
+  else
+    head.append("Connection: close\r\n");
+  head.append(hdr_scratch_.data(), hdr_scratch_.size());
+  if(bodiless) {
+    head.append("\r\n");
+  } else {
+    head.append("Content-Length: ");
+    head.append_dec(len);
+    head.append("\r\n\r\n");
+  }
+
+  buf.prepend(head.data(), head.size());
+  return ret;
+}
+
+} // namespace velocem
@@ -0,0 +1,74 @@
+#ifndef VELOCEM_PLUGIN_PLUGIN_HPP
+#define VELOCEM_PLUGIN_PLUGIN_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+#include <velocem/plugin.h>
+
+#include "util/Hash.hpp"
+#include "util/OutputBuffer.hpp"
+
+namespace velocem {
+struct WSGIAppRet;
+struct WSGIRequest;
+} // namespace velocem
+
+namespace velocem {
+
+// Routes registered by native plugins, see include/velocem/plugin.h. Requests
+// are offered to these as soon as they're parsed, before any app or Python
+// object is involved.
+class PluginTable {
+public:
+  // Loads the shared library at path and runs its init function. Returns
+  // false with a Python exception set.
+  bool load(PyObject* path);
+
+  bool empty() const {
+    return exact_.empty() && prefixes_.empty();
+  }
+
+  // Drops every route, the libraries themselves stay loaded
+  void clear();
+
+  // The plugin's response, consuming the request, or nullptr if no route
+  // matches, the handler declined it or the body was spilled to disk
+  WSGIAppRet* dispatch(WSGIRequest* req, int meth, int http_minor,
+      bool keepalive);
+
+  // Backs velocem_host::add_route
+  bool add_route(const char* method, const char* path, bool prefix,
+      velocem_handler handler, void* ctx);
+
+private:
+  struct Route {
+    int meth;
+    velocem_handler handler;
+    void* ctx;
+  };
+  using RouteList = std::vector<Route>;
+
+  static const Route* find_method(const RouteList& routes, int meth);
+  const Route* match(std::string_view path, int meth) const;
+
+  std::unordered_map<std::string, RouteList, StringHash, std::equal_to<>>
+      exact_;
+  std::vector<std::pair<std::string, RouteList>> prefixes_; // Longest first
+
+  std::vector<velocem_header> headers_;
+  OutputBuffer hdr_scratch_;
+  OutputBuffer head_scratch_;
+};
+
+extern PluginTable gPlugins;
+
+} // namespace velocem
+
+#endif // VELOCEM_PLUGIN_PLUGIN_HPP
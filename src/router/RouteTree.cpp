@@ -0,0 +1,265 @@
+#include "RouteTree.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+#include "util/Constants.hpp"
+
+namespace velocem {
+
+struct RouteTree::MatchState {
+  int meth;
+  PyObject* handler;
+  std::vector<Capture>& caps;
+  std::vector<int>* allowed;
+  bool mismatch;
+};
+
+namespace {
+
+bool route_error(const char* msg, std::string_view pattern) {
+  PyErr_Format(PyExc_ValueError, "%s: %.*s", msg,
+      static_cast<int>(pattern.size()), pattern.data());
+  return false;
+}
+
+// Length of the capture at the front of rest, 0 if there isn't one
+std::size_t capture_len(RouteTree::CaptureType type, std::string_view rest) {
+  if(type == RouteTree::CaptureType::Path)
+    return rest.size();
+
+  std::size_t len {std::min(rest.find('/'), rest.size())};
+  if(type == RouteTree::CaptureType::Int) {
+    std::int64_t val;
+    auto end {rest.data() + len};
+    auto fc {std::from_chars(rest.data(), end, val)};
+    if(fc.ec != std::errc {} || fc.ptr != end || rest[0] == '-')
+      return 0;
+  }
+  return len;
+}
+
+} // namespace
+
+RouteTree::Node::~Node() {
+  Py_XDECREF(name);
+  for(auto& [meth, handler] : handlers)
+    Py_DECREF(handler);
+}
+
+RouteTree::RouteTree() : root_ {std::make_unique<Node>()} {}
+
+RouteTree::~RouteTree() = default;
+
+int RouteTree::traverse_node(const Node* node, visitproc visit, void* arg) {
+  for(const auto& [meth, handler] : node->handlers)
+    Py_VISIT(handler);
+  for(const auto& child : node->statics)
+    if(int err {traverse_node(child.get(), visit, arg)})
+      return err;
+  return node->param ? traverse_node(node->param.get(), visit, arg) : 0;
+}
+
+int RouteTree::traverse(visitproc visit, void* arg) const {
+  return traverse_node(root_.get(), visit, arg);
+}
+
+// Swapped out first, so handlers released here never see a half torn down tree
+void RouteTree::clear() {
+  std::unique_ptr<Node> old {std::exchange(root_, std::make_unique<Node>())};
+}
+
+RouteTree::Node* RouteTree::insert_static(Node* node, std::string_view lit) {
+  while(!lit.empty()) {
+    auto it {std::find_if(node->statics.begin(), node->statics.end(),
+        [&](auto& child) { return child->prefix[0] == lit[0]; })};
+
+    if(it == node->statics.end()) {
+      auto& child {node->statics.emplace_back(std::make_unique<Node>())};
+      child->prefix = lit;
+      return child.get();
+    }
+
+    std::string_view prefix {(*it)->prefix};
+    std::size_t common {static_cast<std::size_t>(
+        std::mismatch(prefix.begin(), prefix.end(), lit.begin(), lit.end())
+            .first -
+        prefix.begin())};
+
+    // Split the child so the shared part becomes its own node
+    if(common < prefix.size()) {
+      auto mid {std::make_unique<Node>()};
+      mid->prefix = prefix.substr(0, common);
+      (*it)->prefix.erase(0, common);
+      mid->statics.push_back(std::move(*it));
+      *it = std::move(mid);
+    }
+
+    node = it->get();
+    lit.remove_prefix(common);
+  }
+  return node;
+}
+
+bool RouteTree::insert(std::string_view pattern, int meth, PyObject* handler) {
+  if(pattern.empty() || pattern[0] != '/')
+    return route_error("Route patterns must start with '/'", pattern);
+
+  Node* node {root_.get()};
+  bool after_capture {false};
+
+  for(std::size_t pos {0}; pos < pattern.size();) {
+    std::size_t brace {pattern.find('{', pos)};
+    std::string_view lit {pattern.substr(pos, brace - pos)};
+    if(!lit.empty())
+      node = insert_static(node, lit);
+    else if(after_capture)
+      return route_error("Captures must be separated by literal text", pattern);
+
+    if(brace == pattern.npos)
+      break;
+
+    std::size_t close {pattern.find('}', brace)};
+    if(close == pattern.npos)
+      return route_error("Unterminated capture", pattern);
+
+    std::string_view spec {pattern.substr(brace + 1, close - brace - 1)};
+    std::size_t colon {spec.find(':')};
+    std::string_view name {spec.substr(0, colon)};
+    std::string_view tname {colon == spec.npos ? "" : spec.substr(colon + 1)};
+
+    CaptureType type;
+    if(tname.empty() || tname == "str")
+      type = CaptureType::Str;
+    else if(tname == "int")
+      type = CaptureType::Int;
+    else if(tname == "path")
+      type = CaptureType::Path;
+    else
+      return route_error("Unknown capture type", pattern);
+
+    if(name.empty())
+      return route_error("Captures must be named", pattern);
+    if(type == CaptureType::Path && close + 1 != pattern.size())
+      return route_error("Path captures must end the pattern", pattern);
+
+    PyObject* pyname {PyUnicode_FromStringAndSize(name.data(), name.size())};
+    if(!pyname)
+      return false;
+    PyUnicode_InternInPlace(&pyname);
+
+    if(node->param) {
+      bool same {node->param->type == type && node->param->name == pyname};
+      Py_DECREF(pyname);
+      if(!same)
+        return route_error("Conflicting capture at the same position",
+            pattern);
+    } else {
+      node->param = std::make_unique<Node>();
+      node->param->name = pyname;
+      node->param->type = type;
+    }
+
+    node = node->param.get();
+    after_capture = true;
+    pos = close + 1;
+  }
+
+  for(auto& [m, h] : node->handlers)
+    if(m == meth)
+      return route_error("Route is already registered", pattern);
+
+  node->handlers.emplace_back(meth, Py_NewRef(handler));
+  return true;
+}
+
+bool RouteTree::match_terminal(const Node* node, MatchState& st) {
+  if(node->handlers.empty())
+    return false;
+
+  PyObject* any {nullptr};
+  PyObject* get {nullptr};
+  for(auto& [m, h] : node->handlers) {
+    if(m == st.meth) {
+      st.handler = h;
+      return true;
+    }
+    if(m == any_method)
+      any = h;
+    else if(m == static_cast<int>(HTTPMethod::Get))
+      get = h;
+  }
+
+  if(get && st.meth == static_cast<int>(HTTPMethod::Head)) {
+    st.handler = get;
+    return true;
+  }
+
+  if(any) {
+    st.handler = any;
+    return true;
+  }
+
+  if(!st.mismatch && st.allowed) {
+    st.allowed->clear();
+    for(auto& [m, h] : node->handlers)
+      st.allowed->push_back(m);
+  }
+  st.mismatch = true;
+  return false;
+}
+
+bool RouteTree::match_children(const Node* node, std::string_view rest,
+    MatchState& st) {
+  for(auto& child : node->statics)
+    if(child->prefix[0] == rest[0])
+      if(match_node(child.get(), rest, st))
+        return true;
+
+  if(const Node* param {node->param.get()}) {
+    std::size_t len {capture_len(param->type, rest)};
+    if(!len)
+      return false;
+
+    st.caps.push_back({param->name, param->type, rest.substr(0, len)});
+    rest.remove_prefix(len);
+    if(rest.empty() ? match_terminal(param, st)
+                    : match_children(param, rest, st))
+      return true;
+    st.caps.pop_back();
+  }
+  return false;
+}
+
+bool RouteTree::match_node(const Node* node, std::string_view path,
+    MatchState& st) {
+  if(!path.starts_with(node->prefix))
+    return false;
+  path.remove_prefix(node->prefix.size());
+  return path.empty() ? match_terminal(node, st)
+                      : match_children(node, path, st);
+}
+
+RouteTree::Result RouteTree::match(std::string_view path, int meth,
+    PyObject*& handler, std::vector<Capture>& caps,
+    std::vector<int>* allowed) const {
+  caps.clear();
+  MatchState st {meth, nullptr, caps, allowed, false};
+  if(match_node(root_.get(), path, st)) {
+    handler = st.handler;
+    return Result::Found;
+  }
+  caps.clear();
+  return st.mismatch ? Result::MethodNotAllowed : Result::NotFound;
+}
+
+} // namespace velocem
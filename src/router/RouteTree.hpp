@@ -0,0 +1,96 @@
+#ifndef VELOCEM_ROUTER_ROUTETREE_HPP
+#define VELOCEM_ROUTER_ROUTETREE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+namespace velocem {
+
+// Compressed radix tree of route patterns. Patterns are literal paths with
+// typed captures, "/users/{id:int}/posts/{slug}". Captures are:
+//
+//   {name}       One non-empty path segment, up to the next '/'
+//   {name:int}   A segment of decimal digits, handed out as an int
+//   {name:path}  Everything remaining, slashes included
+//
+// Literal children are tried before a capture at the same position, so
+// "/users/me" beats "/users/{id}". A route registered for any method is used
+// when no handler matches the exact method, and HEAD falls back to GET.
+class RouteTree {
+public:
+  enum class CaptureType : std::uint8_t {
+    Str,
+    Int,
+    Path,
+  };
+
+  struct Capture {
+    PyObject* name;
+    CaptureType type;
+    std::string_view value;
+  };
+
+  enum class Result {
+    Found,
+    NotFound,
+    MethodNotAllowed,
+  };
+
+  // Any method
+  static constexpr int any_method {-1};
+
+  RouteTree();
+  RouteTree(RouteTree&) = delete;
+  ~RouteTree();
+
+  // Takes a new reference to handler. Returns false with a Python exception
+  // set for malformed patterns and conflicting routes.
+  bool insert(std::string_view pattern, int meth, PyObject* handler);
+
+  // Captures point into path. For MethodNotAllowed, allowed holds the
+  // methods the path does accept.
+  Result match(std::string_view path, int meth, PyObject*& handler,
+      std::vector<Capture>& caps, std::vector<int>* allowed = nullptr) const;
+
+  // GC support for the owning Router, handlers are the only references which
+  // can form cycles
+  int traverse(visitproc visit, void* arg) const;
+  void clear();
+
+private:
+  struct Node {
+    ~Node();
+
+    std::string prefix; // Literal bytes, empty for capture nodes
+    std::vector<std::unique_ptr<Node>> statics;
+    std::unique_ptr<Node> param;
+
+    PyObject* name {nullptr}; // Set on capture nodes
+    CaptureType type {CaptureType::Str};
+
+    std::vector<std::pair<int, PyObject*>> handlers;
+  };
+
+  static Node* insert_static(Node* node, std::string_view lit);
+
+  struct MatchState;
+  static bool match_node(const Node* node, std::string_view path,
+      MatchState& st);
+  static bool match_children(const Node* node, std::string_view rest,
+      MatchState& st);
+  static bool match_terminal(const Node* node, MatchState& st);
+
+  static int traverse_node(const Node* node, visitproc visit, void* arg);
+
+  std::unique_ptr<Node> root_;
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_ROUTER_ROUTETREE_HPP
@@ -0,0 +1,371 @@
+#include "Router.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Python.h>
+
+#include "util/Constants.hpp"
+
+#include "RouteTree.hpp"
+
+namespace velocem {
+
+namespace {
+
+bool unpack_str(PyObject* obj, std::string_view& out) {
+  Py_ssize_t len;
+  const char* data {PyUnicode_AsUTF8AndSize(obj, &len)};
+  if(!data)
+    return false;
+  out = {data, static_cast<std::size_t>(len)};
+  return true;
+}
+
+bool unpack_method(PyObject* obj, std::vector<int>& out) {
+  if(!PyUnicode_Check(obj)) {
+    PyErr_SetString(PyExc_TypeError, "HTTP methods must be str");
+    return false;
+  }
+
+  std::string_view name;
+  if(!unpack_str(obj, name))
+    return false;
+
+  HTTPMethod meth {str2meth(name)};
+  if(meth == HTTPMethod::INVALID) {
+    PyErr_Format(PyExc_ValueError, "Unknown HTTP method: %U", obj);
+    return false;
+  }
+  out.push_back(static_cast<int>(meth));
+  return true;
+}
+
+// None for every method, a method name, or an iterable of them
+bool unpack_methods(PyObject* obj, std::vector<int>& out) {
+  if(!obj || obj == Py_None) {
+    out.push_back(RouteTree::any_method);
+    return true;
+  }
+
+  if(PyUnicode_Check(obj))
+    return unpack_method(obj, out);
+
+  PyObject* seq {PySequence_Fast(obj, "methods must be a str or iterable")};
+  if(!seq)
+    return false;
+
+  bool ok {true};
+  for(Py_ssize_t i {0}, end {PySequence_Fast_GET_SIZE(seq)}; ok && i < end;
+      ++i)
+    ok = unpack_method(PySequence_Fast_GET_ITEM(seq, i), out);
+  Py_DECREF(seq);
+
+  if(ok && out.empty()) {
+    PyErr_SetString(PyExc_ValueError, "methods must not be empty");
+    return false;
+  }
+  return ok;
+}
+
+bool insert_routes(Router* self, PyObject* path,
+    const std::vector<int>& meths, PyObject* handler) {
+  if(!PyCallable_Check(handler)) {
+    PyErr_SetString(PyExc_TypeError, "Route handlers must be callable");
+    return false;
+  }
+
+  std::string_view pattern;
+  if(!unpack_str(path, pattern))
+    return false;
+
+  for(int meth : meths)
+    if(!self->tree->insert(pattern, meth, handler))
+      return false;
+  return true;
+}
+
+// The decorator returned by route() and friends is bound to a
+// (router, path, methods) tuple
+PyObject* make_decorator(Router* self, PyObject* path,
+    const std::vector<int>& meths) {
+  static PyMethodDef decodef {
+      .ml_name = "route_decorator",
+      .ml_meth = (PyCFunction) [](PyObject* spec, PyObject* handler) {
+        auto self {static_cast<Router*>(PyTuple_GET_ITEM(spec, 0))};
+        PyObject* pymeths {PyTuple_GET_ITEM(spec, 2)};
+
+        std::vector<int> meths;
+        for(Py_ssize_t i {0}, end {PyTuple_GET_SIZE(pymeths)}; i < end; ++i)
+          meths.push_back(PyLong_AsLong(PyTuple_GET_ITEM(pymeths, i)));
+
+        if(!insert_routes(self, PyTuple_GET_ITEM(spec, 1), meths, handler))
+          return (PyObject*) nullptr;
+        return Py_NewRef(handler);
+      },
+      .ml_flags = METH_O,
+  };
+
+  PyObject* pymeths {PyTuple_New(meths.size())};
+  if(!pymeths)
+    return nullptr;
+  for(std::size_t i {0}; i < meths.size(); ++i)
+    PyTuple_SET_ITEM(pymeths, i, PyLong_FromLong(meths[i]));
+
+  PyObject* spec {PyTuple_Pack(3, self, path, pymeths)};
+  Py_DECREF(pymeths);
+  if(!spec)
+    return nullptr;
+
+  PyObject* deco {PyCFunction_New(&decodef, spec)};
+  Py_DECREF(spec);
+  return deco;
+}
+
+} // namespace
+
+bool Router::check(PyObject* obj) {
+  return Py_IS_TYPE(obj, &gVT.RouterType);
+}
+
+PyObject* Router::captures(const std::vector<RouteTree::Capture>& caps) {
+  PyObject* dict {PyDict_New()};
+  if(!dict)
+    return nullptr;
+
+  for(const RouteTree::Capture& cap : caps) {
+    PyObject* val;
+    if(cap.type == RouteTree::CaptureType::Int) {
+      // Already validated by the match
+      long long num {0};
+      std::from_chars(cap.value.data(), cap.value.data() + cap.value.size(),
+          num);
+      val = PyLong_FromLongLong(num);
+    } else {
+      val = PyUnicode_FromStringAndSize(cap.value.data(), cap.value.size());
+    }
+
+    if(!val || PyDict_SetItem(dict, cap.name, val)) {
+      Py_XDECREF(val);
+      Py_DECREF(dict);
+      return nullptr;
+    }
+    Py_DECREF(val);
+  }
+  return dict;
+}
+
+std::string Router::allow_list(const std::vector<int>& allowed) {
+  std::string out;
+  auto has {[&](HTTPMethod m) {
+    return std::ranges::find(allowed, static_cast<int>(m)) != allowed.end();
+  }};
+
+  for(int meth : allowed) {
+    if(!out.empty())
+      out.append(", ");
+    out.append(meth2str(static_cast<HTTPMethod>(meth)));
+    if(meth == static_cast<int>(HTTPMethod::Get) && !has(HTTPMethod::Head))
+      out.append(", HEAD");
+  }
+  return out;
+}
+
+void Router::write_miss(OutputBuffer& buf, RouteTree::Result result,
+    const std::vector<int>& allowed, bool keepalive) {
+  bool not_allowed {result == RouteTree::Result::MethodNotAllowed};
+  if(not_allowed)
+    buf.append("HTTP/1.1 405 Method Not Allowed\r\n");
+  else
+    buf.append("HTTP/1.1 404 Not Found\r\n");
+  buf.append(gRequiredHeaders);
+  if(keepalive)
+    buf.append("Connection: keep-alive\r\n");
+  else
+    buf.append("Connection: close\r\n");
+  if(not_allowed) {
+    buf.append("Allow: ");
+    buf.append(allow_list(allowed));
+    buf.append("\r\n");
+  }
+  buf.append("Content-Length: 0\r\n\r\n");
+}
+
+PyObject* Router::new_(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+  if(!PyArg_ParseTuple(args, ":Router") ||
+      (kwds && PyDict_GET_SIZE(kwds))) {
+    if(!PyErr_Occurred())
+      PyErr_SetString(PyExc_TypeError, "Router() takes no arguments");
+    return nullptr;
+  }
+
+  auto self {reinterpret_cast<Router*>(type->tp_alloc(type, 0))};
+  if(!self)
+    return nullptr;
+  self->vectorcall = (vectorcallfunc) call;
+  self->tree = new RouteTree;
+  return self;
+}
+
+void Router::dealloc(Router* self) {
+  PyObject_GC_UnTrack(self);
+  delete self->tree;
+  Py_TYPE(self)->tp_free(self);
+}
+
+// Handlers commonly hold their router, through a module global or a closure
+int Router::traverse(Router* self, visitproc visit, void* arg) {
+  return self->tree->traverse(visit, arg);
+}
+
+int Router::clear(Router* self) {
+  self->tree->clear();
+  return 0;
+}
+
+PyObject* Router::route(Router* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] {"path", "methods", nullptr};
+  PyObject* path;
+  PyObject* pymeths {nullptr};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "U|O:route",
+         const_cast<char**>(kwlist), &path, &pymeths))
+    return nullptr;
+
+  std::vector<int> meths;
+  if(!unpack_methods(pymeths, meths))
+    return nullptr;
+  return make_decorator(self, path, meths);
+}
+
+PyObject* Router::add(Router* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] {"path", "handler", "methods", nullptr};
+  PyObject* path;
+  PyObject* handler;
+  PyObject* pymeths {nullptr};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "UO|O:add",
+         const_cast<char**>(kwlist), &path, &handler, &pymeths))
+    return nullptr;
+
+  std::vector<int> meths;
+  if(!unpack_methods(pymeths, meths) ||
+      !insert_routes(self, path, meths, handler))
+    return nullptr;
+  Py_RETURN_NONE;
+}
+
+template <HTTPMethod M> PyObject* Router::route_for(Router* self,
+    PyObject* path) {
+  if(!PyUnicode_Check(path)) {
+    PyErr_SetString(PyExc_TypeError, "Route paths must be str");
+    return nullptr;
+  }
+  return make_decorator(self, path, {static_cast<int>(M)});
+}
+
+PyObject* Router::call(Router* self, PyObject* const* args,
+    std::size_t nargsf, PyObject* kwnames) {
+  if(PyVectorcall_NARGS(nargsf) != 2 || kwnames) {
+    PyErr_SetString(PyExc_TypeError,
+        "Router takes exactly two arguments, (environ, start_response)");
+    return nullptr;
+  }
+
+  PyObject* env {args[0]};
+  if(!PyDict_Check(env)) {
+    PyErr_SetString(PyExc_TypeError, "environ must be a dict");
+    return nullptr;
+  }
+
+  PyObject* pypath {PyDict_GetItemWithError(env, gPO.path)};
+  PyObject* pymeth {pypath ? PyDict_GetItemWithError(env, gPO.meth) : nullptr};
+  if(!pymeth) {
+    if(!PyErr_Occurred())
+      PyErr_SetString(PyExc_KeyError,
+          "environ is missing PATH_INFO or REQUEST_METHOD");
+    return nullptr;
+  }
+
+  std::string_view path, methname;
+  if(!unpack_str(pypath, path) || !unpack_str(pymeth, methname))
+    return nullptr;
+
+  std::vector<RouteTree::Capture> caps;
+  std::vector<int> allowed;
+  PyObject* handler;
+  auto result {self->tree->match(path,
+      static_cast<int>(str2meth(methname)), handler, caps, &allowed)};
+
+  if(result == RouteTree::Result::Found) {
+    PyObject* dict {captures(caps)};
+    if(!dict)
+      return nullptr;
+    int err {PyDict_SetItem(env, gPO.velocem_caps, dict)};
+    Py_DECREF(dict);
+    if(err)
+      return nullptr;
+    return PyObject_Vectorcall(handler, args, nargsf, nullptr);
+  }
+
+  PyObject* headers;
+  const char* status;
+  if(result == RouteTree::Result::MethodNotAllowed) {
+    status = "405 Method Not Allowed";
+    headers = Py_BuildValue("[(ss)(ss)]", "Content-Length", "0", "Allow",
+        allow_list(allowed).c_str());
+  } else {
+    status = "404 Not Found";
+    headers = Py_BuildValue("[(ss)]", "Content-Length", "0");
+  }
+  if(!headers)
+    return nullptr;
+
+  PyObject* pystatus {PyUnicode_FromString(status)};
+  PyObject* ret {pystatus ? PyObject_CallFunctionObjArgs(args[1], pystatus,
+                                headers, nullptr)
+                          : nullptr};
+  Py_XDECREF(pystatus);
+  Py_DECREF(headers);
+  if(!ret)
+    return nullptr;
+  Py_DECREF(ret);
+  return PyList_New(0);
+}
+
+void Router::init_type(PyTypeObject* RouterType) {
+  static std::array<PyMethodDef, 8> meths {
+      PyMethodDef {"route", (PyCFunction) route, METH_VARARGS | METH_KEYWORDS},
+      {"add", (PyCFunction) add, METH_VARARGS | METH_KEYWORDS},
+      {"get", (PyCFunction) route_for<HTTPMethod::Get>, METH_O},
+      {"post", (PyCFunction) route_for<HTTPMethod::Post>, METH_O},
+      {"put", (PyCFunction) route_for<HTTPMethod::Put>, METH_O},
+      {"patch", (PyCFunction) route_for<HTTPMethod::Patch>, METH_O},
+      {"delete", (PyCFunction) route_for<HTTPMethod::Delete>, METH_O},
+      {nullptr, nullptr},
+  };
+
+  *RouterType = PyTypeObject {
+      .tp_name = "velocem.Router",
+      .tp_basicsize = sizeof(Router),
+      .tp_dealloc = (destructor) dealloc,
+      // vectorcall directly follows the object header, offsetof() isn't
+      // portable on a type deriving from PyObject
+      .tp_vectorcall_offset = sizeof(PyObject),
+      .tp_call = PyVectorcall_Call,
+      .tp_flags =
+          Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_VECTORCALL | Py_TPFLAGS_HAVE_GC,
+      .tp_doc = "Radix-tree router for WSGI handlers",
+      .tp_traverse = (traverseproc) traverse,
+      .tp_clear = (inquiry) clear,
+      .tp_methods = meths.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(RouterType);
+}
+
+} // namespace velocem
@@ -0,0 +1,65 @@
+#ifndef VELOCEM_ROUTER_ROUTER_HPP
+#define VELOCEM_ROUTER_ROUTER_HPP
+
+#include <string>
+#include <vector>
+
+#include <Python.h>
+
+#include "util/Constants.hpp"
+#include "util/OutputBuffer.hpp"
+
+#include "RouteTree.hpp"
+
+namespace velocem {
+
+// velocem.Router, a WSGI application dispatching to handlers registered with
+// its decorators. Values captured from the path are placed in a dict at
+// environ["velocem.captures"].
+//
+// Served by velocem.wsgi the route is matched against the request path before
+// an environ exists, and unmatched paths are answered without entering Python.
+// Under any other server it works as a regular WSGI callable.
+//
+// Either way routes are matched against the percent-decoded path, the one
+// PATH_INFO holds, so an encoded "%2F" separates segments like "/" does.
+struct Router : PyObject {
+  vectorcallfunc vectorcall; // Must stay the first member
+  RouteTree* tree;
+
+  static bool check(PyObject* obj);
+
+  // New dict of the captured values, str for {name} and {name:path}, int for
+  // {name:int}
+  static PyObject* captures(const std::vector<RouteTree::Capture>& caps);
+
+  // Comma-separated method names for an Allow header. HEAD is listed
+  // alongside GET since it falls back to the GET handler.
+  static std::string allow_list(const std::vector<int>& allowed);
+
+  // Complete bodiless 404, or 405 with its Allow header, for a failed match
+  static void write_miss(OutputBuffer& buf, RouteTree::Result result,
+      const std::vector<int>& allowed, bool keepalive);
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* RouterType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(Router* self);
+  static int traverse(Router* self, visitproc visit, void* arg);
+  static int clear(Router* self);
+
+  static PyObject* route(Router* self, PyObject* args, PyObject* kwds);
+  static PyObject* add(Router* self, PyObject* args, PyObject* kwds);
+  template <HTTPMethod M> static PyObject* route_for(Router* self,
+      PyObject* path);
+  static PyObject* decorate(PyObject* spec, PyObject* handler);
+
+  static PyObject* call(Router* self, PyObject* const* args, std::size_t nargsf,
+      PyObject* kwnames);
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_ROUTER_ROUTER_HPP
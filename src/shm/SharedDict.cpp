@@ -0,0 +1,325 @@
+#include "SharedDict.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include <Python.h>
+
+#include "ShmTable.hpp"
+
+namespace velocem {
+
+namespace {
+
+using Type = ShmTable::Type;
+using Result = ShmTable::Result;
+
+bool unpack_key(PyObject* key, std::string_view& out) {
+  if(PyUnicode_Check(key)) {
+    Py_ssize_t len;
+    const char* data {PyUnicode_AsUTF8AndSize(key, &len)};
+    if(!data)
+      return false;
+    out = {data, static_cast<std::size_t>(len)};
+    return true;
+  }
+
+  if(PyBytes_Check(key)) {
+    out = {PyBytes_AS_STRING(key),
+        static_cast<std::size_t>(PyBytes_GET_SIZE(key))};
+    return true;
+  }
+
+  PyErr_SetString(PyExc_TypeError, "SharedDict keys must be str or bytes");
+  return false;
+}
+
+// Serialized form of a value, numbers are stored in native byte order
+struct Value {
+  bool unpack(PyObject* obj) {
+    if(PyBytes_Check(obj)) {
+      type = Type::Bytes;
+      data = {PyBytes_AS_STRING(obj),
+          static_cast<std::size_t>(PyBytes_GET_SIZE(obj))};
+    } else if(PyUnicode_Check(obj)) {
+      Py_ssize_t len;
+      const char* str {PyUnicode_AsUTF8AndSize(obj, &len)};
+      if(!str)
+        return false;
+      type = Type::Str;
+      data = {str, static_cast<std::size_t>(len)};
+    } else if(PyLong_Check(obj)) {
+      std::int64_t val {PyLong_AsLongLong(obj)};
+      if(val == -1 && PyErr_Occurred())
+        return false;
+      type = Type::Int;
+      std::memcpy(num.data(), &val, sizeof(val));
+      data = {num.data(), num.size()};
+    } else if(PyFloat_Check(obj)) {
+      double val {PyFloat_AS_DOUBLE(obj)};
+      type = Type::Float;
+      std::memcpy(num.data(), &val, sizeof(val));
+      data = {num.data(), num.size()};
+    } else {
+      PyErr_SetString(PyExc_TypeError,
+          "SharedDict values must be bytes, str, int or float");
+      return false;
+    }
+    return true;
+  }
+
+  Type type;
+  std::string_view data;
+  std::array<char, 8> num;
+};
+
+PyObject* pack_value(Type type, const std::string& data) {
+  switch(type) {
+    case Type::Bytes:
+      return PyBytes_FromStringAndSize(data.data(), data.size());
+    case Type::Str:
+      return PyUnicode_DecodeUTF8(data.data(), data.size(), nullptr);
+    case Type::Int: {
+      std::int64_t val;
+      std::memcpy(&val, data.data(), sizeof(val));
+      return PyLong_FromLongLong(val);
+    }
+    case Type::Float: {
+      double val;
+      std::memcpy(&val, data.data(), sizeof(val));
+      return PyFloat_FromDouble(val);
+    }
+  }
+  Py_UNREACHABLE();
+}
+
+// None or seconds, as nanoseconds with 0 meaning no expiry
+bool unpack_ttl(PyObject* obj, std::int64_t& out) {
+  out = 0;
+  if(!obj || obj == Py_None)
+    return true;
+
+  double secs {PyFloat_AsDouble(obj)};
+  if(secs == -1.0 && PyErr_Occurred())
+    return false;
+  if(!(secs > 0) || secs > 1e9) {
+    PyErr_SetString(PyExc_ValueError, "ttl must be a positive number");
+    return false;
+  }
+  out = std::max<std::int64_t>(1, std::llround(secs * 1e9));
+  return true;
+}
+
+// Sets an exception for anything but Ok and Missing
+bool check(Result result) {
+  switch(result) {
+    case Result::Full:
+      PyErr_SetString(PyExc_MemoryError, "SharedDict is full");
+      return false;
+    case Result::TooLarge:
+      PyErr_SetString(PyExc_ValueError,
+          "SharedDict key and value are larger than item_size");
+      return false;
+    case Result::NotInt:
+      PyErr_SetString(PyExc_TypeError, "SharedDict value is not an int");
+      return false;
+    default:
+      return true;
+  }
+}
+
+std::string scratch;
+
+} // namespace
+
+PyObject* SharedDict::new_(PyTypeObject* type, PyObject* args,
+    PyObject* kwds) {
+  static const char* kwlist[] {"size", "item_size", nullptr};
+  Py_ssize_t size;
+  Py_ssize_t item_size {256};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "n|n:SharedDict",
+         const_cast<char**>(kwlist), &size, &item_size))
+    return nullptr;
+
+  if(size <= 0 || item_size <= 0) {
+    PyErr_SetString(PyExc_ValueError, "size and item_size must be positive");
+    return nullptr;
+  }
+
+  auto self {reinterpret_cast<SharedDict*>(type->tp_alloc(type, 0))};
+  if(!self)
+    return nullptr;
+  new(&self->table) ShmTable;
+
+  if(!self->table.open(size, item_size)) {
+    PyErr_SetString(PyExc_MemoryError,
+        "Unable to map a SharedDict of that size");
+    Py_DECREF(self);
+    return nullptr;
+  }
+  return self;
+}
+
+void SharedDict::dealloc(SharedDict* self) {
+  self->table.~ShmTable();
+  Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* SharedDict::get(SharedDict* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] {"key", "default", nullptr};
+  PyObject* key;
+  PyObject* def {Py_None};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:get",
+         const_cast<char**>(kwlist), &key, &def))
+    return nullptr;
+
+  std::string_view k;
+  if(!unpack_key(key, k))
+    return nullptr;
+
+  Type type;
+  if(self->table.get(k, type, scratch) == Result::Missing)
+    return Py_NewRef(def);
+  return pack_value(type, scratch);
+}
+
+PyObject* SharedDict::set(SharedDict* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] {"key", "value", "ttl", nullptr};
+  PyObject* key;
+  PyObject* value;
+  PyObject* ttl {nullptr};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O:set",
+         const_cast<char**>(kwlist), &key, &value, &ttl))
+    return nullptr;
+
+  std::string_view k;
+  Value v;
+  std::int64_t ns;
+  if(!unpack_key(key, k) || !v.unpack(value) || !unpack_ttl(ttl, ns))
+    return nullptr;
+
+  if(!check(self->table.set(k, v.type, v.data, ns)))
+    return nullptr;
+  Py_RETURN_NONE;
+}
+
+PyObject* SharedDict::incr(SharedDict* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] {"key", "delta", "init", "ttl", nullptr};
+  PyObject* key;
+  long long delta {1};
+  long long init {0};
+  PyObject* ttl {nullptr};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|L$LO:incr",
+         const_cast<char**>(kwlist), &key, &delta, &init, &ttl))
+    return nullptr;
+
+  std::string_view k;
+  std::int64_t ns;
+  if(!unpack_key(key, k) || !unpack_ttl(ttl, ns))
+    return nullptr;
+
+  std::int64_t out;
+  if(!check(self->table.incr(k, delta, init, ns, out)))
+    return nullptr;
+  return PyLong_FromLongLong(out);
+}
+
+PyObject* SharedDict::delete_(SharedDict* self, PyObject* key) {
+  std::string_view k;
+  if(!unpack_key(key, k))
+    return nullptr;
+  return PyBool_FromLong(self->table.remove(k) == Result::Ok);
+}
+
+PyObject* SharedDict::clear(SharedDict* self, PyObject*) {
+  self->table.clear();
+  Py_RETURN_NONE;
+}
+
+Py_ssize_t SharedDict::length(SharedDict* self) {
+  return self->table.size();
+}
+
+PyObject* SharedDict::subscript(SharedDict* self, PyObject* key) {
+  std::string_view k;
+  if(!unpack_key(key, k))
+    return nullptr;
+
+  Type type;
+  if(self->table.get(k, type, scratch) == Result::Missing) {
+    PyErr_SetObject(PyExc_KeyError, key);
+    return nullptr;
+  }
+  return pack_value(type, scratch);
+}
+
+int SharedDict::ass_subscript(SharedDict* self, PyObject* key,
+    PyObject* value) {
+  std::string_view k;
+  if(!unpack_key(key, k))
+    return -1;
+
+  if(!value) {
+    if(self->table.remove(k) == Result::Missing) {
+      PyErr_SetObject(PyExc_KeyError, key);
+      return -1;
+    }
+    return 0;
+  }
+
+  Value v;
+  if(!v.unpack(value) || !check(self->table.set(k, v.type, v.data, 0)))
+    return -1;
+  return 0;
+}
+
+int SharedDict::contains(SharedDict* self, PyObject* key) {
+  std::string_view k;
+  if(!unpack_key(key, k))
+    return -1;
+
+  Type type;
+  return self->table.get(k, type, scratch) == Result::Ok;
+}
+
+void SharedDict::init_type(PyTypeObject* SharedDictType) {
+  static std::array<PyMethodDef, 6> meths {
+      PyMethodDef {"get", (PyCFunction) get, METH_VARARGS | METH_KEYWORDS},
+      {"set", (PyCFunction) set, METH_VARARGS | METH_KEYWORDS},
+      {"incr", (PyCFunction) incr, METH_VARARGS | METH_KEYWORDS},
+      {"delete", (PyCFunction) delete_, METH_O},
+      {"clear", (PyCFunction) clear, METH_NOARGS},
+      {nullptr, nullptr},
+  };
+
+  static PyMappingMethods mapping {
+      .mp_length = (lenfunc) length,
+      .mp_subscript = (binaryfunc) subscript,
+      .mp_ass_subscript = (objobjargproc) ass_subscript,
+  };
+
+  static PySequenceMethods sequence {
+      .sq_contains = (objobjproc) contains,
+  };
+
+  *SharedDictType = PyTypeObject {
+      .tp_name = "velocem.SharedDict",
+      .tp_basicsize = sizeof(SharedDict),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_as_sequence = &sequence,
+      .tp_as_mapping = &mapping,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_doc = "Fixed-size key/value store shared with forked workers",
+      .tp_methods = meths.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(SharedDictType);
+}
+
+} // namespace velocem
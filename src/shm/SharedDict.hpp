@@ -0,0 +1,37 @@
+#ifndef VELOCEM_SHM_SHAREDDICT_HPP
+#define VELOCEM_SHM_SHAREDDICT_HPP
+
+#include <Python.h>
+
+#include "ShmTable.hpp"
+
+namespace velocem {
+
+// velocem.SharedDict, a Python mapping over a ShmTable. It must be created
+// before workers are forked for them to share it. Keys are str or bytes,
+// compared by their UTF-8 encoding, and values are bytes, str, int or float.
+struct SharedDict : PyObject {
+  ShmTable table;
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* SharedDictType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(SharedDict* self);
+
+  static PyObject* get(SharedDict* self, PyObject* args, PyObject* kwds);
+  static PyObject* set(SharedDict* self, PyObject* args, PyObject* kwds);
+  static PyObject* incr(SharedDict* self, PyObject* args, PyObject* kwds);
+  static PyObject* delete_(SharedDict* self, PyObject* key);
+  static PyObject* clear(SharedDict* self, PyObject*);
+
+  static Py_ssize_t length(SharedDict* self);
+  static PyObject* subscript(SharedDict* self, PyObject* key);
+  static int ass_subscript(SharedDict* self, PyObject* key, PyObject* value);
+  static int contains(SharedDict* self, PyObject* key);
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_SHM_SHAREDDICT_HPP
@@ -0,0 +1,318 @@
+#include "ShmTable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "plat/plat.hpp"
+#include "util/Hash.hpp"
+
+namespace velocem {
+
+struct ShmTable::Header {
+  std::uint32_t nshards;
+  std::uint32_t slots_per_shard;
+  std::uint32_t slot_size;
+  std::uint32_t item_size;
+};
+
+struct alignas(64) ShmTable::Shard {
+  std::atomic<std::uint32_t> lock;
+  std::atomic<std::uint32_t> used;
+};
+
+struct ShmTable::Slot {
+  std::uint64_t hash; // 0 marks an empty slot
+  std::int64_t expires;
+  std::uint32_t key_len;
+  std::uint32_t val_len;
+  Type type;
+
+  char* data() {
+    return reinterpret_cast<char*>(this + 1);
+  }
+};
+
+namespace {
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+    "Shared memory locks must not depend on process-local state");
+
+constexpr std::size_t max_shards {64};
+constexpr std::size_t min_shard_slots {32};
+constexpr std::size_t header_size {64};
+
+// Locks are held for a probe and a memcpy, spin briefly and then yield
+class SpinGuard {
+public:
+  explicit SpinGuard(std::atomic<std::uint32_t>& lock) : lock_ {lock} {
+    for(unsigned spins {0};;) {
+      if(!lock_.exchange(1, std::memory_order_acquire))
+        return;
+      while(lock_.load(std::memory_order_relaxed))
+        if(++spins > 64)
+          std::this_thread::yield();
+    }
+  }
+
+  ~SpinGuard() {
+    lock_.store(0, std::memory_order_release);
+  }
+
+private:
+  std::atomic<std::uint32_t>& lock_;
+};
+
+std::int64_t now_ns() {
+  // steady_clock is system-wide, every worker agrees on it
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::uint64_t key_hash(std::string_view key) {
+  return hash_bytes(key.data(), key.size()) | 1;
+}
+
+} // namespace
+
+ShmTable::~ShmTable() {
+  if(base_)
+    unmap_shared(base_, size_);
+}
+
+bool ShmTable::open(std::size_t size, std::size_t item_size) {
+  std::size_t slot_size {(sizeof(Slot) + item_size + 7) & ~std::size_t {7}};
+  std::size_t nshards {
+      std::clamp(size / slot_size / min_shard_slots, std::size_t {1},
+          max_shards)};
+  std::size_t overhead {header_size + nshards * sizeof(Shard)};
+  if(size <= overhead)
+    return false;
+
+  std::size_t sps {(size - overhead) / slot_size / nshards};
+  if(!sps || sps > UINT32_MAX || slot_size > UINT32_MAX)
+    return false;
+
+  base_ = map_shared(size);
+  if(!base_)
+    return false;
+  size_ = size;
+
+  hdr_ = new(base_) Header {
+      .nshards = static_cast<std::uint32_t>(nshards),
+      .slots_per_shard = static_cast<std::uint32_t>(sps),
+      .slot_size = static_cast<std::uint32_t>(slot_size),
+      .item_size = static_cast<std::uint32_t>(item_size),
+  };
+  auto shards {static_cast<char*>(base_) + header_size};
+  for(std::size_t i {0}; i < nshards; ++i)
+    new(shards + i * sizeof(Shard)) Shard {};
+  return true;
+}
+
+std::size_t ShmTable::item_size() const {
+  return hdr_->item_size;
+}
+
+ShmTable::Shard& ShmTable::shard_for(std::uint64_t hash) const {
+  auto shards {reinterpret_cast<Shard*>(static_cast<char*>(base_) +
+      header_size)};
+  return shards[hash % hdr_->nshards];
+}
+
+ShmTable::Slot* ShmTable::slot(const Shard& shard, std::size_t idx) const {
+  auto shards {reinterpret_cast<const Shard*>(static_cast<char*>(base_) +
+      header_size)};
+  std::size_t nshard = &shard - shards;
+  char* slots {static_cast<char*>(base_) + header_size +
+      hdr_->nshards * sizeof(Shard)};
+  return reinterpret_cast<Slot*>(slots +
+      (nshard * hdr_->slots_per_shard + idx) * hdr_->slot_size);
+}
+
+std::ptrdiff_t ShmTable::probe(Shard& shard, std::uint64_t hash,
+    std::string_view key, std::int64_t now, bool& found) {
+  std::size_t sps {hdr_->slots_per_shard};
+  std::size_t idx {(hash / hdr_->nshards) % sps};
+  std::ptrdiff_t reuse {-1};
+  found = false;
+
+  for(std::size_t n {0}; n < sps; ++n, idx = idx + 1 == sps ? 0 : idx + 1) {
+    Slot* s {slot(shard, idx)};
+    if(!s->hash)
+      return reuse >= 0 ? reuse : static_cast<std::ptrdiff_t>(idx);
+
+    bool expired {s->expires && s->expires <= now};
+    if(s->hash == hash && s->key_len == key.size() &&
+        !std::memcmp(s->data(), key.data(), key.size())) {
+      // An expired copy of the key is reused in place
+      found = !expired;
+      return idx;
+    }
+
+    if(expired && reuse < 0)
+      reuse = idx;
+  }
+  return reuse;
+}
+
+// Linear probing can't leave holes in a probe sequence, later slots whose
+// home precedes the hole are shifted back into it
+void ShmTable::erase_at(Shard& shard, std::size_t idx) {
+  std::size_t sps {hdr_->slots_per_shard};
+  std::size_t hole {idx};
+
+  for(std::size_t j {hole};;) {
+    j = j + 1 == sps ? 0 : j + 1;
+    Slot* s {slot(shard, j)};
+    if(!s->hash)
+      break;
+
+    std::size_t home {(s->hash / hdr_->nshards) % sps};
+    bool stays {hole <= j ? hole < home && home <= j
+                          : hole < home || home <= j};
+    if(stays)
+      continue;
+
+    std::memcpy(slot(shard, hole), s, sizeof(Slot) + s->key_len + s->val_len);
+    hole = j;
+  }
+
+  slot(shard, hole)->hash = 0;
+  shard.used.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ShmTable::Result ShmTable::get(std::string_view key, Type& type,
+    std::string& out) {
+  std::uint64_t hash {key_hash(key)};
+  Shard& shard {shard_for(hash)};
+  SpinGuard guard {shard.lock};
+
+  bool found;
+  std::ptrdiff_t idx {probe(shard, hash, key, now_ns(), found)};
+  if(!found)
+    return Result::Missing;
+
+  Slot* s {slot(shard, idx)};
+  type = s->type;
+  out.assign(s->data() + s->key_len, s->val_len);
+  return Result::Ok;
+}
+
+ShmTable::Result ShmTable::set(std::string_view key, Type type,
+    std::string_view value, std::int64_t ttl) {
+  if(key.size() + value.size() > hdr_->item_size)
+    return Result::TooLarge;
+
+  std::uint64_t hash {key_hash(key)};
+  Shard& shard {shard_for(hash)};
+  SpinGuard guard {shard.lock};
+
+  bool found;
+  std::int64_t now {now_ns()};
+  std::ptrdiff_t idx {probe(shard, hash, key, now, found)};
+  if(idx < 0)
+    return Result::Full;
+
+  Slot* s {slot(shard, idx)};
+  if(!s->hash)
+    shard.used.fetch_add(1, std::memory_order_relaxed);
+
+  s->hash = hash;
+  s->expires = ttl ? now + ttl : 0;
+  s->key_len = static_cast<std::uint32_t>(key.size());
+  s->val_len = static_cast<std::uint32_t>(value.size());
+  s->type = type;
+  std::memcpy(s->data(), key.data(), key.size());
+  std::memcpy(s->data() + key.size(), value.data(), value.size());
+  return Result::Ok;
+}
+
+ShmTable::Result ShmTable::remove(std::string_view key) {
+  std::uint64_t hash {key_hash(key)};
+  Shard& shard {shard_for(hash)};
+  SpinGuard guard {shard.lock};
+
+  bool found;
+  std::ptrdiff_t idx {probe(shard, hash, key, now_ns(), found)};
+  if(!found)
+    return Result::Missing;
+
+  erase_at(shard, idx);
+  return Result::Ok;
+}
+
+ShmTable::Result ShmTable::incr(std::string_view key, std::int64_t delta,
+    std::int64_t init, std::int64_t ttl, std::int64_t& out) {
+  if(key.size() + sizeof(std::int64_t) > hdr_->item_size)
+    return Result::TooLarge;
+
+  std::uint64_t hash {key_hash(key)};
+  Shard& shard {shard_for(hash)};
+  SpinGuard guard {shard.lock};
+
+  bool found;
+  std::int64_t now {now_ns()};
+  std::ptrdiff_t idx {probe(shard, hash, key, now, found)};
+  if(idx < 0)
+    return Result::Full;
+
+  Slot* s {slot(shard, idx)};
+  char* val {s->data() + key.size()};
+
+  if(found) {
+    if(s->type != Type::Int)
+      return Result::NotInt;
+    std::int64_t cur;
+    std::memcpy(&cur, val, sizeof(cur));
+    out = static_cast<std::int64_t>(static_cast<std::uint64_t>(cur) +
+        static_cast<std::uint64_t>(delta));
+    std::memcpy(val, &out, sizeof(out));
+    return Result::Ok;
+  }
+
+  if(!s->hash)
+    shard.used.fetch_add(1, std::memory_order_relaxed);
+
+  out = static_cast<std::int64_t>(static_cast<std::uint64_t>(init) +
+      static_cast<std::uint64_t>(delta));
+  s->hash = hash;
+  s->expires = ttl ? now + ttl : 0;
+  s->key_len = static_cast<std::uint32_t>(key.size());
+  s->val_len = sizeof(out);
+  s->type = Type::Int;
+  std::memcpy(s->data(), key.data(), key.size());
+  std::memcpy(val, &out, sizeof(out));
+  return Result::Ok;
+}
+
+void ShmTable::clear() {
+  auto shards {reinterpret_cast<Shard*>(static_cast<char*>(base_) +
+      header_size)};
+  for(std::size_t i {0}; i < hdr_->nshards; ++i) {
+    Shard& shard {shards[i]};
+    SpinGuard guard {shard.lock};
+    for(std::size_t j {0}; j < hdr_->slots_per_shard; ++j)
+      slot(shard, j)->hash = 0;
+    shard.used.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::size_t ShmTable::size() const {
+  auto shards {reinterpret_cast<const Shard*>(static_cast<char*>(base_) +
+      header_size)};
+  std::size_t total {0};
+  for(std::size_t i {0}; i < hdr_->nshards; ++i)
+    total += shards[i].used.load(std::memory_order_relaxed);
+  return total;
+}
+
+} // namespace velocem
@@ -0,0 +1,84 @@
+#ifndef VELOCEM_SHM_SHMTABLE_HPP
+#define VELOCEM_SHM_SHMTABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace velocem {
+
+// Fixed-size hash table living in a shared mapping, so every worker forked
+// after it is created sees the same contents. The table is split into shards,
+// each an independent open-addressing table behind its own spinlock, and a
+// key's hash picks its shard. Slots are a fixed size, every item's key and
+// value together must fit in item_size bytes.
+//
+// Expiry is lazy, expired items read as missing and their slots are reused by
+// later inserts.
+class ShmTable {
+public:
+  enum class Type : std::uint8_t {
+    Bytes,
+    Str,
+    Int,
+    Float,
+  };
+
+  enum class Result {
+    Ok,
+    Missing,
+    Full,     // No free or expired slot in the key's shard
+    TooLarge, // Key and value exceed item_size
+    NotInt,   // incr() on a value which isn't an integer
+  };
+
+  ShmTable() = default;
+  ShmTable(ShmTable&) = delete;
+  ~ShmTable();
+
+  bool open(std::size_t size, std::size_t item_size);
+
+  std::size_t item_size() const;
+
+  // Copies the value out, type and bytes are written to the out parameters
+  Result get(std::string_view key, Type& type, std::string& out);
+
+  // ttl is in nanoseconds, 0 never expires
+  Result set(std::string_view key, Type type, std::string_view value,
+      std::int64_t ttl);
+
+  Result remove(std::string_view key);
+
+  // Adds delta to an integer value, missing keys start from init and take
+  // the ttl. Existing keys keep their expiry.
+  Result incr(std::string_view key, std::int64_t delta, std::int64_t init,
+      std::int64_t ttl, std::int64_t& out);
+
+  void clear();
+
+  // Live and not yet reclaimed expired items, shards are read without locking
+  std::size_t size() const;
+
+private:
+  struct Header;
+  struct Shard;
+  struct Slot;
+
+  Shard& shard_for(std::uint64_t hash) const;
+  Slot* slot(const Shard& shard, std::size_t idx) const;
+
+  // Index of the key's slot, or of the slot an insert should use with found
+  // cleared. Returns -1 if the key is missing and there's no room for it.
+  std::ptrdiff_t probe(Shard& shard, std::uint64_t hash, std::string_view key,
+      std::int64_t now, bool& found);
+  void erase_at(Shard& shard, std::size_t idx);
+
+  void* base_ {nullptr};
+  std::size_t size_ {0};
+  Header* hdr_ {nullptr};
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_SHM_SHMTABLE_HPP
@@ -1,21 +1,25 @@
 #ifndef VELOCEM_BALM_STRINGVIEW_HPP
 #define VELOCEM_BALM_STRINGVIEW_HPP
 
-#include <array>
 #include <cstdlib>
-#include <functional>
 #include <string_view>
 
 #include <Python.h>
 
 #include "Constants.hpp"
 
+namespace velocem {
+struct WSGIRequest;
+}
+
 namespace velocem {
 
+// A non-owning str view into a request buffer. Deallocation doesn't free
+// anything, it drops a reference on the owning request.
 struct BalmStringView : PyUnicodeObject {
-  BalmStringView(std::function<void(BalmStringView*)> f_dealloc,
-      char* base = nullptr, std::size_t length = 0)
-      : f_dealloc_ {f_dealloc} {
+  BalmStringView(WSGIRequest* owner, char* base = nullptr,
+      std::size_t length = 0)
+      : owner_ {owner} {
 
     data.any = base;
     _base = {
@@ -23,6 +27,7 @@ struct BalmStringView : PyUnicodeObject {
             {
                 .ob_base = {.ob_type = &gVT.BalmStringViewType},
                 .length = (Py_ssize_t) length,
+                .hash = -1,
                 .state = {.kind = PyUnicode_1BYTE_KIND, .ascii = 1},
             },
         .utf8_length = (Py_ssize_t) length,
@@ -35,16 +40,23 @@ struct BalmStringView : PyUnicodeObject {
     _base.utf8 = at;
     _base.utf8_length = length;
     _base._base.length = length;
+    _base._base.hash = -1;
   }
 
   void extend(std::size_t length) {
     _base.utf8_length += length;
     _base._base.length += length;
+    _base._base.hash = -1;
   }
 
   void resize(std::size_t length) {
     _base.utf8_length = length;
     _base._base.length = length;
+    _base._base.hash = -1;
+  }
+
+  std::string_view view() const {
+    return {_base.utf8, (std::size_t) _base.utf8_length};
   }
 
 private:
@@ -56,16 +68,13 @@ private:
     BalmStringViewType->tp_dealloc = BalmStringView::dealloc;
   }
 
-  const std::function<void(BalmStringView*)> f_dealloc_;
+  WSGIRequest* owner_;
 
-  static void dealloc(PyObject* self) {
-    auto ptr {reinterpret_cast<BalmStringView*>(self)};
-    ptr->f_dealloc_(ptr);
-  }
+  static void dealloc(PyObject* self);
 };
 
 inline auto format_as(BalmStringView sv) {
-  return std::string_view {sv._base.utf8, (std::size_t) sv._base.utf8_length};
+  return sv.view();
 }
 
 } // namespace velocem
@@ -7,12 +7,40 @@
 #include <string_view>
 
 #include "BalmStringView.hpp"
+#include "form/QueryDict.hpp"
+#include "http/Request.hpp"
+#include "http/Response.hpp"
+#include "router/Router.hpp"
+#include "shm/SharedDict.hpp"
+#include "wsgi/Channel.hpp"
+#include "wsgi/FileWrapper.hpp"
 #include "wsgi/Input.hpp"
 
 using std::operator""sv;
 
 namespace velocem {
 
+namespace {
+
+#define HTTP_METHOD(c, n) std::string_view {#n},
+constexpr std::array method_names {
+#include "defs/http_method.def"
+};
+#undef HTTP_METHOD
+
+} // namespace
+
+HTTPMethod str2meth(std::string_view str) {
+  for(std::size_t i {0}; i < method_names.size(); ++i)
+    if(method_names[i] == str)
+      return static_cast<HTTPMethod>(i);
+  return HTTPMethod::INVALID;
+}
+
+std::string_view meth2str(HTTPMethod meth) {
+  return method_names[static_cast<std::size_t>(meth)];
+}
+
 std::string gRequiredHeaders {std::format(gRequiredHeadersFormat,
     std::chrono::floor<std::chrono::seconds>(
         std::chrono::system_clock::now()))};
@@ -32,6 +60,10 @@ void init_gPO() {
   gPO.conlen = PyUnicode_InternFromString("CONTENT_LENGTH");
   gPO.http_contype = PyUnicode_InternFromString("HTTP_CONTENT_TYPE");
   gPO.contype = PyUnicode_InternFromString("CONTENT_TYPE");
+  gPO.http_inm = PyUnicode_InternFromString("HTTP_IF_NONE_MATCH");
+  gPO.http_range = PyUnicode_InternFromString("HTTP_RANGE");
+  gPO.http_if_range = PyUnicode_InternFromString("HTTP_IF_RANGE");
+  gPO.http_accept_enc = PyUnicode_InternFromString("HTTP_ACCEPT_ENCODING");
   gPO.meth = PyUnicode_InternFromString("REQUEST_METHOD");
   gPO.wsgi_ver = PyTuple_Pack(2, PyLong_FromLong(1), PyLong_FromLong(0));
   gPO.wsgi_input = PyUnicode_InternFromString("wsgi.input");
@@ -46,9 +78,22 @@ void init_gPO() {
 
 GlobalVelocemTypes gVT;
 
-void init_gVT(PyObject* /*mod*/) {
+void init_gVT(PyObject* mod) {
   BalmStringView::init_type(&gVT.BalmStringViewType);
   WSGIInput::init_type(&gVT.WSGIInputType);
+  FileWrapper::init_type(&gVT.FileWrapperType);
+  SharedDict::init_type(&gVT.SharedDictType);
+  PyModule_AddObjectRef(mod, "SharedDict", (PyObject*) &gVT.SharedDictType);
+  Router::init_type(&gVT.RouterType);
+  PyModule_AddObjectRef(mod, "Router", (PyObject*) &gVT.RouterType);
+  HTTPRequest::init_type(&gVT.HTTPRequestType);
+  PyModule_AddObjectRef(mod, "Request", (PyObject*) &gVT.HTTPRequestType);
+  HTTPResponse::init_type(&gVT.HTTPResponseType);
+  PyModule_AddObjectRef(mod, "Response", (PyObject*) &gVT.HTTPResponseType);
+  QueryDict::init_type(&gVT.QueryDictType);
+  PyModule_AddObjectRef(mod, "QueryDict", (PyObject*) &gVT.QueryDictType);
+  Channel::init_type(&gVT.ChannelType);
+  PyModule_AddObjectRef(mod, "Channel", (PyObject*) &gVT.ChannelType);
 }
 
 void init_globals(PyObject* mod) {
@@ -62,6 +62,7 @@ enum class HTTPMethod {
 };
 
 HTTPMethod str2meth(std::string_view str);
+std::string_view meth2str(HTTPMethod meth);
 
 constexpr char gRequiredHeadersFormat[] {
     "Server: Velocem/0.0.13\r\nDate: {:%a, %d %b %Y %T} GMT\r\n"};
@@ -81,6 +82,10 @@ struct GlobalPythonObjects {
   PyObject* conlen;
   PyObject* http_contype;
   PyObject* contype;
+  PyObject* http_inm;
+  PyObject* http_range;
+  PyObject* http_if_range;
+  PyObject* http_accept_enc;
   PyObject* meth;
   PyObject* wsgi_ver;
   PyObject* wsgi_input;
@@ -96,6 +101,13 @@ void init_gPO();
 struct GlobalVelocemTypes {
   PyTypeObject BalmStringViewType;
   PyTypeObject WSGIInputType;
+  PyTypeObject FileWrapperType;
+  PyTypeObject SharedDictType;
+  PyTypeObject RouterType;
+  PyTypeObject HTTPRequestType;
+  PyTypeObject HTTPResponseType;
+  PyTypeObject QueryDictType;
+  PyTypeObject ChannelType;
 };
 
 extern GlobalVelocemTypes gVT;
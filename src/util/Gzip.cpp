@@ -0,0 +1,154 @@
+#include "Gzip.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+
+#include <zlib.h>
+
+#include "OutputBuffer.hpp"
+
+namespace velocem {
+
+namespace {
+
+// windowBits above 15 selects the gzip wrapper instead of zlib's
+constexpr int gzip_window_bits {15 + 16};
+constexpr int gzip_mem_level {8};
+
+constexpr std::size_t min_out {std::size_t {4} << 10};
+constexpr std::size_t max_in {std::size_t {1} << 30};
+
+void destroy(z_stream* zs) {
+  deflateEnd(zs);
+  delete zs;
+}
+
+} // namespace
+
+GzipPool gGzipPool;
+
+GzipPool::~GzipPool() {
+  for(z_stream* zs : idle_)
+    destroy(zs);
+}
+
+z_stream* GzipPool::pop() {
+  if(!idle_.empty()) {
+    z_stream* zs {idle_.back()};
+    idle_.pop_back();
+    low_water_ = std::min(low_water_, idle_.size());
+    return zs;
+  }
+
+  z_stream* zs {new z_stream {}};
+  if(deflateInit2(zs, level_, Z_DEFLATED, gzip_window_bits, gzip_mem_level,
+         Z_DEFAULT_STRATEGY) != Z_OK) {
+    delete zs;
+    throw std::bad_alloc {};
+  }
+  return zs;
+}
+
+void GzipPool::push(z_stream* zs) {
+  if(deflateReset(zs) != Z_OK) [[unlikely]] {
+    destroy(zs);
+    return;
+  }
+  idle_.push_back(zs);
+}
+
+void GzipPool::trim() {
+  std::size_t surplus {low_water_};
+  for(; surplus; --surplus) {
+    destroy(idle_.back());
+    idle_.pop_back();
+  }
+  if(idle_.empty())
+    idle_.shrink_to_fit();
+  low_water_ = idle_.size();
+}
+
+void gzip_append(z_stream* zs, const char* data, std::size_t len, int flush,
+    OutputBuffer& out) {
+  out.reserve(std::max<std::size_t>(deflateBound(zs, std::min(len, max_in)),
+      min_out));
+
+  // avail_in is only an unsigned int, feed huge bodies in pieces
+  do {
+    std::size_t piece {std::min(len, max_in)};
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs->avail_in = static_cast<uInt>(piece);
+    data += piece;
+    len -= piece;
+    int mode {len ? Z_NO_FLUSH : flush};
+
+    for(;;) {
+      zs->next_out = reinterpret_cast<Bytef*>(out.tail());
+      zs->avail_out = static_cast<uInt>(std::min<std::size_t>(out.spare(),
+          UINT_MAX));
+      int err {deflate(zs, mode)};
+      out.commit(reinterpret_cast<char*>(zs->next_out) - out.tail());
+
+      if(err == Z_STREAM_ERROR) [[unlikely]]
+        throw std::runtime_error {"zlib deflate error"};
+
+      // Output space left over means deflate() has caught up with the input
+      // and the flush, except Z_FINISH which has its own end marker.
+      // Z_BUF_ERROR only means there was nothing left to do.
+      if(err == Z_STREAM_END || err == Z_BUF_ERROR ||
+          (mode != Z_FINISH && zs->avail_out))
+        break;
+      out.reserve(std::max(out.capacity() / 2, min_out));
+    }
+  } while(len);
+}
+
+bool accepts_gzip(std::string_view list) {
+  auto trim {[](std::string_view str) {
+    while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+      str.remove_prefix(1);
+    while(!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+      str.remove_suffix(1);
+    return str;
+  }};
+  auto is_gzip {[](std::string_view coding) {
+    if(coding.size() == 6 && (coding[0] | 0x20) == 'x' && coding[1] == '-')
+      coding.remove_prefix(2);
+    if(coding.size() != 4)
+      return false;
+    for(std::size_t i {0}; i < 4; ++i)
+      if((coding[i] | 0x20) != "gzip"[i])
+        return false;
+    return true;
+  }};
+
+  bool gzip {false}, star {false}, gzip_seen {false};
+  while(!list.empty()) {
+    std::size_t comma {list.find(',')};
+    std::string_view item {list.substr(0, comma)};
+    list.remove_prefix(comma == list.npos ? list.size() : comma + 1);
+
+    std::size_t semi {item.find(';')};
+    std::string_view coding {trim(item.substr(0, semi))};
+    bool ok {true};
+    if(semi != item.npos) {
+      std::string_view param {trim(item.substr(semi + 1))};
+      if(param.size() >= 3 && (param[0] | 0x20) == 'q' && param[1] == '=')
+        ok = param.substr(2).find_first_not_of("0.") != param.npos;
+    }
+
+    if(is_gzip(coding)) {
+      gzip = ok;
+      gzip_seen = true;
+    } else if(coding == "*") {
+      star = ok;
+    }
+  }
+  return gzip_seen ? gzip : star;
+}
+
+} // namespace velocem
@@ -0,0 +1,53 @@
+#ifndef VELOCEM_GZIP_HPP
+#define VELOCEM_GZIP_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+#include "OutputBuffer.hpp"
+
+namespace velocem {
+
+// Initialized deflate streams producing gzip framing. Setting up a stream costs
+// a few hundred kilobytes of window and hash tables, so finished streams are
+// reset and kept for the next response rather than torn down. Like ObjectPool,
+// trim() frees streams that sat idle through a whole interval.
+class GzipPool {
+public:
+  GzipPool() = default;
+  GzipPool(GzipPool&) = delete;
+  ~GzipPool();
+
+  // Only affects streams created after the call
+  void set_level(int level) {
+    level_ = level;
+  }
+
+  z_stream* pop();
+  void push(z_stream* zs);
+  void trim();
+
+private:
+  std::vector<z_stream*> idle_;
+  std::size_t low_water_ {0};
+  int level_ {Z_DEFAULT_COMPRESSION};
+};
+
+extern GzipPool gGzipPool;
+
+// Compresses len bytes into out. flush is passed through to deflate(),
+// Z_SYNC_FLUSH makes everything so far decodable by the client and Z_FINISH
+// writes the gzip trailer.
+void gzip_append(z_stream* zs, const char* data, std::size_t len, int flush,
+    OutputBuffer& out);
+
+// Accept-Encoding permits gzip unless it, or the wildcard covering it, is
+// listed with q=0
+bool accepts_gzip(std::string_view list);
+
+} // namespace velocem
+
+#endif // VELOCEM_GZIP_HPP
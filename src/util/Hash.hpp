@@ -0,0 +1,91 @@
+#ifndef VELOCEM_HASH_HPP
+#define VELOCEM_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace velocem {
+
+// Small non-cryptographic hash in the style of wyhash. Good enough to key
+// in-process caches, never use it for anything an attacker can exploit without
+// also verifying the full key.
+namespace hash_detail {
+
+constexpr std::uint64_t p0 {0xa0761d6478bd642full};
+constexpr std::uint64_t p1 {0xe7037ed1a0b428dbull};
+constexpr std::uint64_t p2 {0x8ebc6af09c88c6e3ull};
+
+inline std::uint64_t mum(std::uint64_t a, std::uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r {static_cast<__uint128_t>(a) * b};
+  return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+#else
+  std::uint64_t ha {a >> 32}, la {a & 0xffffffff};
+  std::uint64_t hb {b >> 32}, lb {b & 0xffffffff};
+  std::uint64_t rh {ha * hb}, rm0 {ha * lb}, rm1 {hb * la}, rl {la * lb};
+  std::uint64_t t {rl + (rm0 << 32)};
+  std::uint64_t lo {t + (rm1 << 32)};
+  std::uint64_t hi {rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t)};
+  return lo ^ hi;
+#endif
+}
+
+inline std::uint64_t read8(const unsigned char* p) {
+  std::uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+inline std::uint64_t read4(const unsigned char* p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+} // namespace hash_detail
+
+inline std::uint64_t hash_bytes(const void* data, std::size_t len,
+    std::uint64_t seed = 0) {
+  using namespace hash_detail;
+
+  auto p {static_cast<const unsigned char*>(data)};
+  seed ^= p0;
+  std::uint64_t a, b;
+
+  if(len <= 16) {
+    if(len >= 4) {
+      a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+      b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+    } else if(len) {
+      a = (std::uint64_t {p[0]} << 16) | (std::uint64_t {p[len >> 1]} << 8) |
+          p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    std::size_t i {len};
+    for(; i > 16; i -= 16, p += 16)
+      seed = mum(read8(p) ^ p1, read8(p + 8) ^ seed);
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+
+  return mum(p1 ^ len, mum(a ^ p1, b ^ seed) ^ p2);
+}
+
+// For unordered containers keyed on std::string, lets find() take a
+// std::string_view without materializing a key
+struct StringHash {
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view str) const {
+    return hash_bytes(str.data(), str.size());
+  }
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_HASH_HPP
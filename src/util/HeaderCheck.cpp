@@ -0,0 +1,258 @@
+#include "HeaderCheck.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VELOCEM_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VELOCEM_NEON
+#endif
+
+namespace velocem {
+
+namespace {
+
+constexpr std::array<bool, 256> make_token_table() {
+  std::array<bool, 256> tbl {};
+  for(int c {'0'}; c <= '9'; ++c)
+    tbl[c] = true;
+  for(int c {'A'}; c <= 'Z'; ++c)
+    tbl[c] = tbl[c + 32] = true;
+  for(unsigned char c : std::string_view {"!#$%&'*+-.^_`|~"})
+    tbl[c] = true;
+  return tbl;
+}
+
+constexpr std::array<bool, 256> make_value_table() {
+  std::array<bool, 256> tbl {};
+  tbl['\t'] = true;
+  for(int c {0x20}; c < 256; ++c)
+    tbl[c] = c != 0x7F;
+  return tbl;
+}
+
+constexpr auto token_table {make_token_table()};
+constexpr auto value_table {make_value_table()};
+
+bool scalar_check(const std::array<bool, 256>& tbl, const unsigned char* p,
+    std::size_t len) {
+  bool ok {true};
+  for(std::size_t i {0}; i < len; ++i)
+    ok &= tbl[p[i]];
+  return ok;
+}
+
+bool scalar_copy(const std::array<bool, 256>& tbl, unsigned char* dst,
+    const unsigned char* src, std::size_t len) {
+  bool ok {true};
+  for(std::size_t i {0}; i < len; ++i)
+    ok &= tbl[dst[i] = src[i]];
+  return ok;
+}
+
+#if defined(VELOCEM_SSE2)
+
+using Vec = __m128i;
+
+Vec load(const unsigned char* p) {
+  return _mm_loadu_si128(reinterpret_cast<const Vec*>(p));
+}
+
+void store(unsigned char* p, Vec v) {
+  _mm_storeu_si128(reinterpret_cast<Vec*>(p), v);
+}
+
+Vec splat(unsigned char c) {
+  return _mm_set1_epi8(static_cast<char>(c));
+}
+
+Vec eq(Vec a, unsigned char c) {
+  return _mm_cmpeq_epi8(a, splat(c));
+}
+
+// Unsigned lo <= a <= hi
+Vec in_range(Vec a, unsigned char lo, unsigned char hi) {
+  Vec ge {_mm_cmpeq_epi8(_mm_max_epu8(a, splat(lo)), a)};
+  Vec le {_mm_cmpeq_epi8(_mm_min_epu8(a, splat(hi)), a)};
+  return _mm_and_si128(ge, le);
+}
+
+Vec vor(Vec a, Vec b) {
+  return _mm_or_si128(a, b);
+}
+
+Vec vandnot(Vec a, Vec b) {
+  return _mm_andnot_si128(b, a);
+}
+
+bool any(Vec a) {
+  return _mm_movemask_epi8(a);
+}
+
+#elif defined(VELOCEM_NEON)
+
+using Vec = uint8x16_t;
+
+Vec load(const unsigned char* p) {
+  return vld1q_u8(p);
+}
+
+void store(unsigned char* p, Vec v) {
+  vst1q_u8(p, v);
+}
+
+Vec eq(Vec a, unsigned char c) {
+  return vceqq_u8(a, vdupq_n_u8(c));
+}
+
+Vec in_range(Vec a, unsigned char lo, unsigned char hi) {
+  return vandq_u8(vcgeq_u8(a, vdupq_n_u8(lo)), vcleq_u8(a, vdupq_n_u8(hi)));
+}
+
+Vec vor(Vec a, Vec b) {
+  return vorrq_u8(a, b);
+}
+
+Vec vandnot(Vec a, Vec b) {
+  return vbicq_u8(a, b);
+}
+
+bool any(Vec a) {
+  return vmaxvq_u8(a);
+}
+
+#endif
+
+#if defined(VELOCEM_SSE2) || defined(VELOCEM_NEON)
+
+// Lanes holding a byte which isn't a tchar
+Vec bad_token(Vec v) {
+  Vec bad {vor(in_range(v, 0x00, 0x20), in_range(v, 0x7F, 0xFF))};
+  bad = vor(bad, in_range(v, '(', ')'));
+  bad = vor(bad, in_range(v, ':', '@'));
+  bad = vor(bad, in_range(v, '[', ']'));
+  bad = vor(bad, vor(eq(v, '"'), eq(v, ',')));
+  bad = vor(bad, vor(eq(v, '/'), eq(v, '{')));
+  return vor(bad, eq(v, '}'));
+}
+
+// Lanes holding a control character other than HTAB
+Vec bad_value(Vec v) {
+  Vec bad {vandnot(in_range(v, 0x00, 0x1F), eq(v, '\t'))};
+  return vor(bad, eq(v, 0x7F));
+}
+
+template <auto Bad>
+bool simd_check(const std::array<bool, 256>& tbl, const unsigned char* p,
+    std::size_t len) {
+  std::size_t i {0};
+  for(; i + 16 <= len; i += 16)
+    if(any(Bad(load(p + i))))
+      return false;
+  return scalar_check(tbl, p + i, len - i);
+}
+
+// Validates and copies in one pass, each block is stored while it's checked
+template <auto Bad>
+bool simd_copy(const std::array<bool, 256>& tbl, unsigned char* dst,
+    const unsigned char* src, std::size_t len) {
+  std::size_t i {0};
+  for(; i + 16 <= len; i += 16) {
+    Vec v {load(src + i)};
+    store(dst + i, v);
+    if(any(Bad(v)))
+      return false;
+  }
+  return scalar_copy(tbl, dst + i, src + i, len - i);
+}
+
+#endif
+
+bool valid_token(const unsigned char* p, std::size_t len) {
+  if(!len)
+    return false;
+#if defined(VELOCEM_SSE2) || defined(VELOCEM_NEON)
+  return simd_check<bad_token>(token_table, p, len);
+#else
+  return scalar_check(token_table, p, len);
+#endif
+}
+
+bool iequals(const char* a, const char* lower, std::size_t len) {
+  for(std::size_t i {0}; i < len; ++i)
+    if((a[i] | 0x20) != lower[i])
+      return false;
+  return true;
+}
+
+} // namespace
+
+HeaderName classify_header_name(const char* name, std::size_t len) {
+  if(!valid_token(reinterpret_cast<const unsigned char*>(name), len))
+    [[unlikely]]
+    return HeaderName::Invalid;
+
+  // Once the name is known to be a token, | 0x20 only folds A-Z onto a-z
+  switch(len) {
+    case 4:
+      if(iequals(name, "date", 4))
+        return HeaderName::Date;
+      break;
+    case 6:
+      if(iequals(name, "server", 6))
+        return HeaderName::Server;
+      break;
+    case 10:
+      if(iequals(name, "connection", 10))
+        return HeaderName::Connection;
+      break;
+    case 14:
+      if(iequals(name, "content-length", 14))
+        return HeaderName::ContentLength;
+      break;
+  }
+  return HeaderName::Other;
+}
+
+bool valid_field_value(const char* value, std::size_t len) {
+  auto p {reinterpret_cast<const unsigned char*>(value)};
+#if defined(VELOCEM_SSE2) || defined(VELOCEM_NEON)
+  return simd_check<bad_value>(value_table, p, len);
+#else
+  return scalar_check(value_table, p, len);
+#endif
+}
+
+bool copy_field_value(char* dst, const char* value, std::size_t len) {
+  auto d {reinterpret_cast<unsigned char*>(dst)};
+  auto p {reinterpret_cast<const unsigned char*>(value)};
+#if defined(VELOCEM_SSE2) || defined(VELOCEM_NEON)
+  return simd_copy<bad_value>(value_table, d, p, len);
+#else
+  return scalar_copy(value_table, d, p, len);
+#endif
+}
+
+bool cgi_header_matches(std::string_view field, std::string_view name) {
+  if(field.size() != name.size() + 5)
+    return false;
+
+  field.remove_prefix(5);
+  for(std::size_t i {0}; i < name.size(); ++i) {
+    char c {name[i]};
+    if(c == '-')
+      c = '_';
+    else if(c >= 'a' && c <= 'z')
+      c &= 0xDF;
+    if(c != field[i])
+      return false;
+  }
+  return true;
+}
+
+} // namespace velocem
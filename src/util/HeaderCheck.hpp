@@ -0,0 +1,40 @@
+#ifndef VELOCEM_HEADERCHECK_HPP
+#define VELOCEM_HEADERCHECK_HPP
+
+#include <cstddef>
+#include <string_view>
+
+namespace velocem {
+
+// Response header names the server either owns or handles specially
+enum class HeaderName {
+  Invalid,
+  Other,
+  ContentLength,
+  Date,
+  Server,
+  Connection,
+};
+
+// Validates name as an RFC 9110 token and recognizes the special names,
+// case-insensitively
+HeaderName classify_header_name(const char* name, std::size_t len);
+
+// True if every byte is a valid field-value (or reason-phrase) character:
+// visible ASCII, SP, HTAB or obs-text. Rejects CR, LF, NUL and every other
+// control character, which is what keeps application supplied values from
+// splitting the response.
+bool valid_field_value(const char* value, std::size_t len);
+
+// valid_field_value() fused with copying the value to dst, so serializing a
+// header reads its value once. dst must have room for len bytes, its contents
+// are unspecified if the value is rejected.
+bool copy_field_value(char* dst, const char* value, std::size_t len);
+
+// Compares a header name as an app spells it, "User-Agent", against a request
+// header stored in its HTTP_ prefixed CGI form
+bool cgi_header_matches(std::string_view field, std::string_view name);
+
+} // namespace velocem
+
+#endif // VELOCEM_HEADERCHECK_HPP
@@ -0,0 +1,770 @@
+#include "Json.hpp"
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <Python.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VELOCEM_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VELOCEM_NEON
+#endif
+
+#include "Hash.hpp"
+#include "OutputBuffer.hpp"
+
+namespace velocem {
+
+namespace {
+
+// The character following the backslash, 'u' for the \u00XX form, 0 for
+// bytes written as-is
+constexpr std::array<char, 256> make_escape_table() {
+  std::array<char, 256> tbl {};
+  for(int c {0}; c < 0x20; ++c)
+    tbl[c] = 'u';
+  tbl['\b'] = 'b';
+  tbl['\f'] = 'f';
+  tbl['\n'] = 'n';
+  tbl['\r'] = 'r';
+  tbl['\t'] = 't';
+  tbl['"'] = '"';
+  tbl['\\'] = '\\';
+  return tbl;
+}
+
+constexpr auto escape_table {make_escape_table()};
+
+// Index of the first byte needing an escape, or len
+std::size_t find_escape(const unsigned char* p, std::size_t len) {
+  std::size_t i {0};
+
+#if defined(VELOCEM_SSE2)
+  const __m128i ctl {_mm_set1_epi8(0x1F)};
+  const __m128i quote {_mm_set1_epi8('"')};
+  const __m128i bslash {_mm_set1_epi8('\\')};
+  for(; i + 16 <= len; i += 16) {
+    __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))};
+    __m128i bad {_mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v)};
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, quote));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, bslash));
+    if(unsigned mask = _mm_movemask_epi8(bad))
+      return i + std::countr_zero(mask);
+  }
+#elif defined(VELOCEM_NEON)
+  for(; i + 16 <= len; i += 16) {
+    uint8x16_t v {vld1q_u8(p + i)};
+    uint8x16_t bad {vcleq_u8(v, vdupq_n_u8(0x1F))};
+    bad = vorrq_u8(bad, vceqq_u8(v, vdupq_n_u8('"')));
+    bad = vorrq_u8(bad, vceqq_u8(v, vdupq_n_u8('\\')));
+    // Narrowing shift packs the lanes into a nibble mask
+    std::uint64_t mask {vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(bad), 4)), 0)};
+    if(mask)
+      return i + (std::countr_zero(mask) >> 2);
+  }
+#endif
+
+  for(; i < len; ++i)
+    if(escape_table[p[i]])
+      return i;
+  return len;
+}
+
+void dump_string(const char* str, std::size_t len, OutputBuffer& buf) {
+  auto p {reinterpret_cast<const unsigned char*>(str)};
+  buf.reserve(len + 2);
+  buf.append_unchecked("\"", 1);
+
+  for(;;) {
+    std::size_t n {find_escape(p, len)};
+    buf.append(reinterpret_cast<const char*>(p), n);
+    if(n == len)
+      break;
+
+    unsigned char c {p[n]};
+    p += n + 1;
+    len -= n + 1;
+
+    char esc {escape_table[c]};
+    if(esc != 'u') {
+      char out[] {'\\', esc};
+      buf.append(out, sizeof(out));
+    } else {
+      char out[] {'\\', 'u', '0', '0', "0123456789abcdef"[c >> 4],
+          "0123456789abcdef"[c & 0xF]};
+      buf.append(out, sizeof(out));
+    }
+  }
+  buf.append("\"");
+}
+
+[[noreturn]] void throw_py() {
+  throw std::runtime_error {"Python JSON error"};
+}
+
+void dump_unicode(PyObject* obj, OutputBuffer& buf) {
+  Py_ssize_t len;
+  const char* str {PyUnicode_AsUTF8AndSize(obj, &len)};
+  if(!str) [[unlikely]]
+    throw_py();
+  dump_string(str, len, buf);
+}
+
+void dump_long(PyObject* obj, OutputBuffer& buf) {
+  int overflow;
+  long long val {PyLong_AsLongLongAndOverflow(obj, &overflow)};
+  if(!overflow) [[likely]] {
+    if(val == -1 && PyErr_Occurred()) [[unlikely]]
+      throw_py();
+    buf.append_dec(val);
+    return;
+  }
+
+  // int's own repr, subclasses don't get to change how numbers are written
+  PyObject* repr {PyLong_Type.tp_repr(obj)};
+  if(!repr) [[unlikely]]
+    throw_py();
+  Py_ssize_t len;
+  const char* str {PyUnicode_AsUTF8AndSize(repr, &len)};
+  if(str)
+    buf.append(str, len);
+  Py_DECREF(repr);
+  if(!str) [[unlikely]]
+    throw_py();
+}
+
+void dump_float(double val, OutputBuffer& buf) {
+  if(!std::isfinite(val)) [[unlikely]] {
+    PyErr_SetString(PyExc_ValueError,
+        "Out of range float values are not JSON compliant");
+    throw_py();
+  }
+
+  char out[32];
+  auto res {std::to_chars(out, out + sizeof(out), val)};
+  std::string_view sv {out, static_cast<std::size_t>(res.ptr - out)};
+  buf.append(sv);
+
+  // Keep integral floats floats, 1.0 rather than 1
+  if(sv.find_first_of(".e") == sv.npos)
+    buf.append(".0");
+}
+
+struct RecursionGuard {
+  explicit RecursionGuard(const char* where) {
+    if(Py_EnterRecursiveCall(where)) [[unlikely]]
+      throw_py();
+  }
+
+  ~RecursionGuard() {
+    Py_LeaveRecursiveCall();
+  }
+};
+
+void dump(PyObject* obj, OutputBuffer& buf);
+
+void dump_key(PyObject* key, OutputBuffer& buf) {
+  if(PyUnicode_Check(key)) [[likely]] {
+    dump_unicode(key, buf);
+  } else if(key == Py_None || PyBool_Check(key) || PyLong_Check(key) ||
+      PyFloat_Check(key)) {
+    buf.append("\"");
+    dump(key, buf);
+    buf.append("\"");
+  } else {
+    PyErr_Format(PyExc_TypeError,
+        "keys must be str, int, float, bool or None, not %.100s",
+        Py_TYPE(key)->tp_name);
+    throw_py();
+  }
+}
+
+void dump_dict(PyObject* obj, OutputBuffer& buf) {
+  RecursionGuard guard {" while encoding a JSON object"};
+  buf.append("{");
+
+  PyObject* key;
+  PyObject* val;
+  bool first {true};
+  for(Py_ssize_t pos {0}; PyDict_Next(obj, &pos, &key, &val);) {
+    if(!first)
+      buf.append(",");
+    first = false;
+    dump_key(key, buf);
+    buf.append(":");
+    dump(val, buf);
+  }
+  buf.append("}");
+}
+
+// Lists and tuples, nothing written here can run Python code and resize them
+void dump_seq(PyObject* obj, OutputBuffer& buf) {
+  RecursionGuard guard {" while encoding a JSON object"};
+  buf.append("[");
+  for(Py_ssize_t i {0}, end {PySequence_Fast_GET_SIZE(obj)}; i < end; ++i) {
+    if(i)
+      buf.append(",");
+    dump(PySequence_Fast_GET_ITEM(obj, i), buf);
+  }
+  buf.append("]");
+}
+
+void dump(PyObject* obj, OutputBuffer& buf) {
+  if(obj == Py_None)
+    buf.append("null");
+  else if(obj == Py_True)
+    buf.append("true");
+  else if(obj == Py_False)
+    buf.append("false");
+  else if(PyUnicode_Check(obj))
+    dump_unicode(obj, buf);
+  else if(PyLong_Check(obj))
+    dump_long(obj, buf);
+  else if(PyDict_Check(obj))
+    dump_dict(obj, buf);
+  else if(PyList_Check(obj) || PyTuple_Check(obj))
+    dump_seq(obj, buf);
+  else if(PyFloat_Check(obj))
+    dump_float(PyFloat_AS_DOUBLE(obj), buf);
+  else {
+    PyErr_Format(PyExc_TypeError, "Object of type %.100s is not JSON "
+                                  "serializable",
+        Py_TYPE(obj)->tp_name);
+    throw_py();
+  }
+}
+
+// Index of the first '"', '\\' or control character, or len. Clears ascii if
+// a byte with the high bit set comes before it.
+std::size_t scan_string(const unsigned char* p, std::size_t len, bool& ascii) {
+  std::size_t i {0};
+
+#if defined(VELOCEM_SSE2)
+  const __m128i ctl {_mm_set1_epi8(0x1F)};
+  const __m128i quote {_mm_set1_epi8('"')};
+  const __m128i bslash {_mm_set1_epi8('\\')};
+  for(; i + 16 <= len; i += 16) {
+    __m128i v {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))};
+    __m128i stop {_mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v)};
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, quote));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, bslash));
+    unsigned high = _mm_movemask_epi8(v);
+    if(unsigned mask = _mm_movemask_epi8(stop)) {
+      std::size_t n {static_cast<std::size_t>(std::countr_zero(mask))};
+      if(high & ((1u << n) - 1))
+        ascii = false;
+      return i + n;
+    }
+    if(high)
+      ascii = false;
+  }
+#elif defined(VELOCEM_NEON)
+  for(; i + 16 <= len; i += 16) {
+    uint8x16_t v {vld1q_u8(p + i)};
+    uint8x16_t stop {vcleq_u8(v, vdupq_n_u8(0x1F))};
+    stop = vorrq_u8(stop, vceqq_u8(v, vdupq_n_u8('"')));
+    stop = vorrq_u8(stop, vceqq_u8(v, vdupq_n_u8('\\')));
+    uint8x16_t hi {vcgeq_u8(v, vdupq_n_u8(0x80))};
+    std::uint64_t mask {vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(stop), 4)), 0)};
+    std::uint64_t high {vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hi), 4)), 0)};
+    if(mask) {
+      int bit {std::countr_zero(mask) & ~3};
+      if(high & ((std::uint64_t {1} << bit) - 1))
+        ascii = false;
+      return i + (bit >> 2);
+    }
+    if(high)
+      ascii = false;
+  }
+#endif
+
+  for(; i < len; ++i) {
+    if(escape_table[p[i]])
+      return i;
+    if(p[i] & 0x80)
+      ascii = false;
+  }
+  return len;
+}
+
+void append_utf8(std::string& out, std::uint32_t cp) {
+  if(cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if(cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if(cp < 0x10000) {
+    // Lone surrogates included, they're decoded with surrogatepass
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+bool is_digit(unsigned char c) {
+  return c >= '0' && c <= '9';
+}
+
+class Parser {
+public:
+  Parser(const char* data, std::size_t len)
+      : begin_ {reinterpret_cast<const unsigned char*>(data)}, p_ {begin_},
+        end_ {begin_ + len} {}
+
+  Parser(Parser&) = delete;
+
+  ~Parser() {
+    for(PyObject* obj : stack_)
+      Py_DECREF(obj);
+    for(Key& key : keys_)
+      Py_XDECREF(key.obj);
+  }
+
+  PyObject* parse() {
+    if(end_ - p_ >= 3 && !std::memcmp(p_, "\xEF\xBB\xBF", 3))
+      p_ += 3;
+
+    PyObject* val {parse_value()};
+    skip_ws();
+    if(p_ != end_) [[unlikely]] {
+      Py_DECREF(val);
+      fail("Extra data");
+    }
+    return val;
+  }
+
+private:
+  // Object keys up to this length are shared within a document
+  static constexpr std::size_t key_cache_max {32};
+
+  struct Key {
+    const unsigned char* str;
+    std::size_t len;
+    PyObject* obj;
+  };
+
+  // Raises json.JSONDecodeError, positioned in characters as it would be by
+  // json.loads()
+  [[noreturn]] void fail(const char* msg) {
+    auto begin {reinterpret_cast<const char*>(begin_)};
+    PyObject* json {PyImport_ImportModule("json")};
+    PyObject* exc {json ? PyObject_GetAttrString(json, "JSONDecodeError")
+                        : nullptr};
+    Py_XDECREF(json);
+    PyObject* doc {
+        exc ? PyUnicode_DecodeUTF8(begin, end_ - begin_, "replace") : nullptr};
+    PyObject* prefix {
+        doc ? PyUnicode_DecodeUTF8(begin, p_ - begin_, "replace") : nullptr};
+    if(prefix) {
+      PyObject* err {PyObject_CallFunction(exc, "sOn", msg, doc,
+          PyUnicode_GET_LENGTH(prefix))};
+      if(err) {
+        PyErr_SetObject(exc, err);
+        Py_DECREF(err);
+      }
+    }
+    Py_XDECREF(prefix);
+    Py_XDECREF(doc);
+    Py_XDECREF(exc);
+    throw_py();
+  }
+
+  void skip_ws() {
+    while(p_ != end_ &&
+        (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+      ++p_;
+  }
+
+  // Steps past a comma, unless it's the last thing before close
+  void trailing_comma(unsigned char close, const char* msg) {
+    const unsigned char* comma {p_++};
+    skip_ws();
+    if(p_ != end_ && *p_ == close) [[unlikely]] {
+      p_ = comma;
+      fail(msg);
+    }
+  }
+
+  PyObject* check(PyObject* obj) {
+    if(!obj) [[unlikely]]
+      throw_py();
+    return obj;
+  }
+
+  PyObject* literal(std::string_view word, PyObject* val) {
+    if(static_cast<std::size_t>(end_ - p_) < word.size() ||
+        std::memcmp(p_, word.data(), word.size())) [[unlikely]]
+      fail("Expecting value");
+    p_ += word.size();
+    return Py_NewRef(val);
+  }
+
+  PyObject* constant(std::string_view word, double val) {
+    if(static_cast<std::size_t>(end_ - p_) < word.size() ||
+        std::memcmp(p_, word.data(), word.size())) [[unlikely]]
+      fail("Expecting value");
+    p_ += word.size();
+    return check(PyFloat_FromDouble(val));
+  }
+
+  PyObject* parse_value() {
+    skip_ws();
+    if(p_ == end_) [[unlikely]]
+      fail("Expecting value");
+
+    switch(*p_) {
+      case '{':
+        return parse_object();
+      case '[':
+        return parse_array();
+      case '"':
+        ++p_;
+        return parse_string(false);
+      case 't':
+        return literal("true", Py_True);
+      case 'f':
+        return literal("false", Py_False);
+      case 'n':
+        return literal("null", Py_None);
+      case 'N':
+        return constant("NaN", Py_NAN);
+      case 'I':
+        return constant("Infinity", Py_HUGE_VAL);
+      case '-':
+        if(end_ - p_ > 1 && p_[1] == 'I')
+          return constant("-Infinity", -Py_HUGE_VAL);
+        return parse_number();
+      default:
+        if(is_digit(*p_))
+          return parse_number();
+        fail("Expecting value");
+    }
+  }
+
+  PyObject* parse_array() {
+    RecursionGuard guard {" while decoding a JSON array"};
+    ++p_;
+
+    // Elements collect on the stack so the list is created at its final size
+    std::size_t base {stack_.size()};
+    skip_ws();
+    if(p_ != end_ && *p_ == ']') {
+      ++p_;
+      return check(PyList_New(0));
+    }
+
+    for(;;) {
+      stack_.push_back(parse_value());
+      skip_ws();
+      if(p_ != end_ && *p_ == ',') {
+        trailing_comma(']', "Illegal trailing comma before end of array");
+        continue;
+      }
+      if(p_ != end_ && *p_ == ']') {
+        ++p_;
+        break;
+      }
+      fail("Expecting ',' delimiter");
+    }
+
+    PyObject* list {check(PyList_New(stack_.size() - base))};
+    for(std::size_t i {base}; i < stack_.size(); ++i)
+      PyList_SET_ITEM(list, i - base, stack_[i]);
+    stack_.resize(base);
+    return list;
+  }
+
+  PyObject* parse_object() {
+    RecursionGuard guard {" while decoding a JSON object"};
+    ++p_;
+
+    PyObject* dict {check(PyDict_New())};
+    stack_.push_back(dict);
+
+    skip_ws();
+    if(p_ != end_ && *p_ == '}') {
+      ++p_;
+      stack_.pop_back();
+      return dict;
+    }
+
+    for(;;) {
+      skip_ws();
+      if(p_ == end_ || *p_ != '"') [[unlikely]]
+        fail("Expecting property name enclosed in double quotes");
+      ++p_;
+      stack_.push_back(parse_string(true));
+
+      skip_ws();
+      if(p_ == end_ || *p_ != ':') [[unlikely]]
+        fail("Expecting ':' delimiter");
+      ++p_;
+
+      PyObject* val {parse_value()};
+      PyObject* key {stack_.back()};
+      stack_.pop_back();
+      int err {PyDict_SetItem(dict, key, val)};
+      Py_DECREF(key);
+      Py_DECREF(val);
+      if(err) [[unlikely]]
+        throw_py();
+
+      skip_ws();
+      if(p_ != end_ && *p_ == ',') {
+        trailing_comma('}', "Illegal trailing comma before end of object");
+        continue;
+      }
+      if(p_ != end_ && *p_ == '}') {
+        ++p_;
+        break;
+      }
+      fail("Expecting ',' delimiter");
+    }
+
+    stack_.pop_back();
+    return dict;
+  }
+
+  PyObject* make_str(const void* str, std::size_t len, bool ascii) {
+    if(!ascii)
+      return check(PyUnicode_DecodeUTF8(static_cast<const char*>(str), len,
+          "surrogatepass"));
+
+    PyObject* obj {check(PyUnicode_New(len, 127))};
+    std::memcpy(PyUnicode_1BYTE_DATA(obj), str, len);
+    return obj;
+  }
+
+  PyObject* make_key(const unsigned char* str, std::size_t len, bool ascii) {
+    if(len > key_cache_max)
+      return make_str(str, len, ascii);
+
+    Key& slot {keys_[hash_bytes(str, len) % keys_.size()]};
+    if(slot.obj && slot.len == len && !std::memcmp(slot.str, str, len))
+      return Py_NewRef(slot.obj);
+
+    PyObject* obj {make_str(str, len, ascii)};
+    Py_XSETREF(slot.obj, Py_NewRef(obj));
+    slot.str = str;
+    slot.len = len;
+    return obj;
+  }
+
+  std::uint32_t parse_hex4() {
+    if(end_ - p_ < 4) [[unlikely]] {
+      --p_;
+      fail("Invalid \\uXXXX escape");
+    }
+
+    std::uint32_t val {0};
+    for(int i {0}; i < 4; ++i) {
+      unsigned char c {p_[i]};
+      val <<= 4;
+      if(is_digit(c))
+        val |= c - '0';
+      else if((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+        val |= (c | 0x20) - 'a' + 10;
+      else {
+        --p_;
+        fail("Invalid \\uXXXX escape");
+      }
+    }
+    p_ += 4;
+    return val;
+  }
+
+  void parse_escape(bool& ascii) {
+    ++p_;
+    if(p_ == end_) [[unlikely]]
+      fail("Unterminated string");
+
+    char out;
+    switch(*p_++) {
+      case '"':
+        out = '"';
+        break;
+      case '\\':
+        out = '\\';
+        break;
+      case '/':
+        out = '/';
+        break;
+      case 'b':
+        out = '\b';
+        break;
+      case 'f':
+        out = '\f';
+        break;
+      case 'n':
+        out = '\n';
+        break;
+      case 'r':
+        out = '\r';
+        break;
+      case 't':
+        out = '\t';
+        break;
+      case 'u': {
+        std::uint32_t cp {parse_hex4()};
+        if(cp >= 0xD800 && cp < 0xDC00 && end_ - p_ >= 6 && p_[0] == '\\' &&
+            p_[1] == 'u') {
+          p_ += 2;
+          std::uint32_t lo {parse_hex4()};
+          if(lo >= 0xDC00 && lo < 0xE000)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+          else
+            p_ -= 6;
+        }
+        if(cp >= 0x80)
+          ascii = false;
+        append_utf8(scratch_, cp);
+        return;
+      }
+      default:
+        p_ -= 2;
+        fail("Invalid \\escape");
+    }
+    scratch_.push_back(out);
+  }
+
+  PyObject* parse_string(bool key) {
+    const unsigned char* start {p_};
+    bool ascii {true};
+    p_ += scan_string(p_, end_ - p_, ascii);
+
+    // Strings without escapes are created straight from the input
+    if(p_ != end_ && *p_ == '"') [[likely]] {
+      ++p_;
+      std::size_t len {static_cast<std::size_t>(p_ - 1 - start)};
+      return key ? make_key(start, len, ascii) : make_str(start, len, ascii);
+    }
+
+    scratch_.assign(start, p_);
+    for(;;) {
+      if(p_ == end_) [[unlikely]] {
+        p_ = start - 1;
+        fail("Unterminated string starting at");
+      }
+      if(*p_ == '"')
+        break;
+      if(*p_ != '\\') [[unlikely]]
+        fail("Invalid control character at");
+
+      parse_escape(ascii);
+      std::size_t n {scan_string(p_, end_ - p_, ascii)};
+      scratch_.append(p_, p_ + n);
+      p_ += n;
+    }
+    ++p_;
+    return make_str(scratch_.data(), scratch_.size(), ascii);
+  }
+
+  PyObject* parse_number() {
+    const unsigned char* start {p_};
+    if(*p_ == '-')
+      ++p_;
+    if(p_ == end_ || !is_digit(*p_)) [[unlikely]] {
+      p_ = start;
+      fail("Expecting value");
+    }
+
+    if(*p_ == '0')
+      ++p_;
+    else
+      while(p_ != end_ && is_digit(*p_))
+        ++p_;
+    const unsigned char* int_end {p_};
+
+    // A fraction or exponent without digits isn't part of the number, it's
+    // left behind to fail as extra data
+    bool is_float {false};
+    if(end_ - p_ > 1 && *p_ == '.' && is_digit(p_[1])) {
+      p_ += 2;
+      while(p_ != end_ && is_digit(*p_))
+        ++p_;
+      is_float = true;
+    }
+    if(p_ != end_ && (*p_ | 0x20) == 'e') {
+      const unsigned char* exp {p_ + 1};
+      if(exp != end_ && (*exp == '+' || *exp == '-'))
+        ++exp;
+      if(exp != end_ && is_digit(*exp)) {
+        p_ = exp;
+        while(p_ != end_ && is_digit(*p_))
+          ++p_;
+        is_float = true;
+      }
+    }
+
+    auto first {reinterpret_cast<const char*>(start)};
+    auto last {reinterpret_cast<const char*>(p_)};
+    if(!is_float) {
+      // Anything up to 18 digits fits
+      if(int_end - start <= 18) {
+        long long val {0};
+        std::from_chars(first, last, val);
+        return check(PyLong_FromLongLong(val));
+      }
+      scratch_.assign(first, last);
+      return check(PyLong_FromString(scratch_.c_str(), nullptr, 10));
+    }
+
+    double val;
+    auto res {std::from_chars(first, last, val)};
+    if(res.ec != std::errc {}) {
+      // Overflow to inf and underflow to zero, as float() does
+      scratch_.assign(first, last);
+      val = PyOS_string_to_double(scratch_.c_str(), nullptr, nullptr);
+      if(val == -1.0 && PyErr_Occurred()) [[unlikely]]
+        throw_py();
+    }
+    return check(PyFloat_FromDouble(val));
+  }
+
+  const unsigned char* begin_;
+  const unsigned char* p_;
+  const unsigned char* end_;
+
+  // Objects under construction, released if parsing fails
+  std::vector<PyObject*> stack_;
+  std::string scratch_;
+  std::array<Key, 64> keys_ {};
+};
+
+} // namespace
+
+void json_dump(PyObject* obj, OutputBuffer& buf) {
+  dump(obj, buf);
+}
+
+PyObject* json_load(const char* data, std::size_t len) {
+  try {
+    Parser parser {data, len};
+    return parser.parse();
+  } catch(std::runtime_error&) {
+    return nullptr;
+  }
+}
+
+} // namespace velocem
@@ -0,0 +1,33 @@
+#ifndef VELOCEM_JSON_HPP
+#define VELOCEM_JSON_HPP
+
+#include <cstddef>
+
+#include <Python.h>
+
+#include "OutputBuffer.hpp"
+
+namespace velocem {
+
+// Serializes dicts, lists, tuples, str, int, float, bool and None as compact
+// JSON onto the end of buf. Strings are written as UTF-8 with only the
+// escapes JSON requires, floats in their shortest round-trip form. Dict keys
+// which are int, float, bool or None are converted to strings as json.dumps()
+// does.
+//
+// Throws std::runtime_error with a Python exception set for unsupported
+// types, non-finite floats and excessive nesting. buf is left partially
+// written.
+void json_dump(PyObject* obj, OutputBuffer& buf);
+
+// Parses a UTF-8 JSON document into Python objects, as json.loads() would.
+// Strings are created directly from the input when they contain no escapes,
+// and repeated object keys within the document share a single str.
+//
+// Returns a new reference, or nullptr with json.JSONDecodeError (or
+// UnicodeDecodeError for invalid UTF-8) set.
+PyObject* json_load(const char* data, std::size_t len);
+
+} // namespace velocem
+
+#endif // VELOCEM_JSON_HPP
@@ -0,0 +1,198 @@
+#ifndef VELOCEM_OUTPUTBUFFER_HPP
+#define VELOCEM_OUTPUTBUFFER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include <asio/buffer.hpp>
+
+namespace velocem {
+
+// Growable byte buffer for assembling responses. Unlike std::vector<char> it
+// never zero-fills, formats integers straight into its storage, and can keep
+// headroom in front of the data so a prefix (a status or chunk-size line) can
+// be written after the bytes that follow it.
+//
+// The *_unchecked members skip the capacity check, callers must reserve()
+// first.
+class OutputBuffer {
+public:
+  // Longest possible output of append_dec()/append_hex() for 64-bit values
+  static constexpr std::size_t max_int_chars {20};
+
+  explicit OutputBuffer(std::size_t headroom = 0) {
+    relocate(headroom, headroom);
+  }
+
+  OutputBuffer(OutputBuffer&) = delete;
+  OutputBuffer(OutputBuffer&&) = default;
+  OutputBuffer& operator=(OutputBuffer&&) = default;
+
+  char* data() {
+    return buf_.get() + begin_;
+  }
+
+  const char* data() const {
+    return buf_.get() + begin_;
+  }
+
+  std::size_t size() const {
+    return end_ - begin_;
+  }
+
+  bool empty() const {
+    return end_ == begin_;
+  }
+
+  std::size_t capacity() const {
+    return cap_;
+  }
+
+  std::size_t headroom() const {
+    return headroom_;
+  }
+
+  asio::const_buffer buffer() const {
+    return asio::buffer(data(), size());
+  }
+
+  void clear() {
+    begin_ = end_ = headroom_;
+  }
+
+  // Make room for at least n more bytes past the end
+  void reserve(std::size_t n) {
+    if(cap_ - end_ < n) [[unlikely]]
+      grow(n);
+  }
+
+  void append_unchecked(const char* str, std::size_t len) {
+    assert(cap_ - end_ >= len);
+    std::memcpy(buf_.get() + end_, str, len);
+    end_ += len;
+  }
+
+  void append(const char* str, std::size_t len) {
+    reserve(len);
+    append_unchecked(str, len);
+  }
+
+  void append(std::string_view str) {
+    append(str.data(), str.size());
+  }
+
+  template <std::size_t N> void append(const char (&str)[N]) {
+    append(str, N - 1);
+  }
+
+  void append_dec(std::integral auto val) {
+    reserve(max_int_chars);
+    append_int(val, 10);
+  }
+
+  void append_hex(std::integral auto val) {
+    reserve(max_int_chars);
+    append_int(val, 16);
+  }
+
+  // Writes str immediately in front of the current data, growing the
+  // headroom if the reserved amount has been used up
+  void prepend(const char* str, std::size_t len) {
+    if(begin_ < len) [[unlikely]]
+      grow_front(len);
+    begin_ -= len;
+    std::memcpy(buf_.get() + begin_, str, len);
+  }
+
+  void prepend(std::string_view str) {
+    prepend(str.data(), str.size());
+  }
+
+  void prepend_hex(std::integral auto val) {
+    char tmp[max_int_chars];
+    auto res {std::to_chars(tmp, tmp + sizeof(tmp), val, 16)};
+    prepend(tmp, res.ptr - tmp);
+  }
+
+  // Writable space past the end, for producers that write in place. tail() is
+  // invalidated by anything that grows the buffer.
+  char* tail() {
+    return buf_.get() + end_;
+  }
+
+  std::size_t spare() const {
+    return cap_ - end_;
+  }
+
+  // Adopt n bytes written at tail()
+  void commit(std::size_t n) {
+    assert(cap_ - end_ >= n);
+    end_ += n;
+  }
+
+  // Inserts str at offset pos, moving everything after it back
+  void insert(std::size_t pos, const char* str, std::size_t len) {
+    reserve(len);
+    char* at {data() + pos};
+    std::memmove(at + len, at, size() - pos);
+    std::memcpy(at, str, len);
+    end_ += len;
+  }
+
+  // Drop the first n bytes, the space they held becomes headroom
+  void consume(std::size_t n) {
+    begin_ += std::min(n, size());
+  }
+
+  // Drop everything past the first n bytes
+  void truncate(std::size_t n) {
+    end_ = std::min(end_, begin_ + n);
+  }
+
+private:
+  void append_int(std::integral auto val, int base) {
+    char* p {buf_.get() + end_};
+    auto res {std::to_chars(p, p + max_int_chars, val, base)};
+    end_ += res.ptr - p;
+  }
+
+  void grow(std::size_t n) {
+    std::size_t cap {std::max(cap_ * 2, headroom_ + size() + n)};
+    relocate(cap, headroom_);
+  }
+
+  void grow_front(std::size_t n) {
+    std::size_t front {std::max(headroom_ * 2, n)};
+    relocate(cap_ - begin_ + front, front);
+  }
+
+  // Moves the data to sit at offset front in a new buffer of size cap
+  void relocate(std::size_t cap, std::size_t front) {
+    auto next {std::make_unique_for_overwrite<char[]>(cap)};
+    std::size_t sz {size()};
+    if(sz)
+      std::memcpy(next.get() + front, data(), sz);
+    buf_ = std::move(next);
+    cap_ = cap;
+    begin_ = front;
+    end_ = front + sz;
+    headroom_ = std::max(headroom_, front);
+  }
+
+  std::unique_ptr<char[]> buf_;
+  std::size_t cap_ {0};
+  std::size_t headroom_ {0};
+  std::size_t begin_ {0};
+  std::size_t end_ {0};
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_OUTPUTBUFFER_HPP
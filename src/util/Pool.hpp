@@ -0,0 +1,171 @@
+#ifndef VELOCEM_POOL_HPP
+#define VELOCEM_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <Python.h>
+
+#include "plat/plat.hpp"
+
+namespace velocem {
+
+// Object pool split into classes by how much buffer capacity a pooled object
+// is holding onto. Objects larger than the biggest class are destroyed rather
+// than pooled, and trim() periodically frees idle objects which went unused
+// for an entire trim interval.
+//
+// T must be default constructible and provide:
+//   void reset();                  // Return to a freshly popped state
+//   std::size_t footprint() const; // Bytes of buffer capacity held
+template <typename T> struct ObjectPool {
+  static constexpr std::array<std::size_t, 3> class_limits {
+      std::size_t {16} << 10,
+      std::size_t {256} << 10,
+      std::size_t {4} << 20,
+  };
+
+  static constexpr std::size_t slab_size {std::size_t {2} << 20};
+
+  ObjectPool(const char* name) : name_ {name} {}
+
+  ObjectPool(ObjectPool&) = delete;
+  ObjectPool(ObjectPool&&) = delete;
+
+  T* pop() {
+    if(++outstanding_ > high_water_)
+      high_water_ = outstanding_;
+
+    // Prefer the smallest objects, leaving big ones idle so they get trimmed
+    for(auto& cls : classes_) {
+      if(!cls.idle.empty()) {
+        T* ptr {cls.idle.back()};
+        cls.idle.pop_back();
+        cls.low_water = std::min(cls.low_water, cls.idle.size());
+        ++hits_;
+        return ptr;
+      }
+    }
+
+    ++misses_;
+    if(slab_cur_ + sizeof(T) <= slab_end_) {
+      T* ptr {new(slab_cur_) T};
+      slab_cur_ += sizeof(T);
+      return ptr;
+    }
+    return new T;
+  }
+
+  void push(T* ptr) {
+    --outstanding_;
+    ptr->reset();
+
+    std::size_t fp {ptr->footprint()};
+    for(std::size_t i {0}; i < class_limits.size(); ++i) {
+      if(fp <= class_limits[i]) {
+        classes_[i].idle.push_back(ptr);
+        return;
+      }
+    }
+
+    ++trims_;
+    if(in_slab(ptr)) {
+      // Slab memory can't be freed, rebuild in place to drop the buffers
+      ptr->~T();
+      classes_[0].idle.push_back(new(ptr) T);
+    } else {
+      delete ptr;
+    }
+  }
+
+  // Free whatever sat idle through the entire interval since the last trim.
+  // Slab objects holding more than the smallest class are rebuilt in place, as
+  // in push(), which frees their buffers but keeps the object pooled.
+  void trim() {
+    for(std::size_t i {0}; i < classes_.size(); ++i) {
+      SizeClass& cls {classes_[i]};
+      std::size_t surplus {cls.low_water};
+      for(auto it {cls.idle.begin()}; surplus && it != cls.idle.end();) {
+        T* ptr {*it};
+        if(in_slab(ptr)) {
+          if(!i) {
+            ++it;
+            continue;
+          }
+          ptr->~T();
+          classes_[0].idle.push_back(new(ptr) T);
+        } else {
+          delete ptr;
+        }
+        it = cls.idle.erase(it);
+        --surplus;
+        ++trims_;
+      }
+      if(cls.idle.empty())
+        cls.idle.shrink_to_fit();
+      cls.low_water = cls.idle.size();
+    }
+    high_water_ = outstanding_;
+  }
+
+  // Carve objects for the hot class out of a dedicated slab, optionally
+  // backed by huge pages
+  void use_slab(bool huge) {
+    if(slab_begin_)
+      return;
+    slab_begin_ = static_cast<char*>(alloc_slab(slab_size, huge));
+    if(slab_begin_) {
+      slab_cur_ = slab_begin_;
+      slab_end_ = slab_begin_ + slab_size / sizeof(T) * sizeof(T);
+    }
+  }
+
+  PyObject* stats() const {
+    std::size_t idle {0};
+    for(const auto& cls : classes_)
+      idle += cls.idle.size();
+
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:n,s:(nnn)}", "hits",
+        (Py_ssize_t) hits_, "misses", (Py_ssize_t) misses_, "trims",
+        (Py_ssize_t) trims_, "outstanding", (Py_ssize_t) outstanding_,
+        "high_water", (Py_ssize_t) high_water_, "idle", (Py_ssize_t) idle,
+        "classes", (Py_ssize_t) classes_[0].idle.size(),
+        (Py_ssize_t) classes_[1].idle.size(),
+        (Py_ssize_t) classes_[2].idle.size());
+  }
+
+  const char* name() const {
+    return name_;
+  }
+
+private:
+  bool in_slab(T* ptr) const {
+    auto p {reinterpret_cast<char*>(ptr)};
+    return p >= slab_begin_ && p < slab_end_;
+  }
+
+  struct SizeClass {
+    std::vector<T*> idle;
+    std::size_t low_water {0};
+  };
+
+  const char* name_;
+  std::array<SizeClass, class_limits.size()> classes_;
+
+  std::size_t outstanding_ {0};
+  std::size_t high_water_ {0};
+  std::size_t hits_ {0};
+  std::size_t misses_ {0};
+  std::size_t trims_ {0};
+
+  char* slab_begin_ {nullptr};
+  char* slab_cur_ {nullptr};
+  char* slab_end_ {nullptr};
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_POOL_HPP
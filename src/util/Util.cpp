@@ -1,9 +1,8 @@
 #include "Util.hpp"
 
+#include <algorithm>
 #include <cstddef>
 #include <stdexcept>
-#include <string>
-#include <vector>
 
 #include <Python.h>
 
@@ -18,95 +17,86 @@ void unpack_unicode(PyObject* str, const char** base, Py_ssize_t* len,
     throw std::runtime_error {"Python str object error"};
   }
 
+  // WSGI strings are bytes decoded as latin-1, anything wider isn't
+  // representable on the wire
+  if(PyUnicode_KIND(str) != PyUnicode_1BYTE_KIND) [[unlikely]] {
+    PyErr_SetString(PyExc_ValueError,
+        "Response strings must only contain latin-1 characters");
+    throw std::runtime_error {"Python str object error"};
+  }
+
   *base = (char*) PyUnicode_DATA(str);
   *len = PyUnicode_GET_LENGTH(str);
 }
 
-void unpack_pybytes(PyObject* bytes, const char** base, Py_ssize_t* len,
-    const char* err) {
-  if(!PyBytes_Check(bytes)) [[unlikely]] {
+void PyBufferView::acquire(PyObject* obj, const char* err) {
+  release();
+  if(!PyObject_CheckBuffer(obj)) [[unlikely]] {
     PyErr_SetString(PyExc_TypeError, err);
-    throw std::runtime_error {"Python bytes object error"};
+    throw std::runtime_error {"Python buffer error"};
   }
-
-  *base = PyBytes_AS_STRING(bytes);
-  *len = PyBytes_GET_SIZE(bytes);
-}
-
-void insert_chars(std::vector<char>& vec, const char* str, std::size_t len) {
-  vec.insert(vec.end(), str, str + len);
-}
-
-void insert_str(std::vector<char>& vec, const std::string& str) {
-  vec.insert(vec.end(), str.begin(), str.end());
-}
-
-void insert_pybytes_unchecked(std::vector<char>& vec, PyObject* bytes) {
-  char* base {PyBytes_AS_STRING(bytes)};
-  Py_ssize_t len {PyBytes_GET_SIZE(bytes)};
-  vec.insert(vec.end(), base, base + len);
+  if(PyObject_GetBuffer(obj, &view_, PyBUF_SIMPLE)) [[unlikely]]
+    throw std::runtime_error {"Python buffer error"};
+  size_ = view_.len;
+  held_ = true;
 }
 
-Py_ssize_t insert_pybytes_unchecked(std::vector<char>& vec, PyObject* bytes,
-    Py_ssize_t max) {
-  char* base {PyBytes_AS_STRING(bytes)};
-  Py_ssize_t len {PyBytes_GET_SIZE(bytes)};
-  if(len > max)
-    len = max;
-  vec.insert(vec.end(), base, base + len);
-  return len;
+void PyBufferView::release() {
+  if(held_) {
+    PyBuffer_Release(&view_);
+    held_ = false;
+  }
+  off_ = 0;
+  size_ = 0;
 }
 
-
-void insert_pybytes(std::vector<char>& vec, PyObject* bytes, const char* err) {
-  if(!PyBytes_Check(bytes)) [[unlikely]] {
-    PyErr_SetString(PyExc_TypeError, err);
-    throw std::runtime_error {"Python bytes object error"};
+void insert_pybuffer(OutputBuffer& buf, PyObject* obj, const char* err) {
+  if(PyBytes_CheckExact(obj)) [[likely]] {
+    buf.append(PyBytes_AS_STRING(obj), PyBytes_GET_SIZE(obj));
+    return;
   }
-  insert_pybytes_unchecked(vec, bytes);
+  PyBufferView view;
+  view.acquire(obj, err);
+  buf.append(view.data(), view.size());
 }
 
-Py_ssize_t insert_pybytes(std::vector<char>& vec, PyObject* bytes,
-    Py_ssize_t max, const char* err) {
-  if(!PyBytes_Check(bytes)) [[unlikely]] {
-    PyErr_SetString(PyExc_TypeError, err);
-    throw std::runtime_error {"Python bytes object error"};
+Py_ssize_t insert_pybuffer(OutputBuffer& buf, PyObject* obj, Py_ssize_t max,
+    const char* err) {
+  if(PyBytes_CheckExact(obj)) [[likely]] {
+    Py_ssize_t len {std::min(PyBytes_GET_SIZE(obj), max)};
+    buf.append(PyBytes_AS_STRING(obj), len);
+    return len;
   }
-  return insert_pybytes_unchecked(vec, bytes, max);
+  PyBufferView view;
+  view.acquire(obj, err);
+  Py_ssize_t len {std::min(static_cast<Py_ssize_t>(view.size()), max)};
+  buf.append(view.data(), len);
+  return len;
 }
 
-void insert_pystr(std::vector<char>& vec, PyObject* str, const char* err) {
-  const char* base;
-  Py_ssize_t len;
-  unpack_unicode(str, &base, &len, err);
-  vec.insert(vec.end(), base, base + len);
+std::size_t get_buffer_size(PyObject* obj, const char* err) {
+  if(PyBytes_CheckExact(obj)) [[likely]]
+    return PyBytes_GET_SIZE(obj);
+  PyBufferView view;
+  view.acquire(obj, err);
+  return view.size();
 }
 
 std::size_t get_body_list_size(PyObject* list) {
   std::size_t sz {0};
   Py_ssize_t listlen {PyList_GET_SIZE(list)};
-  for(Py_ssize_t i {0}; i < listlen; ++i) {
-    PyObject* obj {PyList_GET_ITEM(list, i)};
-    if(!PyBytes_Check(obj)) [[unlikely]] {
-      PyErr_SetString(PyExc_TypeError, "Response must be Bytes object");
-      throw std::runtime_error {"Python bytes object error"};
-    }
-    sz += PyBytes_GET_SIZE(obj);
-  }
+  for(Py_ssize_t i {0}; i < listlen; ++i)
+    sz += get_buffer_size(PyList_GET_ITEM(list, i),
+        "Response must be bytes-like objects");
   return sz;
 }
 
 std::size_t get_body_tuple_size(PyObject* tuple) {
   std::size_t sz {0};
   Py_ssize_t tuplelen {PyTuple_GET_SIZE(tuple)};
-  for(Py_ssize_t i {0}; i < tuplelen; ++i) {
-    PyObject* obj {PyTuple_GET_ITEM(tuple, i)};
-    if(!PyBytes_Check(obj)) [[unlikely]] {
-      PyErr_SetString(PyExc_TypeError, "Response must be Bytes object");
-      throw std::runtime_error {"Python bytes object error"};
-    }
-    sz += PyBytes_GET_SIZE(obj);
-  }
+  for(Py_ssize_t i {0}; i < tuplelen; ++i)
+    sz += get_buffer_size(PyTuple_GET_ITEM(tuple, i),
+        "Response must be bytes-like objects");
   return sz;
 }
 
@@ -2,46 +2,87 @@
 #define VELOCEM_UTIL_HPP
 
 #include <cstddef>
-#include <string>
-#include <vector>
 
 #include <asio/buffer.hpp>
 
 #include <Python.h>
 
-namespace velocem {
+#include "OutputBuffer.hpp"
 
-template <std::size_t N>
-void insert_literal(std::vector<char>& vec, const char (&str)[N]) {
-  vec.insert(vec.end(), str, str + N - 1);
-}
+namespace velocem {
 
 template <std::size_t N> auto buffer_literal(const char (&str)[N]) {
   return asio::buffer(str, N - 1);
 }
 
+// Response bodies at least this large are sent from the app's buffer without
+// copying, smaller ones are copied behind the headers
+constexpr std::size_t body_view_min {std::size_t {16} << 10};
+
+// Also terminates the header block, the body follows immediately
+inline void insert_conlen(OutputBuffer& buf, std::size_t len) {
+  buf.reserve(sizeof("Content-Length: \r\n\r\n") + OutputBuffer::max_int_chars);
+  buf.append("Content-Length: ");
+  buf.append_dec(len);
+  buf.append("\r\n\r\n");
+}
+
 void unpack_unicode(PyObject* str, const char** base, Py_ssize_t* len,
     const char* err);
 
-void unpack_pybytes(PyObject* bytes, const char** base, Py_ssize_t* len,
-    const char* err);
+// Read-only view of any bytes-like object, holding the exporter alive until
+// released
+struct PyBufferView {
+  PyBufferView() = default;
+  PyBufferView(PyBufferView&) = delete;
+
+  ~PyBufferView() {
+    release();
+  }
+
+  void acquire(PyObject* obj, const char* err);
+  void release();
 
-void insert_chars(std::vector<char>& vec, const char* str, std::size_t len);
+  const char* data() const {
+    return static_cast<const char*>(view_.buf) + off_;
+  }
 
-void insert_str(std::vector<char>& vec, const std::string& str);
+  std::size_t size() const {
+    return size_;
+  }
 
-void insert_pybytes_unchecked(std::vector<char>& vec, PyObject* bytes);
+  bool empty() const {
+    return !size_;
+  }
 
-Py_ssize_t insert_pybytes_unchecked(std::vector<char>& vec, PyObject* bytes,
-    Py_ssize_t max);
+  void truncate(std::size_t n) {
+    if(n < size_)
+      size_ = n;
+  }
 
+  void slice(std::size_t off, std::size_t len) {
+    off_ += off;
+    size_ = len;
+  }
 
-void insert_pybytes(std::vector<char>& vec, PyObject* bytes, const char* err);
+  asio::const_buffer buffer() const {
+    return asio::buffer(data(), size_);
+  }
 
-Py_ssize_t insert_pybytes(std::vector<char>& vec, PyObject* bytes,
-    Py_ssize_t max, const char* err);
+private:
+  Py_buffer view_ {};
+  std::size_t off_ {0};
+  std::size_t size_ {0};
+  bool held_ {false};
+};
+
+void insert_pybuffer(OutputBuffer& buf, PyObject* obj, const char* err);
+
+// Copies at most max bytes, returns the number copied
+Py_ssize_t insert_pybuffer(OutputBuffer& buf, PyObject* obj, Py_ssize_t max,
+    const char* err);
 
-void insert_pystr(std::vector<char>& vec, PyObject* str, const char* err);
+std::size_t get_buffer_size(PyObject* obj, const char* err);
 
 std::size_t get_body_list_size(PyObject* list);
 
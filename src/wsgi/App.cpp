@@ -1,22 +1,21 @@
 #include "App.hpp"
 
+#include <algorithm>
 #include <array>
 #include <charconv>
+#include <cstdint>
 #include <cstdlib>
-#include <format>
+#include <cstring>
 #include <optional>
-#include <queue>
-#include <ranges>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <system_error>
 #include <tuple>
-#include <vector>
+#include <utility>
 
 #include <Python.h>
 
-#define Py_BUILD_CORE
-#include <internal/pycore_modsupport.h>
-
 #ifdef _MSC_VER
 #include <string.h>
 #define strncasecmp _strnicmp
@@ -24,10 +23,20 @@
 #include <strings.h>
 #endif
 
+#define Py_BUILD_CORE
+#include <internal/pycore_modsupport.h>
+
+#include "router/Router.hpp"
 #include "util/Constants.hpp"
+#include "util/Gzip.hpp"
+#include "util/Hash.hpp"
+#include "util/HeaderCheck.hpp"
 #include "util/Util.hpp"
 
+#include "Channel.hpp"
+#include "FileWrapper.hpp"
 #include "Input.hpp"
+#include "Range.hpp"
 #include "Request.hpp"
 
 namespace velocem {
@@ -40,27 +49,39 @@ enum InsertFieldResult : int {
   CONLEN,
 };
 
-InsertFieldResult insert_field(std::vector<char>& buf, PyObject* str) {
+InsertFieldResult insert_field(OutputBuffer& buf, PyObject* str) {
   const char* base;
   Py_ssize_t len;
   unpack_unicode(str, &base, &len, "Header fields must be str objects");
 
-  if(len == 14 && !strncasecmp("Content-Length", base, 14)) [[unlikely]] {
-    buf.insert(buf.end(), base, base + len);
-    return CONLEN;
+  switch(classify_header_name(base, len)) {
+    case HeaderName::Other:
+      buf.append(base, len);
+      return INSERTED;
+    case HeaderName::ContentLength:
+      return CONLEN;
+    case HeaderName::Invalid:
+      PyErr_SetString(PyExc_ValueError, "Invalid header field name");
+      throw std::runtime_error {"Python header error"};
+    default:
+      return NO_INSERT;
   }
+}
 
-  if((len == 4 && !strncasecmp("Date", base, 4)) ||
-      (len == 6 && !strncasecmp("Server", base, 6)) ||
-      (len == 10 && !strncasecmp("Connection", base, 10))) [[unlikely]] {
-    return NO_INSERT;
+Py_ssize_t parse_conlen(std::string_view value) {
+  Py_ssize_t conlen;
+  auto end {value.data() + value.size()};
+  auto fc {std::from_chars(value.data(), end, conlen)};
+  if(fc.ec != std::errc {} || fc.ptr != end || conlen < 0) {
+    PyErr_SetString(PyExc_ValueError, "Invalid Content-Length header");
+    throw std::runtime_error {"Python header error"};
   }
-
-  buf.insert(buf.end(), base, base + len);
-  return INSERTED;
+  return conlen;
 }
 
-std::optional<Py_ssize_t> insert_header(std::vector<char>& buf,
+// Content-Length is returned rather than inserted, it always goes last so the
+// rest of the block can be cached independently of it
+std::optional<std::string_view> insert_header(OutputBuffer& buf,
     PyObject* tuple) {
   if(!PyTuple_Check(tuple)) [[unlikely]] {
     PyErr_SetString(PyExc_TypeError, "Headers must be size two tuples");
@@ -78,104 +99,143 @@ std::optional<Py_ssize_t> insert_header(std::vector<char>& buf,
   if(result == NO_INSERT) [[unlikely]]
     return {};
 
-  insert_literal(buf, ": ");
-
   PyObject* value {PyTuple_GET_ITEM(tuple, 1)};
 
   if(result == CONLEN) [[unlikely]] {
     const char* base;
     Py_ssize_t len;
     unpack_unicode(value, &base, &len, "Header value must be str objects");
-
-    Py_ssize_t conlen;
-    auto fc {std::from_chars(base, base + len, conlen)};
-    if(fc.ec != std::errc {}) {
-      PyErr_SetString(PyExc_ValueError, "Invalid Content-Length header");
-      throw std::runtime_error {"Python header error"};
-    }
-    insert_chars(buf, base, len);
-    insert_literal(buf, "\r\n");
-    return conlen;
+    return std::string_view {base, static_cast<std::size_t>(len)};
   }
 
-  insert_pystr(buf, value, "Header values must be str objects");
-  insert_literal(buf, "\r\n");
-  return {};
-}
+  const char* base;
+  Py_ssize_t len;
+  unpack_unicode(value, &base, &len, "Header values must be str objects");
 
-void insert_body_pybytes(std::vector<char>& buf, std::vector<char>& wb,
-    PyObject* iter) {
-  auto sz {PyBytes_GET_SIZE(iter)};
-  insert_str(buf, std::format("Content-Length: {}\r\n\r\n", sz + wb.size()));
-  buf.insert(buf.end(), wb.begin(), wb.end());
-  insert_chars(buf, PyBytes_AS_STRING(iter), sz);
+  // Nothing is committed until the value has been checked
+  buf.reserve(len + 4);
+  char* out {buf.tail()};
+  if(!copy_field_value(out + 2, base, len)) [[unlikely]] {
+    PyErr_SetString(PyExc_ValueError,
+        "Header values must not contain control characters");
+    throw std::runtime_error {"Python header error"};
+  }
+  std::memcpy(out, ": ", 2);
+  std::memcpy(out + 2 + len, "\r\n", 2);
+  buf.commit(len + 4);
+  return {};
 }
 
-void insert_body_pybytes(std::vector<char>& buf, PyObject* iter,
-    Py_ssize_t sz) {
-  if(PyBytes_GET_SIZE(iter) < sz) {
+void insert_status(OutputBuffer& buf, PyObject* status) {
+  const char* base;
+  Py_ssize_t len;
+  unpack_unicode(status, &base, &len, "Status must be str object");
+  if(!valid_field_value(base, len)) [[unlikely]] {
     PyErr_SetString(PyExc_ValueError,
-        "Response is shorter than provided Content-Length header");
+        "Status must not contain control characters");
     throw std::runtime_error {"Python header error"};
   }
-  insert_chars(buf, PyBytes_AS_STRING(iter), sz);
+  auto line {common_status_line({base, static_cast<std::size_t>(len)})};
+  if(!line.empty()) {
+    buf.append(line.data(), line.size());
+  } else {
+    buf.append("HTTP/1.1 ");
+    buf.append(base, len);
+    buf.append("\r\n");
+  }
 }
 
-void insert_body_pylist(std::vector<char>& buf, PyObject* iter, Py_ssize_t sz) {
-  for(Py_ssize_t i {0}, end {PyList_GET_SIZE(iter)}; i < end && sz; ++i)
-    sz -= insert_pybytes_unchecked(buf, PyList_GET_ITEM(iter, i), sz);
+// 1xx, 204 and 304 responses never carry a body or a Content-Length
+bool bodiless_status(std::string_view status_line) {
+  std::string_view code {status_line.substr(9, 3)};
+  return code[0] == '1' || code == "204" || code == "304";
+}
 
-  if(sz) {
-    PyErr_SetString(PyExc_ValueError,
-        "Response is shorter than provided Content-Length header");
-    throw std::runtime_error {"Python header error"};
+constexpr char chunk_err[] {"Response iterator must yield bytes-like objects"};
+
+[[noreturn]] void throw_short_body() {
+  PyErr_SetString(PyExc_ValueError,
+      "Response is shorter than provided Content-Length header");
+  throw std::runtime_error {"Python header error"};
+}
+
+// Small bodies are copied behind the headers so the response goes out in one
+// contiguous write, large ones are sent straight from the exporter's memory
+void keep_or_copy(OutputBuffer& buf, PyBufferView& tail) {
+  if(tail.size() < body_view_min) {
+    buf.append(tail.data(), tail.size());
+    tail.release();
   }
 }
 
-void insert_body_pylist(std::vector<char>& buf, std::vector<char>& wb,
+void insert_body_pybuffer(OutputBuffer& buf, OutputBuffer& wb,
+    PyBufferView& tail, PyObject* iter) {
+  tail.acquire(iter, "WSGI App must return iterable");
+  insert_conlen(buf, tail.size() + wb.size());
+  buf.append(wb.data(), wb.size());
+  keep_or_copy(buf, tail);
+}
+
+void insert_body_pybuffer(OutputBuffer& buf, PyBufferView& tail,
+    PyObject* iter, Py_ssize_t sz) {
+  tail.acquire(iter, "WSGI App must return iterable");
+  if(tail.size() < static_cast<std::size_t>(sz))
+    throw_short_body();
+  tail.truncate(sz);
+  keep_or_copy(buf, tail);
+}
+
+void insert_body_pylist(OutputBuffer& buf, PyObject* iter, Py_ssize_t sz) {
+  for(Py_ssize_t i {0}, end {PyList_GET_SIZE(iter)}; i < end && sz; ++i)
+    sz -= insert_pybuffer(buf, PyList_GET_ITEM(iter, i), sz, chunk_err);
+
+  if(sz)
+    throw_short_body();
+}
+
+void insert_body_pylist(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter) {
   auto sz {get_body_list_size(iter)};
-  insert_str(buf, std::format("Content-Length: {}\r\n\r\n", sz + wb.size()));
-  buf.insert(buf.end(), wb.begin(), wb.end());
+  insert_conlen(buf, sz + wb.size());
+  buf.reserve(sz + wb.size());
+  buf.append(wb.data(), wb.size());
   for(Py_ssize_t i {0}, end {PyList_GET_SIZE(iter)}; i < end; ++i)
-    insert_pybytes_unchecked(buf, PyList_GET_ITEM(iter, i));
+    insert_pybuffer(buf, PyList_GET_ITEM(iter, i), chunk_err);
 }
 
-void insert_body_pytuple(std::vector<char>& buf, PyObject* iter,
+void insert_body_pytuple(OutputBuffer& buf, PyObject* iter,
     Py_ssize_t sz) {
   for(Py_ssize_t i {0}, end {PyTuple_GET_SIZE(iter)}; i < end && sz; ++i)
-    sz -= insert_pybytes_unchecked(buf, PyTuple_GET_ITEM(iter, i), sz);
+    sz -= insert_pybuffer(buf, PyTuple_GET_ITEM(iter, i), sz, chunk_err);
 
-  if(sz) {
-    PyErr_SetString(PyExc_ValueError,
-        "Response is shorter than provided Content-Length header");
-    throw std::runtime_error {"Python header error"};
-  }
+  if(sz)
+    throw_short_body();
 }
 
-void insert_body_pytuple(std::vector<char>& buf, std::vector<char>& wb,
+void insert_body_pytuple(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter) {
   auto sz {get_body_tuple_size(iter)};
-  insert_str(buf, std::format("Content-Length: {}\r\n\r\n", sz + wb.size()));
-  buf.insert(buf.end(), wb.begin(), wb.end());
+  insert_conlen(buf, sz + wb.size());
+  buf.reserve(sz + wb.size());
+  buf.append(wb.data(), wb.size());
   for(Py_ssize_t i {0}, end {PyTuple_GET_SIZE(iter)}; i < end; ++i)
-    insert_pybytes_unchecked(buf, PyTuple_GET_ITEM(iter, i));
+    insert_pybuffer(buf, PyTuple_GET_ITEM(iter, i), chunk_err);
 }
 
-void insert_body_pyseq(std::vector<char>& buf, std::vector<char>& wb,
+void insert_body_pyseq(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter) {
   PyObject* seq {PySequence_Tuple(iter)};
   insert_body_pytuple(buf, wb, seq);
   Py_DECREF(seq);
 }
 
-void insert_body_pyseq(std::vector<char>& buf, PyObject* iter, Py_ssize_t sz) {
+void insert_body_pyseq(OutputBuffer& buf, PyObject* iter, Py_ssize_t sz) {
   PyObject* seq {PySequence_Tuple(iter)};
   insert_body_pytuple(buf, seq, sz);
   Py_DECREF(seq);
 }
 
-PyObject* insert_body_iter_common(std::vector<char>& buf, std::vector<char>& wb,
+PyObject* insert_body_iter_common(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter, PyObject* first) {
   PyObject* second {PyIter_Next(iter)};
   if(!second) {
@@ -183,56 +243,58 @@ PyObject* insert_body_iter_common(std::vector<char>& buf, std::vector<char>& wb,
     if(PyErr_Occurred())
       throw std::runtime_error {"Python iterator error"};
 
-    const char* bytes;
-    Py_ssize_t len;
-    unpack_pybytes(first, &bytes, &len, "Response iterator must yield bytes");
-
-    insert_str(buf, std::format("Content-Length: {}\r\n\r\n", len + wb.size()));
-    buf.insert(buf.end(), wb.begin(), wb.end());
-    insert_chars(buf, bytes, len);
+    PyBufferView view;
+    view.acquire(first, chunk_err);
+    insert_conlen(buf, view.size() + wb.size());
+    buf.append(wb.data(), wb.size());
+    buf.append(view.data(), view.size());
+    view.release();
     Py_DECREF(first);
     return nullptr;
   }
 
-  insert_literal(buf, "Transfer-Encoding: chunked\r\n\r\n");
+  buf.append("Transfer-Encoding: chunked\r\n\r\n");
 
-  const char* bytes;
-  Py_ssize_t len;
-  unpack_pybytes(first, &bytes, &len, "Response iterator must yield bytes");
+  PyBufferView view;
+  view.acquire(first, chunk_err);
 
-  const char* bytes2;
-  Py_ssize_t len2;
-  unpack_pybytes(second, &bytes2, &len2, "Response iterator must yield bytes");
+  PyBufferView view2;
+  view2.acquire(second, chunk_err);
 
-  insert_str(buf, std::format("{:x}\r\n", len + len2 + wb.size()));
-  buf.insert(buf.end(), wb.begin(), wb.end());
-  insert_chars(buf, bytes, len);
-  insert_chars(buf, bytes2, len2);
-  insert_literal(buf, "\r\n");
+  std::size_t len {view.size() + view2.size() + wb.size()};
+  buf.reserve(OutputBuffer::max_int_chars + len + 4);
+  buf.append_hex(len);
+  buf.append_unchecked("\r\n", 2);
+  buf.append_unchecked(wb.data(), wb.size());
+  buf.append_unchecked(view.data(), view.size());
+  buf.append_unchecked(view2.data(), view2.size());
+  buf.append_unchecked("\r\n", 2);
+  view.release();
+  view2.release();
   Py_DECREF(first);
   Py_DECREF(second);
   return iter;
 }
 
-PyObject* insert_body_iter(std::vector<char>& buf, std::vector<char>& wb,
+PyObject* insert_body_iter(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter) {
   PyObject* first {PyIter_Next(iter)};
   if(!first) {
     close_iterator(iter);
     if(PyErr_Occurred())
       throw std::runtime_error {"Python iterator error"};
-    insert_literal(buf, "Content-Length: 0\r\n\r\n");
+    buf.append("Content-Length: 0\r\n\r\n");
     return nullptr;
   }
 
   return insert_body_iter_common(buf, wb, iter, first);
 }
 
-void insert_body_iter(std::vector<char>& buf, PyObject* iter, Py_ssize_t sz) {
+void insert_body_iter(OutputBuffer& buf, PyObject* iter, Py_ssize_t sz) {
   PyObject* next {nullptr};
   try {
     while((next = PyIter_Next(iter)) && sz) {
-      sz -= insert_pybytes(buf, next, sz, "Iterator must yield bytes object");
+      sz -= insert_pybuffer(buf, next, sz, chunk_err);
       Py_DECREF(next);
     }
   } catch(...) {
@@ -246,11 +308,8 @@ void insert_body_iter(std::vector<char>& buf, PyObject* iter, Py_ssize_t sz) {
   if(PyErr_Occurred())
     throw std::runtime_error {"Python iterator error"};
 
-  if(sz) {
-    PyErr_SetString(PyExc_ValueError,
-        "Response is shorter than provided Content-Length header");
-    throw std::runtime_error {"Python header error"};
-  }
+  if(sz)
+    throw_short_body();
 }
 
 PyObject* prime_generator(PyObject* iter) {
@@ -263,38 +322,35 @@ PyObject* prime_generator(PyObject* iter) {
   return next;
 }
 
-PyObject* insert_body_generator(std::vector<char>& buf, std::vector<char>& wb,
+PyObject* insert_body_generator(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter, PyObject* first) {
   if(!first) {
-    insert_literal(buf, "Content-Length: 0\r\n\r\n");
+    buf.append("Content-Length: 0\r\n\r\n");
     return nullptr;
   }
   return insert_body_iter_common(buf, wb, iter, first);
 }
 
-void insert_body_generator(std::vector<char>& buf, std::vector<char>& wb,
+void insert_body_generator(OutputBuffer& buf, OutputBuffer& wb,
     PyObject* iter, PyObject* first, Py_ssize_t sz) {
 
   if(wb.size() >= static_cast<std::size_t>(sz)) {
-    buf.insert(buf.end(), wb.begin(), wb.begin() + sz);
+    buf.append(wb.data(), sz);
     if(first) {
       Py_DECREF(first);
       close_iterator(iter);
     }
     return;
   } else {
-    buf.insert(buf.end(), wb.begin(), wb.end());
+    buf.append(wb.data(), wb.size());
     sz -= wb.size();
   }
 
-  if(!first) {
-    PyErr_SetString(PyExc_ValueError,
-        "Response is shorter than provided Content-Length header");
-    throw std::runtime_error {"Python header error"};
-  }
+  if(!first)
+    throw_short_body();
 
   try {
-    sz -= insert_pybytes(buf, first, sz, "Iterator must yield bytes object");
+    sz -= insert_pybuffer(buf, first, sz, chunk_err);
   } catch(...) {
     Py_DECREF(first);
     throw;
@@ -304,23 +360,24 @@ void insert_body_generator(std::vector<char>& buf, std::vector<char>& wb,
   insert_body_iter(buf, iter, sz);
 }
 
-
-void build_body(std::vector<char>& buf, std::vector<char>& wb, PyObject* iter,
-    Py_ssize_t conlen) {
-  insert_literal(buf, "\r\n");
+void build_body(OutputBuffer& buf, OutputBuffer& wb, PyBufferView& tail,
+    PyObject* iter, Py_ssize_t conlen) {
+  buf.append("\r\n");
 
   if(!wb.empty()) [[unlikely]] {
     if(wb.size() >= static_cast<std::size_t>(conlen)) {
-      buf.insert(buf.end(), wb.begin(), wb.begin() + conlen);
+      buf.append(wb.data(), conlen);
       return;
     }
 
-    buf.insert(buf.end(), wb.begin(), wb.end());
+    buf.append(wb.data(), wb.size());
     conlen -= wb.size();
   }
 
-  if(PyBytes_Check(iter)) {
-    insert_body_pybytes(buf, iter, conlen);
+  // Buffers have to be checked before sequences, bytearray and memoryview
+  // are both
+  if(PyObject_CheckBuffer(iter)) {
+    insert_body_pybuffer(buf, tail, iter, conlen);
   } else if(PyList_Check(iter)) {
     insert_body_pylist(buf, iter, conlen);
   } else if(PyTuple_Check(iter)) {
@@ -335,10 +392,10 @@ void build_body(std::vector<char>& buf, std::vector<char>& wb, PyObject* iter,
   }
 }
 
-PyObject* build_body(std::vector<char>& buf, std::vector<char>& wb,
+PyObject* build_body(OutputBuffer& buf, OutputBuffer& wb, PyBufferView& tail,
     PyObject* iter) {
-  if(PyBytes_Check(iter)) {
-    insert_body_pybytes(buf, wb, iter);
+  if(PyObject_CheckBuffer(iter)) {
+    insert_body_pybuffer(buf, wb, tail, iter);
   } else if(PyList_Check(iter)) {
     insert_body_pylist(buf, wb, iter);
   } else if(PyTuple_Check(iter)) {
@@ -354,41 +411,84 @@ PyObject* build_body(std::vector<char>& buf, std::vector<char>& wb,
   return nullptr;
 }
 
-struct {
-  std::queue<WSGIAppRet*> q;
+constexpr std::string_view not_modified_line {"HTTP/1.1 304 Not Modified\r\n"};
 
-  WSGIAppRet* pop() {
-    if(q.empty()) {
-      auto ptr = new WSGIAppRet;
-      ptr->buf.reserve(1024);
-      return ptr;
+// Value of an app supplied header, the list has already been validated by
+// build_headers()
+std::string_view find_header(PyObject* headers, std::string_view name) {
+  for(Py_ssize_t i {0}, end {PyList_GET_SIZE(headers)}; i < end; ++i) {
+    PyObject* tuple {PyList_GET_ITEM(headers, i)};
+    const char* base;
+    Py_ssize_t len;
+    unpack_unicode(PyTuple_GET_ITEM(tuple, 0), &base, &len, "");
+    if(static_cast<std::size_t>(len) == name.size() &&
+        !strncasecmp(name.data(), base, len)) {
+      unpack_unicode(PyTuple_GET_ITEM(tuple, 1), &base, &len, "");
+      return {base, static_cast<std::size_t>(len)};
     }
-    auto ptr = q.front();
-    q.pop();
-    return ptr;
   }
+  return {};
+}
 
-  void push(WSGIAppRet* ptr) {
-    ptr->reset();
-    q.push(ptr);
-  }
+std::string_view trim_ows(std::string_view str) {
+  while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    str.remove_prefix(1);
+  while(!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+    str.remove_suffix(1);
+  return str;
+}
 
-} AppRetQ;
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && !strncasecmp(a.data(), b.data(), a.size());
+}
+
+constexpr std::string_view vary_line {"Vary: Accept-Encoding\r\n"};
+
+std::string_view pystr_view(PyObject* str) {
+  if(!PyUnicode_Check(str) || PyUnicode_KIND(str) != PyUnicode_1BYTE_KIND)
+    return {};
+  return {static_cast<const char*>(PyUnicode_DATA(str)),
+      static_cast<std::size_t>(PyUnicode_GET_LENGTH(str))};
+}
 
 } // namespace
 
+ObjectPool<WSGIAppRet> gAppRetPool {"appret"};
+
+WSGIAppRet::WSGIAppRet() : buf {not_modified_line.size()} {
+  buf.reserve(1024);
+}
+
 void WSGIAppRet::reset() {
   buf.clear();
+  body.release();
+  if(file) {
+    try {
+      close_iterator(file);
+    } catch(...) {
+      PyErr_Print();
+      PyErr_Clear();
+    }
+    Py_CLEAR(file);
+  }
+  fd = -1;
+  segs.clear();
+  pin.reset();
+  if(gz) {
+    gGzipPool.push(gz);
+    gz = nullptr;
+  }
   conlen.reset();
   iter = nullptr;
 }
 
-void push_WSGIAppRet(WSGIAppRet* appret) {
-  AppRetQ.push(appret);
+std::size_t WSGIAppRet::footprint() const {
+  return buf.capacity();
 }
 
-WSGIApp::WSGIApp(PyObject* app, const char* host, const char* port)
-    : app_ {app}, vecCall_ {PyVectorcall_Function(app)} {
+WSGIApp::WSGIApp(PyObject* app, const char* host, const char* port,
+    bool etag, bool ranges, CompressOptions compress, std::size_t microcache)
+    : etag_ {etag}, ranges_ {ranges}, compress_ {std::move(compress)} {
 
   static PyMethodDef srdef {
       .ml_name = "start_response",
@@ -405,25 +505,33 @@ WSGIApp::WSGIApp(PyObject* app, const char* host, const char* port)
   cap_ = PyCapsule_New(this, NULL, NULL);
   sr_ = PyCFunction_New(&srdef, cap_);
   wcb_ = PyCFunction_New(&wcbdef, cap_);
-  baseEnv_ = _PyDict_NewPresized(64);
+  PyObject* env {_PyDict_NewPresized(64)};
 
-  PyDict_SetItemString(baseEnv_, "wsgi.version", gPO.wsgi_ver);
-  PyDict_SetItemString(baseEnv_, "wsgi.url_scheme", gPO.http);
+  PyDict_SetItemString(env, "wsgi.version", gPO.wsgi_ver);
+  PyDict_SetItemString(env, "wsgi.url_scheme", gPO.http);
 
   PyObject* phost {PyUnicode_FromString(host)};
-  PyDict_SetItemString(baseEnv_, "SERVER_NAME", phost);
+  PyDict_SetItemString(env, "SERVER_NAME", phost);
   Py_DECREF(phost);
 
   PyObject* pport {PyUnicode_FromString(port)};
-  PyDict_SetItemString(baseEnv_, "SERVER_PORT", pport);
+  PyDict_SetItemString(env, "SERVER_PORT", pport);
   Py_DECREF(pport);
 
-  PyDict_SetItemString(baseEnv_, "SCRIPT_NAME", gPO.empty);
-  PyDict_SetItemString(baseEnv_, "wsgi.input_terminated", Py_True);
-  PyDict_SetItemString(baseEnv_, "wsgi.errors", PySys_GetObject("stderr"));
-  PyDict_SetItemString(baseEnv_, "wsgi.multithread", Py_False);
-  PyDict_SetItemString(baseEnv_, "wsgi.multiprocess", Py_True);
-  PyDict_SetItemString(baseEnv_, "wsgi.run_once", Py_False);
+  PyDict_SetItemString(env, "SCRIPT_NAME", gPO.empty);
+  PyDict_SetItemString(env, "wsgi.input_terminated", Py_True);
+  PyDict_SetItemString(env, "wsgi.errors", PySys_GetObject("stderr"));
+  PyDict_SetItemString(env, "wsgi.multithread", Py_False);
+  PyDict_SetItemString(env, "wsgi.multiprocess", Py_True);
+  PyDict_SetItemString(env, "wsgi.run_once", Py_False);
+  PyDict_SetItemString(env, "wsgi.file_wrapper",
+      (PyObject*) &gVT.FileWrapperType);
+
+  if(microcache)
+    cache_ = std::make_unique<MicroCache>(microcache);
+
+  root_.baseEnv = env;
+  init_mount(root_, app);
 }
 
 WSGIApp::~WSGIApp() {
@@ -435,30 +543,296 @@ WSGIApp::~WSGIApp() {
   ((PyCFunctionObject*) sr_)->m_ml = &errdef;
   ((PyCFunctionObject*) wcb_)->m_ml = &errdef;
 
-  Py_DECREF(baseEnv_);
+  Py_DECREF(root_.baseEnv);
+  for(auto& [host, mounts] : mounts_) {
+    for(Mount& mount : mounts) {
+      Py_DECREF(mount.app);
+      Py_DECREF(mount.baseEnv);
+    }
+  }
   Py_DECREF(sr_);
   Py_DECREF(wcb_);
   Py_DECREF(cap_);
 }
 
+WSGIAppRet* WSGIApp::native_response(WSGIRequest* req, int meth,
+    bool keepalive) {
+  if(!static_files_.empty())
+    if(WSGIAppRet* ret {static_files_.respond(req, meth, keepalive)})
+      return ret;
+
+  if(!static_routes_.empty() &&
+      (meth == static_cast<int>(HTTPMethod::Get) ||
+          meth == static_cast<int>(HTTPMethod::Head))) {
+    auto it {static_routes_.find(req->url().view())};
+    if(it != static_routes_.end()) {
+      const StaticRoute& route {it->second};
+      WSGIAppRet* ret {gAppRetPool.pop()};
+      OutputBuffer& buf {ret->buf};
+      buf.append(route.status_line);
+      buf.append(gRequiredHeaders);
+      if(keepalive)
+        buf.append("Connection: keep-alive\r\n");
+      else
+        buf.append("Connection: close\r\n");
+      buf.append(route.headers);
+      if(meth == static_cast<int>(HTTPMethod::Get))
+        buf.append(route.body);
+      gRequestPool.push(req);
+      return ret;
+    }
+  }
+
+  if(!cache_ || !MicroCache::cacheable(req, meth))
+    return nullptr;
+
+  const std::string* hit {cache_->find(req, meth, keepalive)};
+  if(!hit)
+    return nullptr;
+
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  ret->buf.append(*hit);
+  gRequestPool.push(req);
+  return ret;
+}
+
+bool WSGIApp::add_static_route(PyObject* path, PyObject* spec) {
+  if(!PyUnicode_Check(path) || !PyTuple_Check(spec) ||
+      PyTuple_GET_SIZE(spec) != 3) {
+    PyErr_SetString(PyExc_TypeError,
+        "static_routes must map str paths to (status, headers, body)");
+    return false;
+  }
+
+  PyObject* status {PyTuple_GET_ITEM(spec, 0)};
+  PyObject* headers {PyTuple_GET_ITEM(spec, 1)};
+  PyObject* body {PyTuple_GET_ITEM(spec, 2)};
+
+  Py_ssize_t plen;
+  const char* pstr {PyUnicode_AsUTF8AndSize(path, &plen)};
+  if(!pstr)
+    return false;
+
+  StaticRoute route;
+  PyBufferView view;
+  try {
+    OutputBuffer buf;
+    insert_status(buf, status);
+    route.status_line.assign(buf.data(), buf.size());
+
+    if(!PyList_Check(headers)) {
+      PyErr_SetString(PyExc_TypeError, "Headers must be list");
+      return false;
+    }
+
+    // The body's real length always wins over a supplied Content-Length
+    buf.clear();
+    for(Py_ssize_t i {0}, end {PyList_GET_SIZE(headers)}; i < end; ++i)
+      insert_header(buf, PyList_GET_ITEM(headers, i));
+
+    view.acquire(body, "Static route body must be a bytes-like object");
+    if(!bodiless_status(route.status_line)) {
+      insert_conlen(buf, view.size());
+    } else if(view.size()) {
+      PyErr_SetString(PyExc_ValueError,
+          "Static routes with a 1xx, 204 or 304 status can't have a body");
+      throw std::runtime_error {"Python static route error"};
+    } else {
+      buf.append("\r\n");
+    }
+    route.headers.assign(buf.data(), buf.size());
+    route.body.assign(view.data(), view.size());
+    view.release();
+  } catch(...) {
+    view.release();
+    return false;
+  }
+
+  static_routes_.insert_or_assign(std::string {pstr,
+                                      static_cast<std::size_t>(plen)},
+      std::move(route));
+  return true;
+}
+
+void WSGIApp::init_mount(Mount& mount, PyObject* app) {
+  mount.app = app;
+  if(app == Py_None)
+    return;
+  mount.vecCall = PyVectorcall_Function(app);
+  if(Router::check(app))
+    mount.router = static_cast<Router*>(app);
+}
+
+bool WSGIApp::add_static_dir(PyObject* prefix, PyObject* root) {
+  return static_files_.add_dir(prefix, root);
+}
+
+bool WSGIApp::add_mount(PyObject* key, PyObject* app) {
+  if(!PyUnicode_Check(key) || !PyCallable_Check(app)) {
+    PyErr_SetString(PyExc_TypeError, "mounts must map str keys to WSGI apps");
+    return false;
+  }
+
+  Py_ssize_t len;
+  const char* str {PyUnicode_AsUTF8AndSize(key, &len)};
+  if(!str)
+    return false;
+
+  std::string_view sv {str, static_cast<std::size_t>(len)};
+  std::size_t slash {sv.find('/')};
+  std::string host {sv.substr(0, slash)};
+  for(char& c : host)
+    if(c >= 'A' && c <= 'Z')
+      c |= 0x20;
+
+  std::string_view prefix {slash == sv.npos ? "" : sv.substr(slash)};
+  while(!prefix.empty() && prefix.back() == '/')
+    prefix.remove_suffix(1);
+
+  PyObject* env {PyDict_Copy(root_.baseEnv)};
+  PyObject* script {
+      env ? PyUnicode_FromStringAndSize(prefix.data(), prefix.size())
+          : nullptr};
+  if(!script || PyDict_SetItemString(env, "SCRIPT_NAME", script)) {
+    Py_XDECREF(script);
+    Py_XDECREF(env);
+    return false;
+  }
+  Py_DECREF(script);
+
+  Mount mount {.baseEnv = env, .prefix = std::string {prefix}};
+  init_mount(mount, Py_NewRef(app));
+
+  // "/api" and "/api/" are the same mount, the later one replaces it
+  std::vector<Mount>& mounts {mounts_[host]};
+  auto it {std::ranges::find_if(mounts,
+      [&](const Mount& m) { return m.prefix.size() <= prefix.size(); })};
+  if(it != mounts.end() && it->prefix == prefix) {
+    Py_DECREF(it->app);
+    Py_DECREF(it->baseEnv);
+    *it = std::move(mount);
+  } else {
+    mounts.insert(it, std::move(mount));
+  }
+
+  if(!host.empty()) {
+    host_mounts_ = true;
+    if(cache_)
+      cache_->key_on_host();
+  }
+  return true;
+}
+
+const WSGIApp::Mount& WSGIApp::select_mount(WSGIRequest* req) {
+  std::string_view path {req->url().view()};
+  auto longest {[&](const std::vector<Mount>& mounts) -> const Mount* {
+    for(const Mount& mount : mounts) {
+      std::string_view pre {mount.prefix};
+      if(path.starts_with(pre) &&
+          (path.size() == pre.size() || path[pre.size()] == '/'))
+        return &mount;
+    }
+    return nullptr;
+  }};
+
+  if(host_mounts_) {
+    std::string_view host;
+    for(auto& hdr : req->headers_)
+      if(hdr.field.view() == "HTTP_HOST")
+        host = hdr.value.view();
+
+    // Ports are ignored, IPv6 literals keep their colons
+    if(host.starts_with('[')) {
+      if(std::size_t close {host.find(']')}; close != host.npos)
+        host = host.substr(0, close + 1);
+    } else if(std::size_t colon {host.find(':')}; colon != host.npos) {
+      host = host.substr(0, colon);
+    }
+
+    host_scratch_.assign(host);
+    for(char& c : host_scratch_)
+      if(c >= 'A' && c <= 'Z')
+        c |= 0x20;
+
+    if(auto it {mounts_.find(host_scratch_)}; it != mounts_.end())
+      if(const Mount* mount {longest(it->second)})
+        return *mount;
+  }
+
+  if(auto it {mounts_.find(std::string_view {})}; it != mounts_.end())
+    if(const Mount* mount {longest(it->second)})
+      return *mount;
+
+  return root_;
+}
+
 WSGIAppRet* WSGIApp::run(WSGIRequest* req, int http_minor, int meth,
     bool keepalive) {
-  WSGIAppRet* ret {AppRetQ.pop()};
+  const Mount& mount {mounts_.empty() ? root_ : select_mount(req)};
+  if(mount.app == Py_None)
+    return route_miss(req, RouteTree::Result::NotFound, keepalive);
+
+  // PATH_INFO is whatever the mount's prefix leaves of the path, viewed in
+  // place
+  std::string_view path {req->url().view()};
+  if(!mount.prefix.empty()) {
+    path.remove_prefix(mount.prefix.size());
+    req->path_info_.from(const_cast<char*>(path.data()), path.size());
+  }
+
+  PyObject* app {mount.app};
+  vectorcallfunc vecCall {mount.vecCall};
+  if(mount.router) {
+    auto result {mount.router->tree->match(path, meth, app, caps_,
+        &allowed_)};
+    if(result != RouteTree::Result::Found)
+      return route_miss(req, result, keepalive);
+    vecCall = PyVectorcall_Function(app);
+  }
+
+  WSGIAppRet* ret {gAppRetPool.pop()};
 
-  auto env {make_env(req, http_minor, meth)};
+  auto env {make_env(req, http_minor, meth, mount)};
   PyObject* iter {nullptr};
 
+  if(mount.router) {
+    PyObject* caps {Router::captures(caps_)};
+    if(!caps || PyDict_SetItem(env, gPO.velocem_caps, caps)) [[unlikely]] {
+      PyErr_Print();
+      PyErr_Clear();
+      Py_XDECREF(caps);
+      Py_DECREF(env);
+      gAppRetPool.push(ret);
+      return nullptr;
+    }
+    Py_DECREF(caps);
+  }
+
+  // Holding the values keeps the request alive past the env dict
+  bool head {meth == static_cast<int>(HTTPMethod::Head)};
+  Conditionals cond;
+  if(etag_)
+    cond.inm = Py_XNewRef(PyDict_GetItem(env, gPO.http_inm));
+  if(ranges_) {
+    cond.range = Py_XNewRef(PyDict_GetItem(env, gPO.http_range));
+    cond.if_range = Py_XNewRef(PyDict_GetItem(env, gPO.http_if_range));
+  }
+  if(compress_.level)
+    cond.accept_enc = Py_XNewRef(PyDict_GetItem(env, gPO.http_accept_enc));
+  if(cache_ && MicroCache::cacheable(req, meth))
+    cond.path = req->share((PyObject*) &req->url());
+
   in_handle = true;
   status_ = nullptr;
   headers_ = nullptr;
   writebuf_.clear();
 
   try {
-    if(vecCall_) {
+    if(vecCall) {
       std::array args {env, sr_};
-      iter = vecCall_(app_, args.data(), args.size(), nullptr);
+      iter = vecCall(app, args.data(), args.size(), nullptr);
     } else {
-      iter = PyObject_CallFunctionObjArgs(app_, env, sr_, nullptr);
+      iter = PyObject_CallFunctionObjArgs(app, env, sr_, nullptr);
     }
 
     Py_DECREF(env);
@@ -490,12 +864,32 @@ WSGIAppRet* WSGIApp::run(WSGIRequest* req, int http_minor, int meth,
       ret->conlen = build_headers(ret->buf, keepalive);
       in_handle = false;
 
-      if(!ret->conlen)
-        ret->iter = build_body(ret->buf, writebuf_, iter);
-      else
-        build_body(ret->buf, writebuf_, iter, *ret->conlen);
+      if(FileWrapper::check(iter) && writebuf_.empty() &&
+          build_file_body(ret, iter)) {
+        // Sent straight from the file descriptor
+      } else if(Channel::check(iter)) {
+        build_channel_body(ret, iter);
+      } else if(!ret->conlen) {
+        ret->iter = build_body(ret->buf, writebuf_, ret->body, iter);
+      } else {
+        build_body(ret->buf, writebuf_, ret->body, iter, *ret->conlen);
+      }
+    }
+
+    if(compress_.level)
+      compress_response(ret,
+          cond.accept_enc && accepts_gzip(pystr_view(cond.accept_enc)));
+
+    if(etag_ || ranges_ || head) {
+      if(ret->iter && head) {
+        close_iterator(iter);
+        ret->iter = nullptr;
+      }
+      finish_response(ret, cond, head);
     }
 
+    if(cond.path)
+      cache_->store(req, meth, keepalive, *ret);
 
   } catch(...) {
     PyErr_Print();
@@ -504,7 +898,7 @@ WSGIAppRet* WSGIApp::run(WSGIRequest* req, int http_minor, int meth,
     Py_XDECREF(iter);
     Py_XDECREF(status_);
     Py_XDECREF(headers_);
-    AppRetQ.push(ret);
+    gAppRetPool.push(ret);
 
     in_handle = false;
     return nullptr;
@@ -517,14 +911,243 @@ WSGIAppRet* WSGIApp::run(WSGIRequest* req, int http_minor, int meth,
   return ret;
 }
 
-PyObject* WSGIApp::make_env(WSGIRequest* req, int http_minor, int meth) {
-  auto env {PyDict_Copy(baseEnv_)};
+WSGIAppRet* WSGIApp::route_miss(WSGIRequest* req, RouteTree::Result result,
+    bool keepalive) {
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  Router::write_miss(ret->buf, result, allowed_, keepalive);
+  gRequestPool.push(req);
+  return ret;
+}
+
+bool WSGIApp::build_file_body(WSGIAppRet* ret, PyObject* iter) {
+  int fd;
+  std::uint64_t off, len;
+  if(!static_cast<FileWrapper*>(iter)->file_span(&fd, &off, &len))
+    return false;
+
+  if(ret->conlen) {
+    if(static_cast<std::uint64_t>(*ret->conlen) > len)
+      throw_short_body();
+    len = *ret->conlen;
+    ret->buf.append("\r\n");
+  } else {
+    insert_conlen(ret->buf, len);
+    ret->conlen = len;
+  }
+
+  ret->file = Py_NewRef(iter);
+  ret->fd = fd;
+  ret->segs.push_back({0, ret->buf.size(), off, len});
+  return true;
+}
+
+void WSGIApp::build_channel_body(WSGIAppRet* ret, PyObject* iter) {
+  if(ret->conlen) {
+    PyErr_SetString(PyExc_ValueError,
+        "A Channel body can't have a Content-Length");
+    throw std::runtime_error {"WSGI application error"};
+  }
+
+  if(!static_cast<Channel*>(iter)->claim()) {
+    PyErr_SetString(PyExc_ValueError,
+        "Channel was already returned for another response");
+    throw std::runtime_error {"WSGI application error"};
+  }
+
+  OutputBuffer& buf {ret->buf};
+  buf.append("Transfer-Encoding: chunked\r\n\r\n");
+  if(!writebuf_.empty()) {
+    buf.append_hex(writebuf_.size());
+    buf.append("\r\n");
+    buf.append(writebuf_.data(), writebuf_.size());
+    buf.append("\r\n");
+  }
+  ret->iter = iter;
+}
+
+bool WSGIApp::compressible(std::string_view ctype) const {
+  ctype = trim_ows(ctype.substr(0, ctype.find(';')));
+  for(const std::string& type : compress_.types) {
+    std::string_view t {type};
+    if(t.ends_with("/*")) {
+      t.remove_suffix(1);
+      if(ctype.size() > t.size() && iequals(ctype.substr(0, t.size()), t))
+        return true;
+    } else if(iequals(ctype, t)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs before finish_response(), so ETags are computed over and ranges taken
+// from the encoded body. Every response that could have been compressed gets
+// Vary, whether or not this client accepted it. Channels are left alone, every
+// send() would cost a flush and most of them are small events.
+void WSGIApp::compress_response(WSGIAppRet* ret, bool accepted) {
+  if(!ret->segs.empty() || (ret->iter && Channel::check(ret->iter)))
+    return;
+
+  std::string_view out {ret->buf.data(), ret->buf.size()};
+  std::size_t hdr_end {out.find("\r\n\r\n")};
+  if(hdr_end == out.npos || out.size() < 12) [[unlikely]]
+    return;
+  hdr_end += 4;
+
+  if(bodiless_status(out))
+    return;
+
+  if(!find_header(headers_, "content-encoding").empty() ||
+      !compressible(find_header(headers_, "content-type")))
+    return;
+
+  // Streamed bodies are always worth it, their size isn't known up front. A
+  // large returned buffer is sent from ret->body, after whatever write() put
+  // in buf.
+  std::size_t size {out.size() - hdr_end + ret->body.size()};
+  if(!accepted || (!ret->iter && size < compress_.min_size)) {
+    ret->buf.insert(hdr_end - 2, vary_line.data(), vary_line.size());
+    return;
+  }
+
+  gz_scratch_.clear();
+  z_stream* zs {gGzipPool.pop()};
+
+  if(ret->iter) {
+    // The first chunk is already framed behind the headers, re-encode it and
+    // leave the stream open for handle_iter()
+    std::string_view chunk {out.substr(hdr_end)};
+    std::size_t crlf {chunk.find("\r\n")};
+    std::size_t len {0};
+    std::from_chars(chunk.data(), chunk.data() + crlf, len, 16);
+    chunk = chunk.substr(crlf + 2, len);
+
+    try {
+      gzip_append(zs, chunk.data(), chunk.size(), Z_SYNC_FLUSH, gz_scratch_);
+    } catch(...) {
+      gGzipPool.push(zs);
+      throw;
+    }
+    ret->gz = zs;
+
+    ret->buf.truncate(hdr_end - 2);
+    ret->buf.append("Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n\r\n");
+    ret->buf.append_hex(gz_scratch_.size());
+    ret->buf.append("\r\n");
+    ret->buf.append(gz_scratch_.data(), gz_scratch_.size());
+    ret->buf.append("\r\n");
+    return;
+  }
+
+  bool tail {!ret->body.empty()};
+  try {
+    gzip_append(zs, out.data() + hdr_end, out.size() - hdr_end,
+        tail ? Z_NO_FLUSH : Z_FINISH, gz_scratch_);
+    if(tail)
+      gzip_append(zs, ret->body.data(), ret->body.size(), Z_FINISH,
+          gz_scratch_);
+  } catch(...) {
+    gGzipPool.push(zs);
+    throw;
+  }
+  gGzipPool.push(zs);
+
+  // Content-Length is always the last header
+  ret->buf.truncate(out.rfind("Content-Length: ", hdr_end));
+  ret->buf.append("Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n");
+  insert_conlen(ret->buf, gz_scratch_.size());
+  ret->buf.append(gz_scratch_.data(), gz_scratch_.size());
+  ret->body.release();
+  ret->conlen = gz_scratch_.size();
+}
+
+void WSGIApp::finish_response(WSGIAppRet* ret, const Conditionals& cond,
+    bool head) {
+  std::string_view out {ret->buf.data(), ret->buf.size()};
+  std::size_t status_end {out.find("\r\n") + 2};
+  std::size_t hdr_end {out.find("\r\n\r\n")};
+  if(hdr_end == out.npos) [[unlikely]]
+    return;
+  hdr_end += 4;
+
+  bool file {!ret->segs.empty()};
+
+  // Only complete 200s with a known length take part
+  if(!ret->iter && out.starts_with("HTTP/1.1 200 ")) {
+    std::string_view etag {find_header(headers_, "etag")};
+    std::string added;
+    char tagbuf[18];
+
+    // Files aren't read just to hash them, they need an app supplied ETag
+    if(etag_ && etag.empty() && !file) {
+      std::uint64_t h {hash_bytes(out.data() + hdr_end, out.size() - hdr_end)};
+      if(!ret->body.empty())
+        h = hash_bytes(ret->body.data(), ret->body.size(), h);
+
+      tagbuf[0] = tagbuf[17] = '"';
+      for(int i {16}; i > 0; --i, h >>= 4)
+        tagbuf[i] = "0123456789abcdef"[h & 0xF];
+      etag = {tagbuf, sizeof(tagbuf)};
+      added.append("ETag: ").append(etag).append("\r\n");
+    }
+
+    if(ranges_)
+      added.append("Accept-Ranges: bytes\r\n");
+
+    if(!added.empty()) {
+      // Invalidates out
+      ret->buf.insert(hdr_end - 2, added.data(), added.size());
+      hdr_end += added.size();
+    }
+
+    if(cond.inm && !etag.empty() &&
+        none_match_matches(pystr_view(cond.inm), etag)) {
+      ret->buf.truncate(hdr_end);
+      ret->body.release();
+      ret->segs.clear();
+      ret->buf.consume(status_end);
+      ret->buf.prepend(not_modified_line);
+      return;
+    }
+
+    if(cond.range && !head &&
+        (!cond.if_range ||
+            if_range_matches(pystr_view(cond.if_range), etag,
+                find_header(headers_, "last-modified")))) {
+      // Ranges are sliced from one contiguous body. write() output ahead of
+      // a returned view is rare, the view is copied in behind it.
+      if(!ret->body.empty() && ret->buf.size() > hdr_end) [[unlikely]] {
+        ret->buf.append(ret->body.data(), ret->body.size());
+        ret->body.release();
+      }
+      std::uint64_t size {file ? ret->segs.front().file_len
+              : ret->body.empty() ? ret->buf.size() - hdr_end
+                                  : ret->body.size()};
+      auto result {parse_range(pystr_view(cond.range), size, ranges_scratch_)};
+      if(result != RangeResult::Ignore) {
+        apply_ranges(*ret, result, ranges_scratch_, size, status_end, hdr_end);
+        return;
+      }
+    }
+  }
+
+  if(head) {
+    ret->buf.truncate(hdr_end);
+    ret->body.release();
+    ret->segs.clear();
+  }
+}
+
+PyObject* WSGIApp::make_env(WSGIRequest* req, int http_minor, int meth,
+    const Mount& mount) {
+  auto env {PyDict_Copy(mount.baseEnv)};
 
   PyDict_SetItem(env, gPO.meth, gPO.methods[meth]);
-  PyDict_SetItem(env, gPO.path, (PyObject*) &req->url());
+  PyDict_SetItem(env, gPO.path,
+      mount.prefix.empty() ? (PyObject*) &req->url()
+                           : (PyObject*) &req->path_info_);
   PyDict_SetItem(env, gPO.wsgi_input, (PyObject*) &req->input_);
 
-
   if(req->has_query())
     PyDict_SetItem(env, gPO.query, (PyObject*) &req->query());
   else
@@ -532,8 +1155,12 @@ PyObject* WSGIApp::make_env(WSGIRequest* req, int http_minor, int meth) {
 
   PyDict_SetItem(env, gPO.proto, http_minor ? gPO.http11 : gPO.http10);
 
-  for(const auto& [hdr, val] : std::views::zip(req->headers_, req->values_))
-    PyDict_SetItem(env, (PyObject*) &hdr.bsv, (PyObject*) &val);
+  for(auto& hdr : req->headers_)
+    PyDict_SetItem(env, (PyObject*) &hdr.field, (PyObject*) &hdr.value);
+
+  // Duplicate headers get dropped by the dict, so the request only counts
+  // whatever objects actually made it in
+  req->adopt_refs();
 
   replace_key(env, gPO.http_conlen, gPO.conlen);
   replace_key(env, gPO.http_contype, gPO.contype);
@@ -541,38 +1168,58 @@ PyObject* WSGIApp::make_env(WSGIRequest* req, int http_minor, int meth) {
   return env;
 }
 
-std::optional<Py_ssize_t> WSGIApp::build_headers(std::vector<char>& buf,
+std::optional<Py_ssize_t> WSGIApp::build_headers(OutputBuffer& buf,
     bool keep_alive) {
-  std::optional<Py_ssize_t> ret;
-  insert_literal(buf, "HTTP/1.1 ");
-  insert_pystr(buf, status_, "Status must be str object");
-  insert_literal(buf, "\r\n");
-  insert_str(buf, gRequiredHeaders);
-  if(keep_alive)
-    insert_literal(buf, "Connection: keep-alive\r\n");
-  else
-    insert_literal(buf, "Connection: close\r\n");
-
-  if(!PyList_Check(headers_)) [[unlikely]] {
-    PyErr_SetString(PyExc_TypeError, "Headers must be list");
-    throw std::runtime_error {"Python list error"};
-  }
-
-  Py_ssize_t i {0}, end {PyList_GET_SIZE(headers_)};
+  std::optional<std::string_view> conlen_str;
+
+  if(auto hit {hdr_cache_.find(status_, headers_)}) {
+    std::string_view block {hit->block};
+    buf.append(block.data(), hit->status_len);
+    buf.append(gRequiredHeaders);
+    if(keep_alive)
+      buf.append("Connection: keep-alive\r\n");
+    else
+      buf.append("Connection: close\r\n");
+    block.remove_prefix(hit->status_len);
+    buf.append(block.data(), block.size());
+    conlen_str = hdr_cache_.conlen();
+  } else {
+    std::size_t start {buf.size()};
+    insert_status(buf, status_);
+    std::size_t status_len {buf.size() - start};
+
+    buf.append(gRequiredHeaders);
+    if(keep_alive)
+      buf.append("Connection: keep-alive\r\n");
+    else
+      buf.append("Connection: close\r\n");
+
+    if(!PyList_Check(headers_)) [[unlikely]] {
+      PyErr_SetString(PyExc_TypeError, "Headers must be list");
+      throw std::runtime_error {"Python list error"};
+    }
 
-  for(; i < end; ++i) {
-    auto result {insert_header(buf, PyList_GET_ITEM(headers_, i))};
-    if(result) {
-      ret = result;
-      ++i;
-      break;
+    std::size_t hdr_start {buf.size()};
+    for(Py_ssize_t i {0}, end {PyList_GET_SIZE(headers_)}; i < end; ++i) {
+      auto result {insert_header(buf, PyList_GET_ITEM(headers_, i))};
+      if(result && !conlen_str)
+        conlen_str = result;
     }
+
+    // Only cache what validated, a throw above skips this
+    std::string block {buf.data() + start, status_len};
+    block.append(buf.data() + hdr_start, buf.size() - hdr_start);
+    hdr_cache_.insert(block, status_len);
   }
 
-  for(; i < end; ++i)
-    insert_header(buf, PyList_GET_ITEM(headers_, i));
+  if(!conlen_str)
+    return {};
 
-  return ret;
+  Py_ssize_t conlen {parse_conlen(*conlen_str)};
+  buf.append("Content-Length: ");
+  buf.append(conlen_str->data(), conlen_str->size());
+  buf.append("\r\n");
+  return conlen;
 }
 
 namespace {
@@ -635,10 +1282,14 @@ PyObject* WSGIApp::start_response_tr(PyObject* self, PyObject* const* args,
 PyObject* WSGIApp::write_cb(PyObject* const* args, Py_ssize_t nargs) {
   PyObject* bytes;
 
-  if(!_PyArg_ParseStack(args, nargs, "S", &bytes))
+  if(!_PyArg_ParseStack(args, nargs, "O", &bytes))
     return nullptr;
 
-  insert_pybytes_unchecked(writebuf_, bytes);
+  try {
+    insert_pybuffer(writebuf_, bytes, "write() argument must be bytes-like");
+  } catch(...) {
+    return nullptr;
+  }
   Py_RETURN_NONE;
 }
 
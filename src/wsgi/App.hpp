@@ -1,29 +1,80 @@
 #ifndef VELOCEM_WSGI_APP_HPP
 #define VELOCEM_WSGI_APP_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <Python.h>
+#include <zlib.h>
+
+#include "router/RouteTree.hpp"
+#include "util/Hash.hpp"
+#include "util/OutputBuffer.hpp"
+#include "util/Pool.hpp"
+#include "util/Util.hpp"
+
+#include "HeaderCache.hpp"
+#include "MicroCache.hpp"
+#include "Range.hpp"
+#include "StaticFiles.hpp"
 
 namespace velocem {
+struct Router;
 struct WSGIRequest;
-}
+} // namespace velocem
 
 namespace velocem {
 
+// Part of a file-backed response: buf[buf_off, buf_off + buf_len) followed by
+// file_len bytes of the file starting at file_off
+struct FileSegment {
+  std::size_t buf_off;
+  std::size_t buf_len;
+  std::uint64_t file_off;
+  std::uint64_t file_len;
+};
+
 struct WSGIAppRet {
+  WSGIAppRet();
+
   void reset();
+  std::size_t footprint() const;
 
-  std::vector<char> buf;
+  OutputBuffer buf;
+  PyBufferView body; // Large bodies are sent from here, after buf
   PyObject* iter {nullptr};
   std::optional<Py_ssize_t> conlen;
+
+  // File-backed bodies, the wrapper is closed when the response is reset
+  PyObject* file {nullptr};
+  int fd {-1};
+  std::vector<FileSegment> segs;
+  std::shared_ptr<const void> pin; // Keeps a cached descriptor open
+
+  // Deflate stream for a compressed chunked body, returned to gGzipPool on
+  // reset
+  z_stream* gz {nullptr};
 };
 
-void push_WSGIAppRet(WSGIAppRet* appret);
+extern ObjectPool<WSGIAppRet> gAppRetPool;
+
+struct CompressOptions {
+  int level {0}; // Disabled at 0
+  std::size_t min_size {1024};
+  std::vector<std::string> types; // Media types, "type/*" matches a family
+};
 
 struct WSGIApp {
-  WSGIApp(PyObject* app, const char* host, const char* port);
+  WSGIApp(PyObject* app, const char* host, const char* port,
+      bool etag = false, bool ranges = false, CompressOptions compress = {},
+      std::size_t microcache = 0);
 
   WSGIApp(WSGIApp&) = delete;
   WSGIApp(WSGIApp&&) = delete;
@@ -32,12 +83,75 @@ struct WSGIApp {
 
   WSGIAppRet* run(WSGIRequest* req, int http_minor, int meth, bool keepalive);
 
-private:
-  PyObject* make_env(WSGIRequest* req, int http_minor, int meth);
+  // A static file, static route or microcache response, consuming the
+  // request, or nullptr if it has to go to run()
+  WSGIAppRet* native_response(WSGIRequest* req, int meth, bool keepalive);
+
+  // Serializes a (status, headers, body) tuple served for GET and HEAD on
+  // path without calling the app. Returns false with a Python exception set
+  // if it doesn't validate.
+  bool add_static_route(PyObject* path, PyObject* spec);
 
-  std::optional<Py_ssize_t> build_headers(std::vector<char>& buf,
+  // Mounts app at a key of "/prefix" for any host, or "host/prefix" for one
+  // host. The longest prefix ending on a segment boundary wins, moving from
+  // PATH_INFO to SCRIPT_NAME. Returns false with a Python exception set.
+  bool add_mount(PyObject* key, PyObject* app);
+
+  // Serves the files under root for paths under prefix, see StaticFiles.
+  // Returns false with a Python exception set.
+  bool add_static_dir(PyObject* prefix, PyObject* root);
+
+private:
+  // An app and the environ it's called with. The app the server was started
+  // with is the root mount, None if it only serves mounts.
+  struct Mount {
+    PyObject* app {nullptr};
+    vectorcallfunc vecCall {nullptr};
+    Router* router {nullptr};
+    PyObject* baseEnv {nullptr};
+    std::string prefix; // SCRIPT_NAME, without a trailing slash
+  };
+
+  static void init_mount(Mount& mount, PyObject* app);
+  const Mount& select_mount(WSGIRequest* req);
+
+  PyObject* make_env(WSGIRequest* req, int http_minor, int meth,
+      const Mount& mount);
+
+  std::optional<Py_ssize_t> build_headers(OutputBuffer& buf,
       bool keep_alive);
 
+  bool build_file_body(WSGIAppRet* ret, PyObject* iter);
+  void build_channel_body(WSGIAppRet* ret, PyObject* iter);
+
+  // 404 or 405 for a path the Router has no handler for, or no mount serves,
+  // consuming the request
+  WSGIAppRet* route_miss(WSGIRequest* req, RouteTree::Result result,
+      bool keepalive);
+
+  // Request headers consulted after the app returns, for compression, ETags,
+  // Range requests and HEAD body suppression applied to the serialized
+  // response
+  struct Conditionals {
+    ~Conditionals() {
+      Py_XDECREF(inm);
+      Py_XDECREF(range);
+      Py_XDECREF(if_range);
+      Py_XDECREF(accept_enc);
+      Py_XDECREF(path);
+    }
+
+    PyObject* inm {nullptr};
+    PyObject* range {nullptr};
+    PyObject* if_range {nullptr};
+    PyObject* accept_enc {nullptr};
+    PyObject* path {nullptr}; // Pins the request for the microcache
+  };
+
+  bool compressible(std::string_view ctype) const;
+  void compress_response(WSGIAppRet* ret, bool accepted);
+  void finish_response(WSGIAppRet* ret, const Conditionals& cond, bool head);
+
   PyObject* start_response(PyObject* const* args, Py_ssize_t nargs,
       PyObject* kwnames);
 
@@ -52,11 +166,39 @@ private:
   static PyObject* err_call(PyObject*, PyObject* const*, Py_ssize_t);
 
   bool in_handle;
-  std::vector<char> writebuf_;
+  bool etag_;
+  bool ranges_;
+  std::vector<ByteRange> ranges_scratch_;
+  CompressOptions compress_;
+  OutputBuffer gz_scratch_;
+  OutputBuffer writebuf_;
+  HeaderCache hdr_cache_;
+  std::unique_ptr<MicroCache> cache_;
+
+  // Everything but the Date and Connection headers is serialized up front
+  struct StaticRoute {
+    std::string status_line;
+    std::string headers; // Through the blank line ending the block
+    std::string body;
+  };
+  std::unordered_map<std::string, StaticRoute, StringHash, std::equal_to<>>
+      static_routes_;
+  StaticFiles static_files_;
+
+  // When a mount's app is a velocem.Router, requests are matched before their
+  // environ is built and the handler is called directly
+  std::vector<RouteTree::Capture> caps_;
+  std::vector<int> allowed_;
+
+  // Keyed by lowercase host without a port, "" for any host. Each list is
+  // ordered longest prefix first.
+  Mount root_;
+  std::unordered_map<std::string, std::vector<Mount>, StringHash,
+      std::equal_to<>>
+      mounts_;
+  bool host_mounts_ {false};
+  std::string host_scratch_;
 
-  PyObject* app_;
-  PyObject* baseEnv_;
-  vectorcallfunc vecCall_;
   PyObject* cap_;
   PyObject* sr_;
   PyObject* wcb_;
@@ -0,0 +1,138 @@
+#include "Channel.hpp"
+
+#include <array>
+#include <thread>
+
+#include <asio.hpp>
+
+#include <Python.h>
+
+#include "util/Constants.hpp"
+
+namespace velocem {
+
+bool Channel::check(PyObject* obj) {
+  return Py_IS_TYPE(obj, &gVT.ChannelType);
+}
+
+bool Channel::claim() {
+  if(state->claimed)
+    return false;
+  state->claimed = true;
+  return true;
+}
+
+void Channel::hang_up() {
+  state->closed = true;
+  state->hung_up = true;
+  state->pending.clear();
+  wake();
+}
+
+// The server thread runs with the GIL held, so anything calling in here has
+// already been serialized against it. Only the timer itself can't be touched
+// from elsewhere, other threads hand the cancel to the loop.
+void Channel::wake() {
+  State& st {*state};
+  if(!st.timer)
+    return;
+
+  if(std::this_thread::get_id() == st.loop) {
+    st.timer->cancel();
+    return;
+  }
+
+  if(st.wake_posted)
+    return;
+  st.wake_posted = true;
+  Py_INCREF(this);
+  asio::post(st.timer->get_executor(), [this] {
+    state->wake_posted = false;
+    if(state->timer)
+      state->timer->cancel();
+    Py_DECREF(this);
+  });
+}
+
+PyObject* Channel::new_(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+  if(!PyArg_ParseTuple(args, ":Channel") || (kwds && PyDict_GET_SIZE(kwds))) {
+    if(!PyErr_Occurred())
+      PyErr_SetString(PyExc_TypeError, "Channel() takes no arguments");
+    return nullptr;
+  }
+
+  auto self {reinterpret_cast<Channel*>(type->tp_alloc(type, 0))};
+  if(!self)
+    return nullptr;
+  self->state = new State;
+  return self;
+}
+
+void Channel::dealloc(Channel* self) {
+  delete self->state;
+  Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* Channel::send(Channel* self, PyObject* data) {
+  if(self->state->closed)
+    Py_RETURN_FALSE;
+
+  Py_buffer view;
+  if(PyObject_GetBuffer(data, &view, PyBUF_SIMPLE))
+    return nullptr;
+
+  // Sends made before the app returns are written as soon as it parks
+  if(view.len) {
+    std::string& pending {self->state->pending};
+    if(pending.size() + view.len > max_pending) [[unlikely]] {
+      PyBuffer_Release(&view);
+      self->hang_up();
+      Py_RETURN_FALSE;
+    }
+    bool was_empty {pending.empty()};
+    pending.append(static_cast<const char*>(view.buf), view.len);
+    if(was_empty)
+      self->wake();
+  }
+  PyBuffer_Release(&view);
+  Py_RETURN_TRUE;
+}
+
+PyObject* Channel::close(Channel* self, PyObject*) {
+  if(!self->state->closed) {
+    self->state->closed = true;
+    self->wake();
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject* Channel::get_closed(Channel* self, void*) {
+  return PyBool_FromLong(self->state->closed);
+}
+
+void Channel::init_type(PyTypeObject* ChannelType) {
+  static std::array<PyMethodDef, 3> meths {
+      PyMethodDef {"send", (PyCFunction) send, METH_O},
+      {"close", (PyCFunction) close, METH_NOARGS},
+      {nullptr, nullptr},
+  };
+
+  static std::array<PyGetSetDef, 2> getset {
+      PyGetSetDef {"closed", (getter) get_closed},
+      {nullptr},
+  };
+
+  *ChannelType = PyTypeObject {
+      .tp_name = "velocem.Channel",
+      .tp_basicsize = sizeof(Channel),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_doc = "Response body pushed to after the app returns",
+      .tp_methods = meths.data(),
+      .tp_getset = getset.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(ChannelType);
+}
+
+} // namespace velocem
@@ -0,0 +1,69 @@
+#ifndef VELOCEM_WSGI_CHANNEL_HPP
+#define VELOCEM_WSGI_CHANNEL_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <asio.hpp>
+
+#include <Python.h>
+
+namespace velocem {
+
+// velocem.Channel, a response body pushed to after the app has returned. The
+// app returns one in place of an iterable, its headers go out with
+// Transfer-Encoding: chunked and the connection is parked in the event loop
+// with no Python frame attached. Every send() from then on, from another
+// request's handler or any other Python code, goes out as a chunk. close() ends
+// the response and frees the connection for its next request.
+//
+// Channels suit server-sent events and long polling. send() returning False
+// means the client is gone, or the channel was closed, so publishers can drop
+// their subscribers as they find out. A client which falls more than
+// max_pending bytes behind is disconnected rather than buffered for.
+struct Channel : PyObject {
+  static constexpr std::size_t max_pending {std::size_t {4} << 20};
+
+  static bool check(PyObject* obj);
+
+  // Owned by the server while a connection is parked on the channel
+  struct State {
+    std::string pending;  // Sent but not yet written
+    std::string sending;  // Being written
+    std::string early;    // Received from the client while parked
+    std::optional<asio::steady_timer> timer;
+    std::thread::id loop; // Thread the timer belongs to
+    bool claimed {false};
+    bool closed {false};
+    bool hung_up {false};
+    bool wake_posted {false};
+  };
+
+  State* state;
+
+  // Binds the channel to a response. False if another response has it.
+  bool claim();
+
+  // The client went away, pending data is dropped
+  void hang_up();
+
+  // Resumes the parked connection, if there is one, from any thread
+  void wake();
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* ChannelType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(Channel* self);
+
+  static PyObject* send(Channel* self, PyObject* data);
+  static PyObject* close(Channel* self, PyObject*);
+  static PyObject* get_closed(Channel* self, void*);
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_CHANNEL_HPP
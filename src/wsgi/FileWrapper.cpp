@@ -0,0 +1,106 @@
+#include "FileWrapper.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include <Python.h>
+
+#include "plat/plat.hpp"
+#include "util/Constants.hpp"
+
+namespace velocem {
+
+bool FileWrapper::check(PyObject* obj) {
+  return Py_IS_TYPE(obj, &gVT.FileWrapperType);
+}
+
+bool FileWrapper::file_span(int* fd, std::uint64_t* off, std::uint64_t* len) {
+  int desc {PyObject_AsFileDescriptor(filelike_)};
+  if(desc < 0) {
+    PyErr_Clear();
+    return false;
+  }
+
+  std::int64_t size {file_size(desc)};
+  if(size < 0)
+    return false;
+
+  // Start wherever the app left the file, which accounts for any read-ahead
+  // buffered on the Python side
+  std::int64_t pos {0};
+  if(PyObject* tell {PyObject_CallMethod(filelike_, "tell", nullptr)}) {
+    pos = PyLong_AsLongLong(tell);
+    Py_DECREF(tell);
+  }
+  if(PyErr_Occurred() || pos < 0 || pos > size) {
+    PyErr_Clear();
+    return false;
+  }
+
+  *fd = desc;
+  *off = pos;
+  *len = size - pos;
+  return true;
+}
+
+PyObject* FileWrapper::new_(PyTypeObject* type, PyObject* args,
+    PyObject* kwds) {
+  static const char* kwlist[] {"filelike", "blksize", nullptr};
+  PyObject* filelike;
+  Py_ssize_t blksize {8192};
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|n:file_wrapper",
+         const_cast<char**>(kwlist), &filelike, &blksize))
+    return nullptr;
+
+  auto self {reinterpret_cast<FileWrapper*>(type->tp_alloc(type, 0))};
+  if(!self)
+    return nullptr;
+  self->filelike_ = Py_NewRef(filelike);
+  self->blksize_ = blksize > 0 ? blksize : 8192;
+  return self;
+}
+
+void FileWrapper::dealloc(FileWrapper* self) {
+  Py_XDECREF(self->filelike_);
+  Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* FileWrapper::iternext(FileWrapper* self) {
+  PyObject* block {
+      PyObject_CallMethod(self->filelike_, "read", "n", self->blksize_)};
+  if(!block)
+    return nullptr;
+  // An empty read is end of file, a failed len() propagates
+  if(PyObject_Size(block) <= 0) {
+    Py_DECREF(block);
+    return nullptr;
+  }
+  return block;
+}
+
+PyObject* FileWrapper::close(FileWrapper* self, PyObject*) {
+  if(!PyObject_HasAttr(self->filelike_, gPO.close))
+    Py_RETURN_NONE;
+  return PyObject_CallMethodNoArgs(self->filelike_, gPO.close);
+}
+
+void FileWrapper::init_type(PyTypeObject* FileWrapperType) {
+  static std::array<PyMethodDef, 2> meths {
+      PyMethodDef {"close", (PyCFunction) close, METH_NOARGS},
+      {nullptr, nullptr},
+  };
+
+  *FileWrapperType = PyTypeObject {
+      .tp_name = "VelocemFileWrapper",
+      .tp_basicsize = sizeof(FileWrapper),
+      .tp_dealloc = (destructor) dealloc,
+      .tp_flags = Py_TPFLAGS_DEFAULT,
+      .tp_iter = PyObject_SelfIter,
+      .tp_iternext = (iternextfunc) iternext,
+      .tp_methods = meths.data(),
+      .tp_new = new_,
+  };
+  PyType_Ready(FileWrapperType);
+}
+
+} // namespace velocem
@@ -0,0 +1,36 @@
+#ifndef VELOCEM_WSGI_FILEWRAPPER_HPP
+#define VELOCEM_WSGI_FILEWRAPPER_HPP
+
+#include <cstdint>
+
+#include <Python.h>
+
+namespace velocem {
+
+// wsgi.file_wrapper. Iterating it reads blocks from the wrapped file-like
+// object, but when that object is backed by a regular file the server skips
+// the iteration entirely and reads the descriptor itself.
+struct FileWrapper : PyObject {
+  static bool check(PyObject* obj);
+
+  // Descriptor, starting offset and remaining length of the wrapped file.
+  // Returns false if it isn't a regular file the platform can read by
+  // descriptor.
+  bool file_span(int* fd, std::uint64_t* off, std::uint64_t* len);
+
+private:
+  friend void init_gVT(PyObject* mod);
+  static void init_type(PyTypeObject* FileWrapperType);
+
+  static PyObject* new_(PyTypeObject* type, PyObject* args, PyObject* kwds);
+  static void dealloc(FileWrapper* self);
+  static PyObject* iternext(FileWrapper* self);
+  static PyObject* close(FileWrapper* self, PyObject*);
+
+  PyObject* filelike_;
+  Py_ssize_t blksize_;
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_FILEWRAPPER_HPP
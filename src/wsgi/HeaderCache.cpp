@@ -0,0 +1,166 @@
+#include "HeaderCache.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+#include <Python.h>
+
+#ifdef _MSC_VER
+#include <string.h>
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+#include "util/Hash.hpp"
+
+namespace velocem {
+
+namespace {
+
+// Apps with more distinct header blocks than this are churning through
+// per-request values (cookies, request ids), don't bother remembering them
+constexpr std::size_t max_entries {64};
+constexpr std::size_t max_block {4096};
+
+constexpr std::array<std::string_view, 22> status_lines {
+    "HTTP/1.1 200 OK\r\n",
+    "HTTP/1.1 201 Created\r\n",
+    "HTTP/1.1 202 Accepted\r\n",
+    "HTTP/1.1 204 No Content\r\n",
+    "HTTP/1.1 206 Partial Content\r\n",
+    "HTTP/1.1 301 Moved Permanently\r\n",
+    "HTTP/1.1 302 Found\r\n",
+    "HTTP/1.1 303 See Other\r\n",
+    "HTTP/1.1 304 Not Modified\r\n",
+    "HTTP/1.1 307 Temporary Redirect\r\n",
+    "HTTP/1.1 308 Permanent Redirect\r\n",
+    "HTTP/1.1 400 Bad Request\r\n",
+    "HTTP/1.1 401 Unauthorized\r\n",
+    "HTTP/1.1 403 Forbidden\r\n",
+    "HTTP/1.1 404 Not Found\r\n",
+    "HTTP/1.1 405 Method Not Allowed\r\n",
+    "HTTP/1.1 409 Conflict\r\n",
+    "HTTP/1.1 422 Unprocessable Content\r\n",
+    "HTTP/1.1 429 Too Many Requests\r\n",
+    "HTTP/1.1 500 Internal Server Error\r\n",
+    "HTTP/1.1 502 Bad Gateway\r\n",
+    "HTTP/1.1 503 Service Unavailable\r\n",
+};
+
+constexpr std::size_t line_overhead {sizeof("HTTP/1.1 \r\n") - 1};
+
+} // namespace
+
+std::string_view common_status_line(std::string_view status) {
+  for(auto line : status_lines)
+    if(line.size() == status.size() + line_overhead &&
+        line.substr(9, status.size()) == status)
+      return line;
+  return {};
+}
+
+std::string_view common_status_line(int code) {
+  for(auto line : status_lines)
+    if((line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0') == code)
+      return line;
+  return {};
+}
+
+bool HeaderCache::add_piece(PyObject* str) {
+  if(!PyUnicode_Check(str) || PyUnicode_KIND(str) != PyUnicode_1BYTE_KIND)
+    [[unlikely]]
+    return false;
+
+  std::string_view piece {static_cast<const char*>(PyUnicode_DATA(str)),
+      static_cast<std::size_t>(PyUnicode_GET_LENGTH(str))};
+  hash_ = hash_bytes(piece.data(), piece.size(), hash_);
+  pieces_.push_back(piece);
+  return true;
+}
+
+const HeaderCache::Entry* HeaderCache::find(PyObject* status,
+    PyObject* headers) {
+  pieces_.clear();
+  conlen_.reset();
+  hash_ = 0;
+  cacheable_ = false;
+
+  if(!add_piece(status) || !PyList_CheckExact(headers)) [[unlikely]]
+    return nullptr;
+
+  for(Py_ssize_t i {0}, end {PyList_GET_SIZE(headers)}; i < end; ++i) {
+    PyObject* tuple {PyList_GET_ITEM(headers, i)};
+    if(!PyTuple_CheckExact(tuple) || PyTuple_GET_SIZE(tuple) != 2)
+      [[unlikely]]
+      return nullptr;
+
+    PyObject* field {PyTuple_GET_ITEM(tuple, 0)};
+    PyObject* value {PyTuple_GET_ITEM(tuple, 1)};
+    if(!add_piece(field)) [[unlikely]]
+      return nullptr;
+
+    auto name {pieces_.back()};
+    if(!conlen_ && name.size() == 14 &&
+        !strncasecmp("Content-Length", name.data(), 14)) {
+      if(!PyUnicode_Check(value) ||
+          PyUnicode_KIND(value) != PyUnicode_1BYTE_KIND) [[unlikely]]
+        return nullptr;
+      conlen_.emplace(static_cast<const char*>(PyUnicode_DATA(value)),
+          PyUnicode_GET_LENGTH(value));
+      pieces_.emplace_back();
+      continue;
+    }
+
+    if(!add_piece(value)) [[unlikely]]
+      return nullptr;
+  }
+
+  cacheable_ = true;
+  auto it {entries_.find(hash_)};
+  if(it == entries_.end() || !matches(it->second.key))
+    return nullptr;
+  return &it->second;
+}
+
+bool HeaderCache::matches(const std::string& key) const {
+  const char* k {key.data()};
+  const char* end {k + key.size()};
+  for(auto piece : pieces_) {
+    std::uint32_t len;
+    if(static_cast<std::size_t>(end - k) < sizeof(len) + piece.size())
+      return false;
+    std::memcpy(&len, k, sizeof(len));
+    k += sizeof(len);
+    if(len != piece.size() || std::memcmp(k, piece.data(), len))
+      return false;
+    k += len;
+  }
+  return k == end;
+}
+
+void HeaderCache::insert(std::string_view block, std::size_t status_len) {
+  if(!cacheable_ || block.size() > max_block)
+    return;
+
+  std::string key;
+  for(auto piece : pieces_) {
+    if(piece.size() > std::numeric_limits<std::uint32_t>::max())
+      return;
+    auto len {static_cast<std::uint32_t>(piece.size())};
+    key.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    key.append(piece);
+  }
+
+  if(entries_.size() >= max_entries)
+    entries_.clear();
+
+  entries_.insert_or_assign(hash_,
+      Entry {std::move(key), std::string {block}, status_len});
+}
+
+} // namespace velocem
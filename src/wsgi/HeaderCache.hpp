@@ -0,0 +1,61 @@
+#ifndef VELOCEM_WSGI_HEADERCACHE_HPP
+#define VELOCEM_WSGI_HEADERCACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <Python.h>
+
+namespace velocem {
+
+// Returns the serialized "HTTP/1.1 <status>\r\n" line for common statuses,
+// or an empty view if the status isn't one we know
+std::string_view common_status_line(std::string_view status);
+std::string_view common_status_line(int code);
+
+// Memoizes serialized status lines and header blocks. Apps overwhelmingly
+// return the same status and header list for every request to a given
+// endpoint, so the validated and serialized result is keyed on a hash of their
+// contents and verified piece by piece on a hit.
+//
+// Content-Length is the one header expected to vary, its value is left out of
+// the key and out of the cached block.
+struct HeaderCache {
+  struct Entry {
+    std::string key;
+    std::string block; // Status line followed by the app's headers
+    std::size_t status_len;
+  };
+
+  // Walks the status and headers computing their key, returns nullptr on a
+  // miss. Anything unusual about the input is left to the slow path, which
+  // reports errors.
+  const Entry* find(PyObject* status, PyObject* headers);
+
+  // Value of the Content-Length header seen by the last find()
+  std::optional<std::string_view> conlen() const {
+    return conlen_;
+  }
+
+  // Stores the slow path's result under the key from the last find()
+  void insert(std::string_view block, std::size_t status_len);
+
+private:
+  bool add_piece(PyObject* str);
+  bool matches(const std::string& key) const;
+
+  std::unordered_map<std::uint64_t, Entry> entries_;
+  std::vector<std::string_view> pieces_;
+  std::uint64_t hash_ {0};
+  bool cacheable_ {false};
+  std::optional<std::string_view> conlen_;
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_HEADERCACHE_HPP
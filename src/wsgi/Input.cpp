@@ -2,8 +2,8 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <functional>
 
 #include <Python.h>
 
@@ -11,16 +11,19 @@
 #include <internal/pycore_modsupport.h>
 
 #include "util/Constants.hpp"
+#include "util/Json.hpp"
+
+#include "Request.hpp"
 
 namespace velocem {
 
-WSGIInput::WSGIInput(std::function<void(WSGIInput*)> f_dealloc)
-    : f_dealloc_ {f_dealloc} {
+WSGIInput::WSGIInput(WSGIRequest* owner) : owner_ {owner} {
   ob_refcnt = 0;
   ob_type = &gVT.WSGIInputType;
 }
 
 void WSGIInput::set_body(char* begin, std::size_t len) {
+  begin_ = begin;
   it_ = begin;
   end_ = begin + len;
 }
@@ -29,22 +32,66 @@ void WSGIInput::extend_body(std::size_t len) {
   end_ += len;
 }
 
+void WSGIInput::set_bytes(PyObject* bytes) {
+  bytes_ = bytes;
+  begin_ = PyBytes_AS_STRING(bytes);
+  it_ = begin_;
+  end_ = begin_;
+}
+
+char* WSGIInput::body_begin() {
+  return begin_;
+}
+
+char* WSGIInput::body_end() {
+  return end_;
+}
+
+void WSGIInput::rebase(const char* old, std::size_t len, char* now) {
+  auto base {reinterpret_cast<std::uintptr_t>(old)};
+  auto begin {reinterpret_cast<std::uintptr_t>(begin_)};
+  if(!begin_ || begin < base || begin > base + len)
+    return;
+
+  char* nbegin {now + (begin - base)};
+  it_ = nbegin + (it_ - begin_);
+  end_ = nbegin + (end_ - begin_);
+  begin_ = nbegin;
+}
+
 void WSGIInput::reset() {
+  bytes_ = nullptr;
+  begin_ = nullptr;
   it_ = nullptr;
   end_ = nullptr;
 }
 
+PyObject* WSGIInput::parse_json() {
+  PyObject* obj {json_load(it_, end_ - it_)};
+  if(obj)
+    it_ = end_;
+  return obj;
+}
+
 void WSGIInput::init_type(PyTypeObject* WSGIInputType) {
-  static std::array<PyMethodDef, 4> meths {
+  static std::array<PyMethodDef, 7> meths {
       PyMethodDef {"read", (PyCFunction) read, METH_FASTCALL},
       {"readline", (PyCFunction) readline, METH_FASTCALL},
       {"readlines", (PyCFunction) readlines, METH_FASTCALL},
+      {"readinto", (PyCFunction) readinto, METH_O},
+      {"getbuffer", (PyCFunction) getbuffer, METH_NOARGS},
+      {"json", (PyCFunction) json, METH_NOARGS},
       {nullptr, nullptr},
   };
 
+  static PyBufferProcs bufprocs {
+      .bf_getbuffer = (getbufferproc) getbuffer_proc,
+  };
+
   *WSGIInputType = PyTypeObject {
       .tp_name = "VelocemWSGIInput",
       .tp_dealloc = (destructor) dealloc,
+      .tp_as_buffer = &bufprocs,
       .tp_iter = PyObject_SelfIter,
       .tp_iternext = (iternextfunc) iternext,
       .tp_methods = meths.data(),
@@ -52,9 +99,10 @@ void WSGIInput::init_type(PyTypeObject* WSGIInputType) {
   PyType_Ready(WSGIInputType);
 }
 
+// The body stays in place, other views of the request may still read it. The
+// request resets its input when it's released.
 void WSGIInput::dealloc(WSGIInput* self) {
-  self->reset();
-  self->f_dealloc_(self);
+  self->owner_->release();
 }
 
 PyObject* WSGIInput::read(WSGIInput* self, PyObject* const* args,
@@ -64,13 +112,20 @@ PyObject* WSGIInput::read(WSGIInput* self, PyObject* const* args,
     return nullptr;
 
   if(self->it_ == self->end_)
-    return gPO.empty_bytes;
+    return Py_NewRef(gPO.empty_bytes);
 
   Py_ssize_t len = self->end_ - self->it_;
 
   if(size >= 0 && size < len)
     len = size;
 
+  // The whole body was received into a bytes object, hand it out as-is
+  if(self->bytes_ && self->it_ == self->begin_ &&
+      len == PyBytes_GET_SIZE(self->bytes_)) {
+    self->it_ = self->end_;
+    return Py_NewRef(self->bytes_);
+  }
+
   auto ret = PyBytes_FromStringAndSize(self->it_, len);
   self->it_ += len;
   return ret;
@@ -99,7 +154,7 @@ PyObject* WSGIInput::readline(WSGIInput* self, PyObject* const* args,
     return nullptr;
 
   if(self->it_ == self->end_)
-    return gPO.empty_bytes;
+    return Py_NewRef(gPO.empty_bytes);
 
   Py_ssize_t len = self->end_ - self->it_;
   const char* cur = self->it_;
@@ -137,4 +192,38 @@ PyObject* WSGIInput::readlines(WSGIInput* self, PyObject* const* args,
   return list;
 }
 
+PyObject* WSGIInput::readinto(WSGIInput* self, PyObject* buffer) {
+  Py_buffer view;
+  if(PyObject_GetBuffer(buffer, &view, PyBUF_WRITABLE) == -1)
+    return nullptr;
+
+  Py_ssize_t len = self->end_ - self->it_;
+  if(view.len < len)
+    len = view.len;
+
+  if(len) {
+    std::memcpy(view.buf, self->it_, len);
+    self->it_ += len;
+  }
+
+  PyBuffer_Release(&view);
+  return PyLong_FromSsize_t(len);
+}
+
+PyObject* WSGIInput::getbuffer(WSGIInput* self, PyObject*) {
+  // The memoryview holds a reference to us, and so the whole request
+  return PyMemoryView_FromObject(self);
+}
+
+PyObject* WSGIInput::json(WSGIInput* self, PyObject*) {
+  return self->parse_json();
+}
+
+int WSGIInput::getbuffer_proc(WSGIInput* self, Py_buffer* view, int flags) {
+  static char empty[] {""};
+  char* base {self->begin_ ? self->begin_ : empty};
+  return PyBuffer_FillInfo(view, self, base, self->end_ - self->begin_, 1,
+      flags);
+}
+
 } // namespace velocem
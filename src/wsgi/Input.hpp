@@ -2,22 +2,33 @@
 #define VELOCEM_WSGI_INPUT_HPP
 
 #include <cstddef>
-#include <functional>
-#include <string_view>
 
 #include <Python.h>
 
+namespace velocem {
+struct WSGIRequest;
+}
+
 namespace velocem {
 
 struct WSGIInput : PyObject {
-  WSGIInput(std::function<void(WSGIInput*)> f_dealloc);
-  WSGIInput(std::function<void(WSGIInput*)> f_dealloc, std::string_view body);
+  WSGIInput(WSGIRequest* owner);
 
   void set_body(char* begin, std::size_t len);
   void extend_body(std::size_t len);
 
+  // Body received directly into a presized bytes object, owned by the request
+  void set_bytes(PyObject* bytes);
+
+  char* body_begin();
+  char* body_end();
+  void rebase(const char* old, std::size_t len, char* now);
+
   void reset();
 
+  // Parses the unread part of the body as JSON in place, consuming it
+  PyObject* parse_json();
+
 private:
   friend void init_gVT(PyObject* mod);
   static void init_type(PyTypeObject* WSGIINputType);
@@ -35,7 +46,17 @@ private:
   static PyObject* readlines(WSGIInput* self, PyObject* const* args,
       Py_ssize_t nargs);
 
-  std::function<void(WSGIInput*)> f_dealloc_;
+  static PyObject* readinto(WSGIInput* self, PyObject* buffer);
+
+  static PyObject* getbuffer(WSGIInput* self, PyObject*);
+
+  static PyObject* json(WSGIInput* self, PyObject*);
+
+  static int getbuffer_proc(WSGIInput* self, Py_buffer* view, int flags);
+
+  WSGIRequest* owner_;
+  PyObject* bytes_ {nullptr};
+  char* begin_ {nullptr};
   char* it_ {nullptr};
   char* end_ {nullptr};
 };
@@ -0,0 +1,251 @@
+#include "MicroCache.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <string.h>
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+#include "util/Constants.hpp"
+#include "util/Hash.hpp"
+
+#include "App.hpp"
+#include "Request.hpp"
+
+namespace velocem {
+
+namespace {
+
+// A single response may not take more than this fraction of the cache
+constexpr std::size_t max_share {8};
+constexpr std::size_t max_vary {8};
+
+// Bookkeeping charged to every entry on top of its strings
+constexpr std::size_t entry_overhead {128};
+
+constexpr std::string_view uncacheable_headers[] {
+    "HTTP_CONTENT_LENGTH",
+    "HTTP_TRANSFER_ENCODING",
+    "HTTP_IF_NONE_MATCH",
+    "HTTP_IF_MODIFIED_SINCE",
+    "HTTP_RANGE",
+    "HTTP_IF_RANGE",
+};
+
+std::string_view trim(std::string_view str) {
+  std::size_t first {str.find_first_not_of(" \t")};
+  if(first == str.npos)
+    return {};
+  return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && !strncasecmp(a.data(), b.data(), a.size());
+}
+
+std::string_view request_header(WSGIRequest* req, std::string_view name) {
+  for(auto& hdr : req->headers_)
+    if(hdr.field.view() == name)
+      return hdr.value.view();
+  return {};
+}
+
+// Vary names header fields, the request stores them in environ form
+std::string environ_name(std::string_view field) {
+  std::string name {"HTTP_"};
+  for(char c : field) {
+    if(c == '-')
+      c = '_';
+    else if(c >= 'a' && c <= 'z')
+      c &= 0xDF;
+    name += c;
+  }
+  return name;
+}
+
+// Seconds from s-maxage, 0 if the response isn't for shared caches
+long shared_max_age(std::string_view cc) {
+  long ttl {0};
+  while(!cc.empty()) {
+    std::size_t comma {cc.find(',')};
+    std::string_view dir {trim(cc.substr(0, comma))};
+    cc.remove_prefix(comma == cc.npos ? cc.size() : comma + 1);
+
+    if(iequals(dir, "no-store") || iequals(dir, "private") ||
+        iequals(dir, "no-cache"))
+      return 0;
+
+    if(dir.size() > 9 && iequals(dir.substr(0, 9), "s-maxage=")) {
+      auto end {dir.data() + dir.size()};
+      auto fc {std::from_chars(dir.data() + 9, end, ttl)};
+      if(fc.ec != std::errc {} || fc.ptr != end)
+        return 0;
+    }
+  }
+  return ttl;
+}
+
+} // namespace
+
+bool MicroCache::cacheable(WSGIRequest* req, int meth) {
+  if(meth != static_cast<int>(HTTPMethod::Get))
+    return false;
+  for(auto& hdr : req->headers_)
+    for(std::string_view name : uncacheable_headers)
+      if(hdr.field.view() == name)
+        return false;
+  return true;
+}
+
+void MicroCache::make_primary(WSGIRequest* req, int meth, bool keepalive) {
+  key_.clear();
+  key_ += static_cast<char>(meth);
+  key_ += keepalive ? 'k' : 'c';
+  if(by_host_)
+    key_ += request_header(req, "HTTP_HOST");
+  key_ += req->url().view();
+  if(req->has_query()) {
+    key_ += '?';
+    key_ += req->query().view();
+  }
+}
+
+const std::string* MicroCache::find(WSGIRequest* req, int meth,
+    bool keepalive) {
+  make_primary(req, meth, keepalive);
+  auto slot {index_.find(std::string_view {key_})};
+  if(slot == index_.end())
+    return nullptr;
+
+  auto& variants {slot->second};
+  for(std::size_t i {0}; i < variants.size(); ++i) {
+    Entry& entry {*variants[i]};
+
+    bool match {true};
+    for(std::size_t j {0}; match && j < entry.vary.size(); ++j)
+      match = request_header(req, entry.vary[j]) == entry.values[j];
+    if(!match)
+      continue;
+
+    if(entry.expires <= clock::now()) {
+      erase(slot, i);
+      return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, variants[i]);
+    return &entry.response;
+  }
+  return nullptr;
+}
+
+void MicroCache::store(WSGIRequest* req, int meth, bool keepalive,
+    const WSGIAppRet& ret) {
+  if(ret.iter || !ret.segs.empty())
+    return;
+
+  std::string_view out {ret.buf.data(), ret.buf.size()};
+  if(!out.starts_with("HTTP/1.1 200 "))
+    return;
+
+  std::size_t status_end {out.find("\r\n") + 2};
+  std::size_t hdr_end {out.find("\r\n\r\n")};
+  if(hdr_end == out.npos) [[unlikely]]
+    return;
+
+  long ttl {0};
+  std::vector<std::string> vary;
+  for(std::string_view hdrs {out.substr(status_end, hdr_end + 2 - status_end)};
+      !hdrs.empty();) {
+    std::size_t eol {hdrs.find("\r\n")};
+    std::string_view line {hdrs.substr(0, eol)};
+    hdrs.remove_prefix(eol + 2);
+
+    std::size_t colon {line.find(':')};
+    std::string_view name {line.substr(0, colon)};
+    std::string_view value {trim(line.substr(colon + 1))};
+
+    if(iequals(name, "cache-control")) {
+      ttl = shared_max_age(value);
+      if(!ttl)
+        return;
+    } else if(iequals(name, "vary")) {
+      while(!value.empty()) {
+        std::size_t comma {value.find(',')};
+        std::string_view field {trim(value.substr(0, comma))};
+        value.remove_prefix(comma == value.npos ? value.size() : comma + 1);
+        if(field == "*" || vary.size() == max_vary)
+          return;
+        if(!field.empty())
+          vary.push_back(environ_name(field));
+      }
+    }
+  }
+
+  std::size_t size {out.size() + ret.body.size()};
+  if(ttl <= 0 || size > capacity_ / max_share)
+    return;
+
+  Entry entry {
+      .vary = std::move(vary),
+      .expires = clock::now() + std::chrono::seconds {ttl},
+  };
+  make_primary(req, meth, keepalive);
+  entry.primary = key_;
+  entry.cost = entry_overhead + key_.size() + size;
+  for(const std::string& name : entry.vary) {
+    entry.values.emplace_back(request_header(req, name));
+    entry.cost += name.size() + entry.values.back().size();
+  }
+  entry.response.reserve(size);
+  entry.response.append(out);
+  entry.response.append(ret.body.data(), ret.body.size());
+
+  auto slot {index_.find(std::string_view {key_})};
+  if(slot == index_.end())
+    slot = index_.try_emplace(key_).first;
+
+  // Replaces the variant this request would have hit
+  auto& variants {slot->second};
+  for(std::size_t i {0}; i < variants.size(); ++i) {
+    if(variants[i]->vary == entry.vary && variants[i]->values == entry.values) {
+      used_ -= variants[i]->cost;
+      lru_.erase(variants[i]);
+      variants.erase(variants.begin() + i);
+      break;
+    }
+  }
+
+  used_ += entry.cost;
+  lru_.push_front(std::move(entry));
+  variants.push_back(lru_.begin());
+
+  while(used_ > capacity_) {
+    auto victim {std::prev(lru_.end())};
+    auto vslot {index_.find(std::string_view {victim->primary})};
+    auto& vs {vslot->second};
+    erase(vslot, std::find(vs.begin(), vs.end(), victim) - vs.begin());
+  }
+}
+
+void MicroCache::erase(Index::iterator slot, std::size_t variant) {
+  auto& variants {slot->second};
+  used_ -= variants[variant]->cost;
+  lru_.erase(variants[variant]);
+  variants.erase(variants.begin() + variant);
+  if(variants.empty())
+    index_.erase(slot);
+}
+
+} // namespace velocem
@@ -0,0 +1,82 @@
+#ifndef VELOCEM_WSGI_MICROCACHE_HPP
+#define VELOCEM_WSGI_MICROCACHE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "util/Hash.hpp"
+
+namespace velocem {
+struct WSGIAppRet;
+struct WSGIRequest;
+} // namespace velocem
+
+namespace velocem {
+
+// Short-lived cache of complete serialized responses. A GET whose response
+// carries Cache-Control: s-maxage=N is stored for N seconds, keyed on the
+// method, path, query string, connection persistence and the request values
+// of every header named by the response's Vary. Hits are answered without
+// calling into the app at all.
+//
+// The server runs a single thread and a miss runs the app to completion before
+// anything else is served, so concurrent misses on one key can't stampede the
+// app, the first one fills the entry for the rest.
+struct MicroCache {
+  explicit MicroCache(std::size_t capacity) : capacity_ {capacity} {}
+
+  // Requests with a body or conditional and Range headers always go to the
+  // app, the cache doesn't evaluate them
+  static bool cacheable(WSGIRequest* req, int meth);
+
+  // The stored response for this request, valid until the next store()
+  const std::string* find(WSGIRequest* req, int meth, bool keepalive);
+
+  // Stores a finished response if its headers allow. The request must still
+  // be alive for its header values.
+  void store(WSGIRequest* req, int meth, bool keepalive,
+      const WSGIAppRet& ret);
+
+  // Adds the Host header to every key, for when hosts are served by
+  // different apps
+  void key_on_host() {
+    by_host_ = true;
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct Entry {
+    std::string primary;
+    std::vector<std::string> vary;   // HTTP_ environ names
+    std::vector<std::string> values; // Request values of those headers
+    std::string response;
+    clock::time_point expires;
+    std::size_t cost;
+  };
+
+  using LRU = std::list<Entry>;
+
+  using Index = std::unordered_map<std::string, std::vector<LRU::iterator>,
+      StringHash, std::equal_to<>>;
+
+  void make_primary(WSGIRequest* req, int meth, bool keepalive);
+  void erase(Index::iterator slot, std::size_t variant);
+
+  LRU lru_; // Most recently used first
+  Index index_;
+  std::string key_;
+  std::size_t capacity_;
+  std::size_t used_ {0};
+  bool by_host_ {false};
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_MICROCACHE_HPP
@@ -0,0 +1,279 @@
+#include "Range.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "util/Hash.hpp"
+#include "util/OutputBuffer.hpp"
+
+#include "App.hpp"
+
+namespace velocem {
+
+namespace {
+
+constexpr std::size_t max_ranges {16};
+
+std::string_view trim(std::string_view str) {
+  std::size_t first {str.find_first_not_of(" \t")};
+  if(first == str.npos)
+    return {};
+  return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool parse_u64(std::string_view str, std::uint64_t& out) {
+  if(str.empty())
+    return false;
+  auto end {str.data() + str.size()};
+  auto fc {std::from_chars(str.data(), end, out)};
+  return fc.ec == std::errc {} && fc.ptr == end;
+}
+
+bool iequals(std::string_view a, std::string_view lower) {
+  if(a.size() != lower.size())
+    return false;
+  for(std::size_t i {0}; i < a.size(); ++i)
+    if((a[i] | 0x20) != lower[i])
+      return false;
+  return true;
+}
+
+void append_content_range(OutputBuffer& out, const ByteRange& r,
+    std::uint64_t size) {
+  out.append("Content-Range: bytes ");
+  out.append_dec(r.start);
+  out.append("-");
+  out.append_dec(r.start + r.len - 1);
+  out.append("/");
+  out.append_dec(size);
+  out.append("\r\n");
+}
+
+} // namespace
+
+RangeResult parse_range(std::string_view value, std::uint64_t size,
+    std::vector<ByteRange>& out) {
+  out.clear();
+  value = trim(value);
+  if(value.size() < 6 || !iequals(value.substr(0, 6), "bytes="))
+    return RangeResult::Ignore;
+  value.remove_prefix(6);
+
+  std::size_t specs {0};
+  while(!value.empty()) {
+    std::size_t comma {value.find(',')};
+    std::string_view spec {trim(value.substr(0, comma))};
+    value.remove_prefix(comma == value.npos ? value.size() : comma + 1);
+    if(spec.empty())
+      continue;
+
+    if(++specs > max_ranges)
+      return RangeResult::Ignore;
+
+    std::size_t dash {spec.find('-')};
+    if(dash == spec.npos)
+      return RangeResult::Ignore;
+
+    std::uint64_t first, last;
+    if(!dash) {
+      // Suffix range, the final N bytes
+      if(!parse_u64(spec.substr(1), last))
+        return RangeResult::Ignore;
+      if(last && size)
+        out.push_back({size - std::min(last, size), std::min(last, size)});
+      continue;
+    }
+
+    if(!parse_u64(spec.substr(0, dash), first))
+      return RangeResult::Ignore;
+
+    if(dash + 1 == spec.size()) {
+      last = size ? size - 1 : 0;
+    } else if(!parse_u64(spec.substr(dash + 1), last) || last < first) {
+      return RangeResult::Ignore;
+    }
+
+    if(first < size)
+      out.push_back({first, std::min(last, size - 1) - first + 1});
+  }
+
+  if(!specs)
+    return RangeResult::Ignore;
+  if(out.empty())
+    return RangeResult::Unsatisfiable;
+
+  // Ranges asking for more than the whole representation can only be
+  // overlapping, serving them would amplify the response (RFC 9110 14.2)
+  std::uint64_t total {0};
+  for(const ByteRange& r : out)
+    if((total += r.len) > size)
+      return RangeResult::Ignore;
+
+  std::sort(out.begin(), out.end(),
+      [](const ByteRange& a, const ByteRange& b) { return a.start < b.start; });
+
+  // Coalesce overlapping and adjacent ranges
+  std::size_t kept {0};
+  for(std::size_t i {1}; i < out.size(); ++i) {
+    ByteRange& prev {out[kept]};
+    if(out[i].start <= prev.start + prev.len)
+      prev.len = std::max(prev.len, out[i].start + out[i].len - prev.start);
+    else
+      out[++kept] = out[i];
+  }
+  out.resize(kept + 1);
+  return RangeResult::Satisfiable;
+}
+
+bool none_match_matches(std::string_view list, std::string_view etag) {
+  auto strip_weak {[](std::string_view tag) {
+    if(tag.starts_with("W/"))
+      tag.remove_prefix(2);
+    return tag;
+  }};
+  etag = strip_weak(etag);
+
+  while(!list.empty()) {
+    std::size_t comma {list.find(',')};
+    std::string_view tag {trim(list.substr(0, comma))};
+    list.remove_prefix(comma == list.npos ? list.size() : comma + 1);
+    if(!tag.empty() && (tag == "*" || strip_weak(tag) == etag))
+      return true;
+  }
+  return false;
+}
+
+bool if_range_matches(std::string_view value, std::string_view etag,
+    std::string_view last_modified) {
+  value = trim(value);
+  if(value.starts_with("W/"))
+    return false;
+  if(value.starts_with('"'))
+    return !etag.empty() && !etag.starts_with("W/") && value == etag;
+  return !last_modified.empty() && value == last_modified;
+}
+
+void apply_ranges(WSGIAppRet& ret, RangeResult result,
+    const std::vector<ByteRange>& ranges, std::uint64_t size,
+    std::size_t status_end, std::size_t hdr_end) {
+  std::string_view old {ret.buf.data(), ret.buf.size()};
+
+  // Content-Length is always the last header, it gets replaced
+  std::string_view hdrs {old.substr(status_end, hdr_end - 2 - status_end)};
+  hdrs = hdrs.substr(0, hdrs.rfind("Content-Length: "));
+
+  bool file {!ret.segs.empty()};
+  std::uint64_t file_off {file ? ret.segs.front().file_off : 0};
+  const char* mem {ret.body.empty() ? old.data() + hdr_end : ret.body.data()};
+
+  OutputBuffer out {ret.buf.headroom()};
+  std::vector<FileSegment> segs;
+  bool keep_view {false};
+
+  if(result == RangeResult::Unsatisfiable) {
+    out.append("HTTP/1.1 416 Range Not Satisfiable\r\n");
+    out.append(hdrs);
+    out.append("Content-Range: bytes */");
+    out.append_dec(size);
+    out.append("\r\nContent-Length: 0\r\n\r\n");
+  } else if(ranges.size() == 1) {
+    const ByteRange& r {ranges.front()};
+    out.append("HTTP/1.1 206 Partial Content\r\n");
+    out.append(hdrs);
+    append_content_range(out, r, size);
+    out.append("Content-Length: ");
+    out.append_dec(r.len);
+    out.append("\r\n\r\n");
+
+    if(file) {
+      segs.push_back({0, out.size(), file_off + r.start, r.len});
+    } else if(!ret.body.empty()) {
+      ret.body.slice(r.start, r.len);
+      keep_view = true;
+    } else {
+      out.append(mem + r.start, r.len);
+    }
+  } else {
+    // The representation's Content-Type moves into each part
+    std::string filtered;
+    std::string_view ctype;
+    for(std::string_view rest {hdrs}; !rest.empty();) {
+      std::size_t eol {rest.find("\r\n") + 2};
+      std::string_view line {rest.substr(0, eol)};
+      rest.remove_prefix(eol);
+      std::size_t colon {line.find(':')};
+      if(iequals(line.substr(0, colon), "content-type"))
+        ctype = trim(line.substr(colon + 1, line.size() - colon - 3));
+      else
+        filtered.append(line);
+    }
+
+    static std::uint64_t counter {0};
+    ++counter;
+    std::uint64_t h {hash_bytes(&counter, sizeof(counter))};
+    char boundary[24] {'v', 'e', 'l', 'o', 'c', 'e', 'm', '-'};
+    for(int i {23}; i >= 8; --i, h >>= 4)
+      boundary[i] = "0123456789abcdef"[h & 0xF];
+    std::string_view bnd {boundary, sizeof(boundary)};
+
+    std::vector<std::string> prefixes;
+    std::uint64_t total {0};
+    for(const ByteRange& r : ranges) {
+      OutputBuffer part;
+      if(!prefixes.empty())
+        part.append("\r\n");
+      part.append("--");
+      part.append(bnd);
+      part.append("\r\n");
+      if(!ctype.empty()) {
+        part.append("Content-Type: ");
+        part.append(ctype);
+        part.append("\r\n");
+      }
+      append_content_range(part, r, size);
+      part.append("\r\n");
+      prefixes.emplace_back(part.data(), part.size());
+      total += part.size() + r.len;
+    }
+    std::string trailer {"\r\n--"};
+    trailer.append(bnd).append("--\r\n");
+    total += trailer.size();
+
+    out.append("HTTP/1.1 206 Partial Content\r\n");
+    out.append(filtered);
+    out.append("Content-Type: multipart/byteranges; boundary=");
+    out.append(bnd);
+    out.append("\r\nContent-Length: ");
+    out.append_dec(total);
+    out.append("\r\n\r\n");
+
+    std::size_t sent {0};
+    for(std::size_t i {0}; i < ranges.size(); ++i) {
+      out.append(prefixes[i]);
+      if(file) {
+        segs.push_back({sent, out.size() - sent, file_off + ranges[i].start,
+            ranges[i].len});
+        sent = out.size();
+      } else {
+        out.append(mem + ranges[i].start, ranges[i].len);
+      }
+    }
+    out.append(trailer);
+    if(file)
+      segs.push_back({sent, out.size() - sent, 0, 0});
+  }
+
+  if(!keep_view)
+    ret.body.release();
+  ret.buf = std::move(out);
+  ret.segs = std::move(segs);
+}
+
+} // namespace velocem
@@ -0,0 +1,50 @@
+#ifndef VELOCEM_WSGI_RANGE_HPP
+#define VELOCEM_WSGI_RANGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace velocem {
+struct WSGIAppRet;
+}
+
+namespace velocem {
+
+struct ByteRange {
+  std::uint64_t start;
+  std::uint64_t len;
+};
+
+enum class RangeResult {
+  Ignore,        // Absent, malformed or unsupported, send the full response
+  Satisfiable,   // At least one range overlaps the representation
+  Unsatisfiable, // Send a 416
+};
+
+// Parses a Range header against a representation of size bytes. Satisfiable
+// ranges come out sorted with overlapping and adjacent ones merged. Requests
+// for more than a handful of ranges, or for more bytes in total than the
+// representation holds, are ignored rather than served piecemeal.
+RangeResult parse_range(std::string_view value, std::uint64_t size,
+    std::vector<ByteRange>& out);
+
+// If-None-Match uses weak comparison, W/ prefixes are ignored on both sides
+bool none_match_matches(std::string_view list, std::string_view etag);
+
+// If-Range holds either an entity-tag, which must strongly match, or an
+// HTTP-date, which must exactly match Last-Modified
+bool if_range_matches(std::string_view value, std::string_view etag,
+    std::string_view last_modified);
+
+// Rewrites a complete, serialized 200 into a 206 or 416. status_end and
+// hdr_end are the offsets just past the status line and the blank line ending
+// the headers. The body may live in ret.buf, ret.body or the file segments.
+void apply_ranges(WSGIAppRet& ret, RangeResult result,
+    const std::vector<ByteRange>& ranges, std::uint64_t size,
+    std::size_t status_end, std::size_t hdr_end);
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_RANGE_HPP
@@ -1,12 +1,12 @@
 #include "Request.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <functional>
 #include <limits>
-#include <optional>
-#include <string>
-#include <utility>
+#include <new>
+#include <ranges>
 #include <vector>
 
 #include <Python.h>
@@ -41,7 +41,7 @@ std::size_t unquote_url_inplace(char* url, size_t len) {
   char* max_percent = end - 2;
   char* in = url;
 
-  while(*in != '%' && in < end)
+  while(in < end && *in != '%')
     ++in;
 
   char* out = in;
@@ -52,8 +52,8 @@ std::size_t unquote_url_inplace(char* url, size_t len) {
       if(in >= max_percent) [[unlikely]]
         return std::numeric_limits<std::size_t>::max();
 
-      char a = tbl[static_cast<unsigned char>(url[1])];
-      char b = tbl[static_cast<unsigned char>(url[2])];
+      char a = tbl[static_cast<unsigned char>(in[1])];
+      char b = tbl[static_cast<unsigned char>(in[2])];
 
       if(a == -1 || b == -1) [[unlikely]]
         return std::numeric_limits<std::size_t>::max();
@@ -70,56 +70,91 @@ std::size_t unquote_url_inplace(char* url, size_t len) {
 
 namespace velocem {
 
-WSGIHeader::WSGIHeader(std::function<void(BalmStringView*)> f_free, char* base,
-    size_t len)
-    : bsv {f_free, base, len} {}
+namespace {
 
-WSGIHeader::WSGIHeader(const WSGIHeader& other)
-    : bsv {other.bsv}, buf {other.buf} {
-  bsv.from(buf.data(), buf.size());
-}
+constexpr std::size_t unowned {std::numeric_limits<std::size_t>::max()};
 
-WSGIHeader::WSGIHeader(WSGIHeader&& other)
-    : bsv {std::move(other.bsv)}, buf {std::move(other.buf)} {
-  bsv.from(buf.data(), buf.size());
-}
+// Content-Length is client controlled, don't take it at its word for anything
+// larger than this
+constexpr std::size_t body_prealloc_max {std::size_t {16} << 20};
 
-bool WSGIHeader::process() {
-  buf.resize(bsv._base.utf8_length + 5);
-  char* target = buf.data() + 5;
-  for(Py_ssize_t i = 0; i < bsv._base.utf8_length; ++i) {
-    // CVE-2015-0219
-    // https://www.djangoproject.com/weblog/2015/jan/13/security/
-    if(bsv._base.utf8[i] == '_') {
-      return false;
-    } else if(bsv._base.utf8[i] == '-') {
-      target[i] = '_';
-    } else {
-      target[i] = bsv._base.utf8[i] & 0xDF;
-    }
-  }
-  std::memcpy(buf.data(), "HTTP_", 5);
-  bsv.from(buf.data(), buf.size());
-  return true;
-}
+// Nor is any of it allocated before the bytes arrive, presized bodies start at
+// this and grow geometrically
+constexpr std::size_t body_prealloc_initial {std::size_t {256} << 10};
 
-WSGIRequest::WSGIRequest() {
-  headers_.reserve(32);
-  values_.reserve(32);
+// Spilled bodies are read through this much of the request buffer at a time
+constexpr std::size_t bounce_size {std::size_t {64} << 10};
+
+char empty_value[] {""};
+
+} // namespace
+
+ObjectPool<WSGIRequest> gRequestPool {"request"};
+
+std::size_t gBodySpill {body_prealloc_max};
+
+void BalmStringView::dealloc(PyObject* self) {
+  reinterpret_cast<BalmStringView*>(self)->owner_->release();
 }
 
-WSGIRequest::WSGIRequest(std::function<void(WSGIRequest*)> f_free)
-    : f_free_ {f_free} {
+WSGIHeader::WSGIHeader(WSGIRequest* owner, char* base, std::size_t len)
+    : field {owner, base, len}, value {owner, empty_value, 0} {}
+
+WSGIRequest::WSGIRequest() : ref_count_ {unowned} {
   headers_.reserve(32);
-  values_.reserve(32);
+  names_.reserve(1024);
 }
 
 void WSGIRequest::reset() {
-  ref_count_ = 2;
-  query_.reset();
+  ref_count_ = unowned;
+  has_query_ = false;
   headers_.clear();
-  values_.clear();
+  names_.clear();
   buf_.clear();
+  input_.reset();
+  native_.reset();
+  Py_CLEAR(body_);
+  body_len_ = 0;
+  if(spill_) {
+    spill_close(spill_);
+    spill_ = nullptr;
+    spill_len_ = 0;
+  }
+}
+
+std::size_t WSGIRequest::footprint() const {
+  return buf_.capacity() + names_.capacity() +
+      headers_.capacity() * sizeof(WSGIHeader);
+}
+
+void WSGIRequest::adopt_refs() {
+  auto live {[](PyObject* obj) { return Py_REFCNT(obj) > 0; }};
+
+  std::size_t count {0};
+  count += live(&input_);
+  count += live(&native_);
+  count += live((PyObject*) &url_);
+  count += live((PyObject*) &path_info_);
+  if(has_query_)
+    count += live((PyObject*) &query_);
+
+  for(auto& hdr : headers_) {
+    count += live((PyObject*) &hdr.field);
+    count += live((PyObject*) &hdr.value);
+  }
+
+  ref_count_ = count;
+}
+
+void WSGIRequest::release() {
+  if(!--ref_count_)
+    gRequestPool.push(this);
+}
+
+PyObject* WSGIRequest::share(PyObject* obj) {
+  if(!Py_REFCNT(obj))
+    ++ref_count_;
+  return Py_NewRef(obj);
 }
 
 BalmStringView& WSGIRequest::url() {
@@ -127,14 +162,12 @@ BalmStringView& WSGIRequest::url() {
 }
 
 bool WSGIRequest::has_query() {
-  return query_.has_value();
+  return has_query_;
 }
 
 BalmStringView& WSGIRequest::query() {
-  if(query_)
-    return *query_;
-  ref_count_++;
-  return query_.emplace([this](BalmStringView*) { f_free_(this); });
+  has_query_ = true;
+  return query_;
 }
 
 
@@ -145,70 +178,219 @@ int WSGIRequest::process_url() {
   if(len == std::numeric_limits<std::size_t>::max()) [[unlikely]]
     return -1;
 
+  // QUERY_STRING stays encoded, as CGI has it, decoding it here would make
+  // escaped '&' and '=' indistinguishable from separators
   url_.resize(len);
-  if(query_) {
-    len = unquote_url_inplace(query_->_base.utf8, query_->_base.utf8_length);
-
-    if(len == std::numeric_limits<std::size_t>::max()) [[unlikely]]
-      return -1;
-
-    query_->resize(len);
-  }
-
   return 0;
 }
 
 BalmStringView& WSGIRequest::next_header(char* base, size_t len) {
-  ++ref_count_;
-  return headers_
-      .emplace_back(
-          [this](BalmStringView*) {
-            if(!--ref_count_)
-              f_free_(this);
-          },
-          base, len)
-      .bsv;
+  return headers_.emplace_back(this, base, len).field;
 }
 
 BalmStringView& WSGIRequest::last_header() {
-  return headers_.back().bsv;
+  return headers_.back().field;
 }
 
 bool WSGIRequest::process_header() {
-  if(!headers_.back().process()) {
+  BalmStringView& field {headers_.back().field};
+  const char* src {field._base.utf8};
+  std::size_t len = field._base.utf8_length;
+
+  // CVE-2015-0219
+  // https://www.djangoproject.com/weblog/2015/jan/13/security/
+  if(std::memchr(src, '_', len)) {
     headers_.pop_back();
-    --ref_count_;
     return false;
   }
+
+  std::size_t off {names_.size()};
+  const char* old {names_.data()};
+  names_.resize(off + len + 5);
+  if(names_.data() != old) [[unlikely]]
+    rebase_names(old);
+
+  char* target {names_.data() + off};
+  std::memcpy(target, "HTTP_", 5);
+  for(std::size_t i {0}; i < len; ++i) {
+    char c {src[i]};
+    if(c == '-')
+      c = '_';
+    else if(c >= 'a' && c <= 'z')
+      c &= 0xDF;
+    target[i + 5] = c;
+  }
+  field.from(target, len + 5);
   return true;
 }
 
+void WSGIRequest::rebase_names(const char* old) {
+  // The last header still points into the request buffer
+  for(auto& hdr : headers_ | std::views::take(headers_.size() - 1)) {
+    std::size_t off = hdr.field._base.utf8 - old;
+    hdr.field.from(names_.data() + off, hdr.field._base.utf8_length);
+  }
+}
+
 BalmStringView& WSGIRequest::next_value(char* base, std::size_t len) {
-  ++ref_count_;
-  return values_.emplace_back(
-      [this](BalmStringView*) {
-        if(!--ref_count_)
-          f_free_(this);
-      },
-      base, len);
+  BalmStringView& value {headers_.back().value};
+  value.from(base, len);
+  return value;
 }
 
 BalmStringView& WSGIRequest::last_value() {
-  return values_.back();
+  return headers_.back().value;
+}
+
+void WSGIRequest::expect_body(std::size_t len) {
+  if(gBodySpill && len > gBodySpill && start_spill())
+    return;
+
+  if(len > body_prealloc_max)
+    return;
+
+  body_ = PyBytes_FromStringAndSize(nullptr,
+      std::min(len, body_prealloc_initial));
+  if(!body_) [[unlikely]] {
+    PyErr_Clear();
+    return;
+  }
+  body_len_ = len;
+  input_.set_bytes(body_);
+}
+
+bool WSGIRequest::grow_body(std::size_t need) {
+  char* begin {input_.body_begin()};
+  std::size_t have = input_.body_end() - begin;
+  std::size_t cap = PyBytes_GET_SIZE(body_);
+  if(have + need <= cap)
+    return true;
+
+  std::size_t grown {std::min(body_len_, std::max(cap * 2, have + need))};
+  if(grown < have + need) [[unlikely]]
+    return false;
+
+  // Nothing else has seen body_ yet, so it can be resized in place
+  if(_PyBytes_Resize(&body_, static_cast<Py_ssize_t>(grown))) [[unlikely]] {
+    PyErr_Clear();
+    input_.reset();
+    return false;
+  }
+  input_.set_bytes(body_);
+  input_.extend_body(have);
+  return true;
+}
+
+bool WSGIRequest::append_body(char* at, std::size_t len) {
+  if(spill_) {
+    spill_len_ += len;
+    return spill_write(spill_, at, len);
+  }
+
+  char* dst {input_.body_end()};
+  if(!dst) {
+    input_.set_body(at, len);
+    return true;
+  }
+
+  // Bodies of unknown length spill once they cross the threshold
+  std::size_t have = dst - input_.body_begin();
+  if(!body_ && gBodySpill && have + len > gBodySpill && start_spill()) {
+    spill_len_ = have + len;
+    bool ok {spill_write(spill_, input_.body_begin(), have) &&
+        spill_write(spill_, at, len)};
+    input_.reset();
+    return ok;
+  }
+
+  // Either copying out of the request buffer into body_, or closing the gap
+  // left by chunk framing. Reads straight into body_ are already in place.
+  if(at != dst) {
+    if(body_ && !grow_body(len)) [[unlikely]]
+      return false;
+    std::memmove(input_.body_end(), at, len);
+  }
+  input_.extend_body(len);
+  return true;
+}
+
+bool WSGIRequest::finish_body() {
+  if(!spill_ || !spill_len_)
+    return true;
+
+  char* map {spill_map(spill_, spill_len_)};
+  if(!map) [[unlikely]]
+    return false;
+  input_.set_body(map, spill_len_);
+  return true;
+}
+
+bool WSGIRequest::start_spill() {
+  spill_ = spill_open();
+  if(!spill_) [[unlikely]]
+    return false;
+
+  // Can't resize the buffer here, the parser is still walking it. The bounce
+  // region is set up by the next call to get_read_buf().
+  bounce_off_ = buf_.size();
+  return true;
 }
 
 asio::mutable_buffer WSGIRequest::get_read_buf(std::size_t offset,
     std::size_t minsize) {
+  if(body_) {
+    std::size_t have = input_.body_end() - input_.body_begin();
+    if(have < body_len_ && !grow_body(1)) [[unlikely]]
+      throw std::bad_alloc {};
+    char* end {PyBytes_AS_STRING(body_) + PyBytes_GET_SIZE(body_)};
+    char* dst {input_.body_end()};
+    return asio::buffer(dst, end - dst);
+  }
+
+  if(spill_) {
+    offset = bounce_off_;
+    minsize = bounce_size;
+  }
+
   std::size_t diff {buf_.size() - offset};
-  if(diff < minsize)
+  if(diff < minsize) {
+    const char* old {buf_.data()};
+    std::size_t len {buf_.size()};
     buf_.resize(buf_.size() + 2 * minsize);
+    if(old && buf_.data() != old)
+      rebase_buf(old, len);
+  }
 
   return asio::buffer(buf_.data() + offset, buf_.size() - offset);
 }
 
 asio::mutable_buffer WSGIRequest::get_parse_buf(std::size_t offset,
     std::size_t n) {
+  if(body_)
+    return asio::buffer(input_.body_end(), n);
+  if(spill_)
+    return asio::buffer(buf_.data() + bounce_off_, n);
   return asio::buffer(buf_.data() + offset, n);
 }
 
+void WSGIRequest::rebase_buf(const char* old, std::size_t len) {
+  auto base {reinterpret_cast<std::uintptr_t>(old)};
+  auto rebase {[&](BalmStringView& bsv) {
+    auto ptr {reinterpret_cast<std::uintptr_t>(bsv._base.utf8)};
+    if(ptr >= base && ptr <= base + len)
+      bsv.from(buf_.data() + (ptr - base), bsv._base.utf8_length);
+  }};
+
+  rebase(url_);
+  if(has_query_)
+    rebase(query_);
+
+  for(auto& hdr : headers_) {
+    rebase(hdr.field);
+    rebase(hdr.value);
+  }
+
+  input_.rebase(old, len, buf_.data());
+}
+
 } // namespace velocem
@@ -2,38 +2,45 @@
 #define VELOCEM_WSGI_REQUEST_HPP
 
 #include <cstdlib>
-#include <functional>
-#include <optional>
-#include <string>
 #include <vector>
 
 #include <asio/buffer.hpp>
 
+#include "http/Request.hpp"
+#include "plat/plat.hpp"
 #include "util/BalmStringView.hpp"
+#include "util/Pool.hpp"
 
 #include "Input.hpp"
 
 namespace velocem {
 
 struct WSGIHeader {
+  WSGIHeader(WSGIRequest* owner, char* base, std::size_t len);
 
-  WSGIHeader(std::function<void(BalmStringView*)> f_free, char* base = nullptr,
-      size_t len = 0);
-  WSGIHeader(const WSGIHeader& other);
-  WSGIHeader(WSGIHeader&& other);
-
-  BalmStringView bsv;
-  std::string buf;
-
-  bool process();
+  BalmStringView field;
+  BalmStringView value;
 };
 
 struct WSGIRequest {
 
   WSGIRequest();
-  WSGIRequest(std::function<void(WSGIRequest*)> f_free);
+
+  WSGIRequest(WSGIRequest&) = delete;
+  WSGIRequest(WSGIRequest&&) = delete;
 
   void reset();
+  std::size_t footprint() const;
+
+  // Every Python object handed out by the request shares this one refcount.
+  // Until adopt_refs() is called the request is owned by the server and
+  // releases are ignored.
+  void adopt_refs();
+  void release();
+
+  // New reference to one of the request's objects after adopt_refs(),
+  // counting it toward the request if nothing else holds it
+  PyObject* share(PyObject* obj);
 
   BalmStringView& url();
 
@@ -49,32 +56,55 @@ struct WSGIRequest {
   BalmStringView& next_value(char* base = nullptr, std::size_t len = 0);
   BalmStringView& last_value();
 
+  // Bodies with a known Content-Length are received directly into a presized
+  // bytes object which wsgi.input can hand out without copying. It starts out
+  // small and doubles as bytes arrive, up to the declared length. Otherwise the
+  // body is compacted in place in the request buffer. Bodies larger than
+  // gBodySpill are written out to a temporary file and mapped once complete.
+  void expect_body(std::size_t len);
+  bool append_body(char* at, std::size_t len);
+  bool finish_body();
+
   asio::mutable_buffer get_read_buf(std::size_t offset,
       std::size_t minsize = 1024);
   asio::mutable_buffer get_parse_buf(std::size_t offset, std::size_t n);
 
-  std::size_t ref_count_ {2};
+  std::size_t ref_count_;
 
-  std::function<void(WSGIRequest*)> f_free_ {
-      [this](WSGIRequest*) { delete this; }};
+  WSGIInput input_ {this};
+  HTTPRequest native_ {this};
+  BalmStringView url_ {this};
+  BalmStringView path_info_ {this}; // Tail of url_ under a mounted app
+  BalmStringView query_ {this};
+  bool has_query_ {false};
 
-  WSGIInput input_ {[this](WSGIInput*) {
-    if(!--ref_count_)
-      f_free_(this);
-  }};
+  // Header objects and the HTTP_ prefixed names they point to live in these
+  // two arenas, reused across requests
+  std::vector<WSGIHeader> headers_;
+  std::vector<char> names_;
 
-  BalmStringView url_ {[this](BalmStringView*) {
-    if(!--ref_count_)
-      f_free_(this);
-  }};
+  std::vector<char> buf_;
+  PyObject* body_ {nullptr};
+  std::size_t body_len_ {0}; // Declared length body_ grows towards
 
-  std::optional<BalmStringView> query_;
+  SpillFile* spill_ {nullptr};
+  std::size_t spill_len_ {0};
+  std::size_t bounce_off_ {0};
 
-  std::vector<WSGIHeader> headers_;
-  std::vector<BalmStringView> values_;
-  std::vector<char> buf_;
+private:
+  bool start_spill();
+  bool grow_body(std::size_t need);
+
+  void rebase_names(const char* old);
+  void rebase_buf(const char* old, std::size_t len);
 };
 
+extern ObjectPool<WSGIRequest> gRequestPool;
+
+// Request bodies larger than this many bytes are spilled to disk, 0 disables.
+// The writes block the server thread, see spill_write().
+extern std::size_t gBodySpill;
+
 } // namespace velocem
 
 #endif // VELOCEM_WSGI_REQUEST_HPP
@@ -1,13 +1,23 @@
 #include "Server.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <concepts>
 #include <csignal>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <format>
-#include <queue>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <Python.h>
 
@@ -17,12 +27,16 @@
 #include <asio.hpp>
 
 #include "HTTPParser.hpp"
+#include "http/App.hpp"
 #include "plat/plat.hpp"
+#include "plugin/Plugin.hpp"
 #include "Request.hpp"
 #include "util/Constants.hpp"
+#include "util/Gzip.hpp"
 #include "util/Util.hpp"
 
 #include "App.hpp"
+#include "Channel.hpp"
 
 using asio::awaitable;
 using asio::deferred;
@@ -34,48 +48,81 @@ namespace velocem {
 
 namespace {
 
+// Per-connection parser state, carved out of slabs and recycled through an
+// intrusive free list. An idle keep-alive connection holds only this and its
+// coroutine frame, requests are taken from the pool once the socket is
+// readable.
+struct alignas(64) Connection {
+  HTTPParser http;
+};
+
+constexpr std::size_t conn_slab_size {std::size_t {64} << 10};
+
 struct {
-  std::queue<WSGIRequest*> q;
-
-  WSGIRequest* pop() {
-    if(q.empty())
-      return new WSGIRequest {[&](WSGIRequest* self) {
-        self->reset();
-        q.push(self);
-      }};
-    auto ptr = q.front();
-    q.pop();
-    return ptr;
+  void* free {nullptr};
+
+  Connection* pop() {
+    if(!free)
+      grow();
+    void* slot {free};
+    free = *static_cast<void**>(slot);
+    return new(slot) Connection;
   }
 
-  void push(WSGIRequest* ptr) {
-    ptr->reset();
-    q.push(ptr);
+  void push(Connection* conn) {
+    conn->~Connection();
+    *reinterpret_cast<void**>(conn) = free;
+    free = conn;
+  }
+
+  void grow() {
+    auto slab {static_cast<char*>(alloc_slab(conn_slab_size, false))};
+    if(!slab)
+      throw std::bad_alloc {};
+    for(std::size_t i {0}; i + sizeof(Connection) <= conn_slab_size;
+        i += sizeof(Connection)) {
+      *reinterpret_cast<void**>(slab + i) = free;
+      free = slab + i;
+    }
   }
 
-} ReqQ;
+} ConnSlab;
 
 asio::awaitable<void> handle_iter(tcp::socket& s, WSGIAppRet& app) {
-  co_await s.async_send(asio::buffer(app.buf), deferred);
+  co_await asio::async_write(s, app.buf.buffer(), deferred);
 
+  PyBufferView chunk;
   for(PyObject* next; (next = PyIter_Next(app.iter));) {
     try {
-      app.buf.clear();
-
-      const char* base;
-      Py_ssize_t len;
-      unpack_pybytes(next, &base, &len,
-          "Body iterator must produce bytes objects");
-
-      if(len) [[likely]] {
-        insert_str(app.buf, std::format("{:x}\r\n", len));
-        insert_chars(app.buf, base, len);
-        insert_literal(app.buf, "\r\n");
-        co_await s.async_send(asio::buffer(app.buf), deferred);
+      chunk.acquire(next, "Body iterator must produce bytes-like objects");
+
+      // Compressed chunks are flushed individually so streams stay live,
+      // whatever deflate produced is framed using the headroom in front
+      if(app.gz) {
+        app.buf.clear();
+        gzip_append(app.gz, chunk.data(), chunk.size(), Z_SYNC_FLUSH, app.buf);
+        if(!app.buf.empty()) {
+          std::size_t len {app.buf.size()};
+          app.buf.prepend("\r\n");
+          app.buf.prepend_hex(len);
+          app.buf.append("\r\n");
+          co_await asio::async_write(s, app.buf.buffer(), deferred);
+        }
+      } else if(!chunk.empty()) [[likely]] {
+        // The chunk goes out straight from the app's buffer, only its framing
+        // is written into ours
+        app.buf.clear();
+        app.buf.append_hex(chunk.size());
+        app.buf.append("\r\n");
+        std::array bufs {app.buf.buffer(), chunk.buffer(),
+            buffer_literal("\r\n")};
+        co_await asio::async_write(s, bufs, deferred);
       }
 
+      chunk.release();
       Py_DECREF(next);
     } catch(...) {
+      chunk.release();
       close_iterator(app.iter);
       Py_DECREF(next);
       Py_DECREF(app.iter);
@@ -92,14 +139,202 @@ asio::awaitable<void> handle_iter(tcp::socket& s, WSGIAppRet& app) {
     throw std::runtime_error {"Python iterator error"};
   }
 
-  co_await s.async_send(buffer_literal("0\r\n\r\n"), deferred);
+  if(app.gz) {
+    app.buf.clear();
+    gzip_append(app.gz, nullptr, 0, Z_FINISH, app.buf);
+    std::size_t len {app.buf.size()};
+    app.buf.prepend("\r\n");
+    app.buf.prepend_hex(len);
+    app.buf.append("\r\n0\r\n\r\n");
+    co_await asio::async_write(s, app.buf.buffer(), deferred);
+    co_return;
+  }
+
+  co_await asio::async_write(s, buffer_literal("0\r\n\r\n"), deferred);
+}
+
+// Bytes a client may send while parked on a channel, a pipelined request,
+// before it's treated as misbehaving
+constexpr std::size_t max_channel_early {std::size_t {64} << 10};
+
+// Readable with nothing to read means the client hung up. Anything it did send
+// is held for after the channel ends and the watch is armed again. A wakeup
+// already queued when the channel finished may outlive the socket, so a closed
+// channel is never looked past.
+void watch_channel(tcp::socket& s, Channel* ch) {
+  Py_INCREF(ch);
+  s.async_wait(tcp::socket::wait_read, [ch, &s](const asio::error_code& ec) {
+    if(ec || !ch->state->timer || ch->state->closed) {
+      Py_DECREF(ch);
+      return;
+    }
+
+    std::string& early {ch->state->early};
+    asio::error_code rec;
+    std::size_t n {s.available(rec)};
+    bool open {!rec && n && early.size() + n <= max_channel_early};
+    if(open) {
+      std::size_t have {early.size()};
+      early.resize(have + n);
+      n = s.read_some(asio::buffer(early.data() + have, n), rec);
+      early.resize(have + n);
+      open = !rec;
+    }
+
+    if(open)
+      watch_channel(s, ch);
+    else
+      ch->hang_up();
+    Py_DECREF(ch);
+  });
 }
 
-asio::awaitable<void> client(tcp::socket s, WSGIApp& app) {
-  WSGIRequest* req {ReqQ.pop()};
+// The connection stays here until the channel is closed, waking whenever
+// something is sent, while watch_channel() looks out for the client hanging up
+asio::awaitable<void> handle_channel(tcp::socket& s, WSGIAppRet& app,
+    WSGIRequest*& next_req) {
+  auto ch {static_cast<Channel*>(app.iter)};
+  Channel::State& st {*ch->state};
+  st.timer.emplace(s.get_executor());
+  st.loop = std::this_thread::get_id();
+
+  // Marks the watcher finished before cancelling it, a completion which was
+  // already queued still runs and must find the channel closed
+  auto finish {[&] {
+    st.timer.reset();
+    st.closed = true;
+    asio::error_code ec;
+    s.cancel(ec);
+    st.sending.clear();
+    st.early.clear();
+    Py_DECREF(ch);
+  }};
+
+  try {
+    co_await asio::async_write(s, app.buf.buffer(), deferred);
+
+    watch_channel(s, ch);
+
+    for(;;) {
+      if(!st.pending.empty()) {
+        st.sending.swap(st.pending);
+        st.pending.clear();
+        app.buf.clear();
+        app.buf.append_hex(st.sending.size());
+        app.buf.append("\r\n");
+        std::array bufs {app.buf.buffer(), asio::buffer(st.sending),
+            buffer_literal("\r\n")};
+        co_await asio::async_write(s, bufs, deferred);
+        continue;
+      }
+
+      if(st.closed)
+        break;
+
+      st.timer->expires_at(asio::steady_timer::time_point::max());
+      co_await st.timer->async_wait(asio::as_tuple(deferred));
+    }
+
+    if(st.hung_up)
+      throw std::runtime_error {"Channel client disconnected"};
+    co_await asio::async_write(s, buffer_literal("0\r\n\r\n"), deferred);
+
+    // The next request may have started arriving while the channel was open
+    if(!st.early.empty()) {
+      if(!next_req)
+        next_req = gRequestPool.pop();
+      next_req->buf_.insert(next_req->buf_.end(), st.early.begin(),
+          st.early.end());
+      st.early.clear();
+    }
+  } catch(...) {
+    finish();
+    throw;
+  }
+
+  finish();
+}
+
+// Each segment is a slice of the header buffer followed by a span of the file.
+// Spans go out with sendfile() where the platform has it, the socket is only
+// non-blocking while it does. Otherwise, or once sendfile() has failed, reads
+// go through a bounce buffer with pread() so the wrapped file's own position is
+// never touched, and every chunk is written together with whatever header
+// bytes precede it.
+asio::awaitable<void> send_file(tcp::socket& s, WSGIAppRet& app) {
+  constexpr std::size_t chunk_size {std::size_t {64} << 10};
+  constexpr std::size_t max_transmit {std::size_t {1} << 30};
+  std::unique_ptr<char[]> chunk;
+  bool zero_copy {true};
+
+  for(const FileSegment& seg : app.segs) {
+    asio::const_buffer head {app.buf.data() + seg.buf_off, seg.buf_len};
+    std::uint64_t off {seg.file_off};
+    std::uint64_t left {seg.file_len};
+
+    if(zero_copy && left) {
+      if(head.size()) {
+        co_await asio::async_write(s, head, deferred);
+        head = {};
+      }
+
+      bool was_non_blocking {s.native_non_blocking()};
+      s.native_non_blocking(true);
+      while(left) {
+        std::ptrdiff_t n {transmit_file(s, app.fd, off,
+            static_cast<std::size_t>(
+                std::min<std::uint64_t>(left, max_transmit)))};
+        if(n > 0) {
+          off += n;
+          left -= n;
+        } else if(!n) {
+          co_await s.async_wait(tcp::socket::wait_write, deferred);
+        } else {
+          zero_copy = false;
+          break;
+        }
+      }
+      s.native_non_blocking(was_non_blocking);
+    }
+
+    if(left && !chunk)
+      chunk = std::make_unique_for_overwrite<char[]>(chunk_size);
+
+    while(left) {
+      std::size_t want {static_cast<std::size_t>(
+          std::min<std::uint64_t>(left, chunk_size))};
+      std::ptrdiff_t n {read_at(app.fd, chunk.get(), want, off)};
+      if(n <= 0) [[unlikely]]
+        throw std::runtime_error {"File body ended early"};
+
+      std::array bufs {head, asio::const_buffer {chunk.get(),
+                                 static_cast<std::size_t>(n)}};
+      co_await asio::async_write(s, bufs, deferred);
+      head = {};
+      off += n;
+      left -= n;
+    }
+
+    if(head.size())
+      co_await asio::async_write(s, head, deferred);
+  }
+}
+
+template <typename App>
+asio::awaitable<void> client(tcp::socket s, App& app) {
+  Connection* conn;
+  try {
+    conn = ConnSlab.pop();
+  } catch(...) {
+    asio::error_code ec;
+    s.close(ec);
+    co_return;
+  }
+
+  HTTPParser& http {conn->http};
+  WSGIRequest* req {nullptr};
   WSGIRequest* next_req {nullptr};
   WSGIAppRet* app_ret {nullptr};
-  HTTPParser http {req};
 
   try {
     for(;;) {
@@ -110,6 +345,14 @@ asio::awaitable<void> client(tcp::socket s, WSGIApp& app) {
         std::size_t n {req->buf_.size()};
         http.resume(req, req->get_parse_buf(0, n));
         off += n;
+      } else {
+        // Wait without a buffer, then read straight into the request
+        co_await s.async_wait(tcp::socket::wait_read, deferred);
+        req = gRequestPool.pop();
+        std::size_t n {
+            co_await s.async_read_some(req->get_read_buf(0), deferred)};
+        http.resume(req, req->get_parse_buf(0, n));
+        off += n;
       }
 
       while(!http.done()) {
@@ -119,20 +362,35 @@ asio::awaitable<void> client(tcp::socket s, WSGIApp& app) {
       }
 
       if(http.keep_alive()) {
-        next_req = ReqQ.pop();
-        auto rm {http.get_rem(off)};
-        next_req->buf_.resize(rm.size());
-        std::memcpy(next_req->buf_.data(), rm.data(), rm.size());
+        auto rm {http.get_rem()};
+        if(!rm.empty()) {
+          next_req = gRequestPool.pop();
+          next_req->buf_.resize(rm.size());
+          std::memcpy(next_req->buf_.data(), rm.data(), rm.size());
+        }
       }
 
-
       WSGIRequest* tmp = req;
       req = nullptr;
-      app_ret = app.run(tmp, http.http_minor, http.method, http.keep_alive());
+      if(!gPlugins.empty())
+        app_ret = gPlugins.dispatch(tmp, http.method, http.http_minor,
+            http.keep_alive());
+      if constexpr(std::same_as<App, WSGIApp>)
+        if(!app_ret)
+          app_ret = app.native_response(tmp, http.method, http.keep_alive());
+      if(!app_ret)
+        app_ret = app.run(tmp, http.http_minor, http.method, http.keep_alive());
 
       if(app_ret) [[likely]] {
-        if(!app_ret->iter) {
-          co_await s.async_send(asio::buffer(app_ret->buf), deferred);
+        if(!app_ret->segs.empty()) {
+          co_await send_file(s, *app_ret);
+        } else if(!app_ret->body.empty()) {
+          std::array bufs {app_ret->buf.buffer(), app_ret->body.buffer()};
+          co_await asio::async_write(s, bufs, deferred);
+        } else if(!app_ret->iter) {
+          co_await asio::async_write(s, app_ret->buf.buffer(), deferred);
+        } else if(Channel::check(app_ret->iter)) {
+          co_await handle_channel(s, *app_ret, next_req);
         } else {
           co_await handle_iter(s, *app_ret);
         }
@@ -149,7 +407,7 @@ asio::awaitable<void> client(tcp::socket s, WSGIApp& app) {
         break;
       }
 
-      push_WSGIAppRet(app_ret);
+      gAppRetPool.push(app_ret);
       app_ret = nullptr;
     }
   } catch(...) {
@@ -159,13 +417,15 @@ asio::awaitable<void> client(tcp::socket s, WSGIApp& app) {
   }
 
   if(app_ret)
-    push_WSGIAppRet(app_ret);
+    gAppRetPool.push(app_ret);
 
   if(req)
-    ReqQ.push(req);
+    gRequestPool.push(req);
 
   if(next_req)
-    ReqQ.push(next_req);
+    gRequestPool.push(next_req);
+
+  ConnSlab.push(conn);
 }
 
 asio::awaitable<void> listener(tcp::endpoint ep, int reuseport, auto& app) {
@@ -209,6 +469,19 @@ asio::awaitable<void> handle_header(asio::io_context& io) {
   }
 }
 
+asio::awaitable<void> handle_pools(asio::io_context& io,
+    std::chrono::seconds interval) {
+  asio::steady_timer timer {io};
+
+  for(;;) {
+    timer.expires_from_now(interval);
+    co_await timer.async_wait(deferred);
+    gRequestPool.trim();
+    gAppRetPool.trim();
+    gGzipPool.trim();
+  }
+}
+
 asio::awaitable<void> handle_signals(asio::io_context& io) {
   auto old_sigint {std::signal(SIGINT, SIG_DFL)};
   auto old_sigterm {std::signal(SIGTERM, SIG_DFL)};
@@ -231,9 +504,94 @@ asio::awaitable<void> handle_signals(asio::io_context& io) {
   std::signal(SIGTERM, old_sigterm);
 }
 
+constexpr std::string_view default_compress_types[] {
+    "text/*",
+    "application/json",
+    "application/javascript",
+    "application/xml",
+    "image/svg+xml",
+};
+
+bool unpack_str_list(PyObject* obj, std::vector<std::string>& out) {
+  PyObject* seq {PySequence_Fast(obj, "compress_types must be a sequence")};
+  if(!seq)
+    return false;
+
+  for(Py_ssize_t i {0}, end {PySequence_Fast_GET_SIZE(seq)}; i < end; ++i) {
+    Py_ssize_t len;
+    const char* str {
+        PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(seq, i), &len)};
+    if(!str) {
+      Py_DECREF(seq);
+      return false;
+    }
+    out.emplace_back(str, len);
+  }
+
+  Py_DECREF(seq);
+  return true;
+}
+
 constexpr const char* _rs_keywords[] {"app", "host", "port", "reuseport",
-    nullptr};
-_PyArg_Parser _rs_parser {.format = "O|ssp:run", .keywords = _rs_keywords};
+    "pool_trim", "hugepages", "body_spill", "etag", "ranges", "compress",
+    "compress_min", "compress_types", "microcache", "static_routes", "plugins",
+    "mounts", "static_dirs", nullptr};
+_PyArg_Parser _rs_parser {.format = "O|sspipnppinOnO!OO!O!:run",
+    .keywords = _rs_keywords};
+
+constexpr const char* _hs_keywords[] {"app", "host", "port", "reuseport",
+    "pool_trim", "hugepages", "body_spill", "plugins", nullptr};
+_PyArg_Parser _hs_parser {.format = "O|sspipnO:http", .keywords = _hs_keywords};
+
+bool configure_pools(int hugepages, Py_ssize_t body_spill) {
+  if(body_spill < 0) {
+    PyErr_SetString(PyExc_ValueError, "body_spill must be non-negative");
+    return false;
+  }
+  gBodySpill = static_cast<std::size_t>(body_spill);
+
+  if(hugepages) {
+    gRequestPool.use_slab(true);
+    gAppRetPool.use_slab(true);
+  }
+  return true;
+}
+
+// Routes from a previous server are dropped even if there's nothing to load
+bool load_plugins(PyObject* plugins) {
+  gPlugins.clear();
+  if(!plugins || plugins == Py_None)
+    return true;
+
+  PyObject* seq {PySequence_Fast(plugins, "plugins must be a sequence")};
+  if(!seq)
+    return false;
+
+  for(Py_ssize_t i {0}, end {PySequence_Fast_GET_SIZE(seq)}; i < end; ++i) {
+    if(!gPlugins.load(PySequence_Fast_GET_ITEM(seq, i))) {
+      gPlugins.clear();
+      Py_DECREF(seq);
+      return false;
+    }
+  }
+
+  Py_DECREF(seq);
+  return true;
+}
+
+void serve(auto& app, const char* host, const char* port, int reuseport,
+    int pool_trim) {
+  asio::io_context io {1};
+  asio::co_spawn(io, handle_signals(io), detached);
+  asio::co_spawn(io, handle_header(io), detached);
+  if(pool_trim > 0)
+    asio::co_spawn(io, handle_pools(io, std::chrono::seconds {pool_trim}),
+        detached);
+
+  accept(io.get_executor(), host, port, reuseport, app);
+  io.run();
+  gPlugins.clear();
+}
 
 } // namespace
 
@@ -244,25 +602,152 @@ PyObject* run_wsgi_server(PyObject* /* self */, PyObject* const* args,
   const char* host {"localhost"};
   const char* port {"8000"};
   int reuseport {0};
+  int pool_trim {30};
+  int hugepages {0};
+  Py_ssize_t body_spill {static_cast<Py_ssize_t>(gBodySpill)};
+  int etag {0};
+  int ranges {0};
+  int compress {0};
+  Py_ssize_t compress_min {1024};
+  PyObject* compress_types {nullptr};
+  Py_ssize_t microcache {0};
+  PyObject* static_routes {nullptr};
+  PyObject* plugins {nullptr};
+  PyObject* mounts {nullptr};
+  PyObject* static_dirs {nullptr};
 
   if(!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &_rs_parser, &appObj,
-         &host, &port, &reuseport))
+         &host, &port, &reuseport, &pool_trim, &hugepages, &body_spill,
+         &etag, &ranges, &compress, &compress_min, &compress_types,
+         &microcache, &PyDict_Type, &static_routes, &plugins, &PyDict_Type,
+         &mounts, &PyDict_Type, &static_dirs))
+    return nullptr;
+
+  if(appObj == Py_None ? !mounts && !static_dirs
+                       : !PyCallable_Check(appObj)) {
+    PyErr_SetString(PyExc_TypeError,
+        "app must be a WSGI app, or None when mounts or static_dirs are "
+        "given");
+    return nullptr;
+  }
+
+  if(compress < 0 || compress > 9) {
+    PyErr_SetString(PyExc_ValueError, "compress must be a level from 0 to 9");
+    return nullptr;
+  }
+
+  if(compress_min < 0) {
+    PyErr_SetString(PyExc_ValueError, "compress_min must be non-negative");
+    return nullptr;
+  }
+
+  CompressOptions copts {.level = compress,
+      .min_size = static_cast<std::size_t>(compress_min)};
+  if(!compress_types) {
+    copts.types = {std::begin(default_compress_types),
+        std::end(default_compress_types)};
+  } else if(!unpack_str_list(compress_types, copts.types)) {
+    return nullptr;
+  }
+  gGzipPool.set_level(compress);
+
+  if(microcache < 0) {
+    PyErr_SetString(PyExc_ValueError, "microcache must be non-negative");
+    return nullptr;
+  }
+
+  if(!configure_pools(hugepages, body_spill) || !load_plugins(plugins))
     return nullptr;
 
   Py_INCREF(appObj);
 
-  asio::io_context io {1};
-  asio::co_spawn(io, handle_signals(io), detached);
-  asio::co_spawn(io, handle_header(io), detached);
+  WSGIApp app {appObj, host, port, static_cast<bool>(etag),
+      static_cast<bool>(ranges), std::move(copts),
+      static_cast<std::size_t>(microcache)};
+
+  if(static_routes) {
+    PyObject* path;
+    PyObject* spec;
+    for(Py_ssize_t pos {0}; PyDict_Next(static_routes, &pos, &path, &spec);) {
+      if(!app.add_static_route(path, spec)) {
+        gPlugins.clear();
+        Py_DECREF(appObj);
+        return nullptr;
+      }
+    }
+  }
 
-  WSGIApp app {appObj, host, port};
-  accept(io.get_executor(), host, port, reuseport, app);
-  io.run();
+  if(static_dirs) {
+    PyObject* prefix;
+    PyObject* root;
+    for(Py_ssize_t pos {0}; PyDict_Next(static_dirs, &pos, &prefix, &root);) {
+      if(!app.add_static_dir(prefix, root)) {
+        gPlugins.clear();
+        Py_DECREF(appObj);
+        return nullptr;
+      }
+    }
+  }
+
+  if(mounts) {
+    PyObject* key;
+    PyObject* mounted;
+    for(Py_ssize_t pos {0}; PyDict_Next(mounts, &pos, &key, &mounted);) {
+      if(!app.add_mount(key, mounted)) {
+        gPlugins.clear();
+        Py_DECREF(appObj);
+        return nullptr;
+      }
+    }
+  }
+
+  serve(app, host, port, reuseport, pool_trim);
+
+  Py_DECREF(appObj);
 
+  // There is no way to exit the run loop that isn't via an exception being set
+  return nullptr;
+}
+
+PyObject* run_http_server(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames) {
+
+  PyObject* appObj;
+  const char* host {"localhost"};
+  const char* port {"8000"};
+  int reuseport {0};
+  int pool_trim {30};
+  int hugepages {0};
+  Py_ssize_t body_spill {static_cast<Py_ssize_t>(gBodySpill)};
+  PyObject* plugins {nullptr};
+
+  if(!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &_hs_parser, &appObj,
+         &host, &port, &reuseport, &pool_trim, &hugepages, &body_spill,
+         &plugins))
+    return nullptr;
+
+  if(!configure_pools(hugepages, body_spill) || !load_plugins(plugins))
+    return nullptr;
+
+  Py_INCREF(appObj);
+  HTTPApp app {appObj};
+  serve(app, host, port, reuseport, pool_trim);
   Py_DECREF(appObj);
 
   // There is no way to exit the run loop that isn't via an exception being set
   return nullptr;
 }
 
+PyObject* pool_stats(PyObject* /* self */, PyObject* /* args */) {
+  PyObject* req {gRequestPool.stats()};
+  PyObject* appret {gAppRetPool.stats()};
+  PyObject* ret {nullptr};
+  if(req && appret)
+    ret = Py_BuildValue("{s:O,s:O}", gRequestPool.name(), req,
+        gAppRetPool.name(), appret);
+  Py_XDECREF(req);
+  Py_XDECREF(appret);
+  return ret;
+}
+
 } // namespace velocem
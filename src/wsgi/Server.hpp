@@ -8,6 +8,11 @@ namespace velocem {
 PyObject* run_wsgi_server(PyObject* /* self */, PyObject* const* args,
     Py_ssize_t nargs, PyObject* kwnames);
 
+PyObject* run_http_server(PyObject* /* self */, PyObject* const* args,
+    Py_ssize_t nargs, PyObject* kwnames);
+
+PyObject* pool_stats(PyObject* /* self */, PyObject* /* args */);
+
 } // namespace velocem
 
 #endif // VELOCEM_WSGI_SERVER_HPP
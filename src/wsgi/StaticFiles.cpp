@@ -0,0 +1,367 @@
+#include "StaticFiles.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+#include "plat/plat.hpp"
+#include "router/RouteTree.hpp"
+#include "router/Router.hpp"
+#include "util/Constants.hpp"
+#include "util/Gzip.hpp"
+#include "util/HeaderCheck.hpp"
+#include "util/OutputBuffer.hpp"
+
+#include "App.hpp"
+#include "Range.hpp"
+#include "Request.hpp"
+
+namespace velocem {
+
+namespace {
+
+// How long a cached stat() is trusted before the path is checked again
+constexpr std::chrono::seconds revalidate_after {1};
+
+// Open descriptors are bounded, the least recently used entries give way first
+constexpr std::size_t max_entries {256};
+
+// clang-format off
+constexpr std::array<std::pair<std::string_view, std::string_view>, 31>
+    content_types {{
+  {"avif", "image/avif"},
+  {"css", "text/css; charset=utf-8"},
+  {"csv", "text/csv; charset=utf-8"},
+  {"gif", "image/gif"},
+  {"htm", "text/html; charset=utf-8"},
+  {"html", "text/html; charset=utf-8"},
+  {"ico", "image/x-icon"},
+  {"jpeg", "image/jpeg"},
+  {"jpg", "image/jpeg"},
+  {"js", "text/javascript; charset=utf-8"},
+  {"json", "application/json"},
+  {"map", "application/json"},
+  {"md", "text/markdown; charset=utf-8"},
+  {"mjs", "text/javascript; charset=utf-8"},
+  {"mp3", "audio/mpeg"},
+  {"mp4", "video/mp4"},
+  {"ogg", "audio/ogg"},
+  {"otf", "font/otf"},
+  {"pdf", "application/pdf"},
+  {"png", "image/png"},
+  {"svg", "image/svg+xml"},
+  {"ttf", "font/ttf"},
+  {"txt", "text/plain; charset=utf-8"},
+  {"wasm", "application/wasm"},
+  {"wav", "audio/wav"},
+  {"webm", "video/webm"},
+  {"webp", "image/webp"},
+  {"woff", "font/woff"},
+  {"woff2", "font/woff2"},
+  {"xml", "application/xml"},
+  {"zip", "application/zip"},
+}};
+// clang-format on
+
+std::string_view content_type(std::string_view path) {
+  constexpr std::string_view fallback {"application/octet-stream"};
+
+  std::size_t dot {path.rfind('.')};
+  if(dot == path.npos || path.find('/', dot) != path.npos)
+    return fallback;
+
+  std::string_view ext {path.substr(dot + 1)};
+  char lower[8];
+  if(ext.size() > sizeof(lower))
+    return fallback;
+  std::ranges::transform(ext, lower,
+      [](char c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; });
+  ext = {lower, ext.size()};
+
+  auto it {std::ranges::lower_bound(content_types, ext, {},
+      &std::pair<std::string_view, std::string_view>::first)};
+  return it != content_types.end() && it->first == ext ? it->second : fallback;
+}
+
+// Appends the segments of a percent-decoded URL path to a directory. Empty and
+// "." segments are dropped. Fails for "..", for anything a filesystem could
+// read as a separator, drive or terminator, and when no segment remains.
+bool append_path(std::string& out, std::string_view rest) {
+  constexpr std::string_view unsafe {"\\:\0", 3};
+  bool any {false};
+  while(!rest.empty()) {
+    std::size_t slash {rest.find('/')};
+    std::string_view seg {rest.substr(0, slash)};
+    rest.remove_prefix(slash == rest.npos ? rest.size() : slash + 1);
+
+    if(seg.empty() || seg == ".")
+      continue;
+    if(seg == ".." || seg.find_first_of(unsafe) != seg.npos)
+      return false;
+
+    out.push_back('/');
+    out.append(seg);
+    any = true;
+  }
+  return any;
+}
+
+WSGIAppRet* miss(WSGIRequest* req, RouteTree::Result result, bool keepalive) {
+  static const std::vector<int> allowed {static_cast<int>(HTTPMethod::Get)};
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  Router::write_miss(ret->buf, result, allowed, keepalive);
+  gRequestPool.push(req);
+  return ret;
+}
+
+void append_header(OutputBuffer& buf, std::string_view name,
+    std::string_view value) {
+  buf.reserve(name.size() + value.size() + 4);
+  buf.append_unchecked(name.data(), name.size());
+  buf.append_unchecked(": ", 2);
+  buf.append_unchecked(value.data(), value.size());
+  buf.append_unchecked("\r\n", 2);
+}
+
+} // namespace
+
+StaticFiles::File::File(int fd, const FileStat& st) : fd {fd}, st {st} {
+  char hex[2 * sizeof(std::uint64_t)];
+  auto append_hex {[&](std::uint64_t v) {
+    int i {sizeof(hex)};
+    do
+      hex[--i] = "0123456789abcdef"[v & 0xF];
+    while(v >>= 4);
+    etag.append(hex + i, sizeof(hex) - i);
+  }};
+
+  // The same shape as nginx's, so ETags survive a move between the two
+  etag.push_back('"');
+  append_hex(st.size);
+  etag.push_back('-');
+  append_hex(static_cast<std::uint64_t>(st.mtime));
+  etag.push_back('"');
+
+  last_modified = std::format("{:%a, %d %b %Y %T} GMT",
+      std::chrono::sys_seconds {std::chrono::seconds {st.mtime}});
+}
+
+StaticFiles::File::~File() {
+  close_file(fd);
+}
+
+bool StaticFiles::add_dir(PyObject* prefix, PyObject* root) {
+  if(!PyUnicode_Check(prefix)) {
+    PyErr_SetString(PyExc_TypeError,
+        "static_dirs must map str prefixes to directories");
+    return false;
+  }
+
+  Py_ssize_t plen;
+  const char* pstr {PyUnicode_AsUTF8AndSize(prefix, &plen)};
+  if(!pstr)
+    return false;
+
+  std::string_view pre {pstr, static_cast<std::size_t>(plen)};
+  if(!pre.starts_with('/')) {
+    PyErr_SetString(PyExc_ValueError,
+        "static_dirs prefixes must start with '/'");
+    return false;
+  }
+  while(pre.ends_with('/'))
+    pre.remove_suffix(1);
+
+  PyObject* bytes;
+  if(!PyUnicode_FSConverter(root, &bytes))
+    return false;
+
+  std::string dir {PyBytes_AS_STRING(bytes)};
+  Py_DECREF(bytes);
+  while(dir.size() > 1 && (dir.ends_with('/') || dir.ends_with('\\')))
+    dir.pop_back();
+
+  FileStat st;
+  if(!stat_path(dir.c_str(), st) || st.regular) {
+    PyErr_Format(PyExc_ValueError, "static_dirs root %s isn't a directory",
+        dir.c_str());
+    return false;
+  }
+  if(dir == "/")
+    dir.clear();
+
+  auto it {std::ranges::find_if(dirs_,
+      [&](const Dir& d) { return d.prefix == pre; })};
+  if(it != dirs_.end()) {
+    it->root = std::move(dir);
+    return true;
+  }
+
+  // Kept ordered longest first, so the first match is the most specific
+  auto pos {std::ranges::find_if(dirs_,
+      [&](const Dir& d) { return d.prefix.size() < pre.size(); })};
+  dirs_.insert(pos, {std::string {pre}, std::move(dir)});
+  return true;
+}
+
+std::shared_ptr<StaticFiles::File> StaticFiles::open(const std::string& path,
+    const std::shared_ptr<File>& cached) {
+  FileStat st;
+  if(!stat_path(path.c_str(), st) || !st.regular)
+    return nullptr;
+
+  if(cached && cached->st.id == st.id && cached->st.size == st.size &&
+      cached->st.mtime == st.mtime && cached->st.mtime_ns == st.mtime_ns)
+    return cached;
+
+  int fd {open_file(path.c_str())};
+  if(fd == -1)
+    return nullptr;
+
+  // The path may have been replaced between the two calls, the descriptor is
+  // what gets served
+  if(!stat_file(fd, st) || !st.regular) {
+    close_file(fd);
+    return nullptr;
+  }
+  return std::make_shared<File>(fd, st);
+}
+
+// Misses are cached like hits, so repeated 404s don't each cost two stat()s
+const StaticFiles::Entry* StaticFiles::lookup() {
+  clock::time_point now {clock::now()};
+  Entry* entry;
+  if(auto it {index_.find(path_)}; it != index_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    entry = &*it->second;
+    if(now - entry->checked < revalidate_after)
+      return entry->plain ? entry : nullptr;
+  } else {
+    if(lru_.size() >= max_entries) {
+      index_.erase(lru_.back().path);
+      lru_.pop_back();
+    }
+    entry = &lru_.emplace_front();
+    entry->path = path_;
+    entry->content_type = content_type(path_);
+    index_.emplace(path_, lru_.begin());
+  }
+
+  entry->plain = open(path_, entry->plain);
+  if(entry->plain) {
+    gz_path_.assign(path_).append(".gz");
+    entry->gz = open(gz_path_, entry->gz);
+  } else {
+    entry->gz.reset();
+  }
+  entry->checked = now;
+  return entry->plain ? entry : nullptr;
+}
+
+WSGIAppRet* StaticFiles::respond(WSGIRequest* req, int meth, bool keepalive) {
+  std::string_view url {req->url().view()};
+  auto dir {std::ranges::find_if(dirs_, [&](const Dir& d) {
+    return url.starts_with(d.prefix) &&
+        (url.size() == d.prefix.size() || url[d.prefix.size()] == '/');
+  })};
+  if(dir == dirs_.end())
+    return nullptr;
+
+  bool head {meth == static_cast<int>(HTTPMethod::Head)};
+  if(!head && meth != static_cast<int>(HTTPMethod::Get))
+    return miss(req, RouteTree::Result::MethodNotAllowed, keepalive);
+
+  path_.assign(dir->root);
+  if(!append_path(path_, url.substr(dir->prefix.size())))
+    return miss(req, RouteTree::Result::NotFound, keepalive);
+
+  const Entry* entry {lookup()};
+  if(!entry)
+    return miss(req, RouteTree::Result::NotFound, keepalive);
+
+  std::string_view accept_enc;
+  std::string_view inm;
+  std::string_view ims;
+  std::string_view range;
+  std::string_view if_range;
+  for(WSGIHeader& hdr : req->headers_) {
+    std::string_view field {hdr.field.view()};
+    if(cgi_header_matches(field, "Accept-Encoding"))
+      accept_enc = hdr.value.view();
+    else if(cgi_header_matches(field, "If-None-Match"))
+      inm = hdr.value.view();
+    else if(cgi_header_matches(field, "If-Modified-Since"))
+      ims = hdr.value.view();
+    else if(cgi_header_matches(field, "Range"))
+      range = hdr.value.view();
+    else if(cgi_header_matches(field, "If-Range"))
+      if_range = hdr.value.view();
+  }
+
+  bool gzip {entry->gz && accepts_gzip(accept_enc)};
+  const std::shared_ptr<File>& file {gzip ? entry->gz : entry->plain};
+
+  WSGIAppRet* ret {gAppRetPool.pop()};
+  OutputBuffer& buf {ret->buf};
+
+  // If-Modified-Since is only consulted without If-None-Match, and compared
+  // exactly against what was sent rather than parsed as a date
+  bool not_modified {!inm.empty()
+          ? none_match_matches(inm, file->etag)
+          : !ims.empty() && ims == file->last_modified};
+  buf.append(not_modified ? "HTTP/1.1 304 Not Modified\r\n"
+                          : "HTTP/1.1 200 OK\r\n");
+  std::size_t status_end {buf.size()};
+  buf.append(gRequiredHeaders);
+  if(keepalive)
+    buf.append("Connection: keep-alive\r\n");
+  else
+    buf.append("Connection: close\r\n");
+  if(!not_modified)
+    append_header(buf, "Content-Type", entry->content_type);
+  append_header(buf, "Last-Modified", file->last_modified);
+  append_header(buf, "ETag", file->etag);
+  if(gzip && !not_modified)
+    buf.append("Content-Encoding: gzip\r\n");
+  if(entry->gz)
+    buf.append("Vary: Accept-Encoding\r\n");
+
+  if(not_modified) {
+    buf.append("\r\n");
+    gRequestPool.push(req);
+    return ret;
+  }
+
+  std::uint64_t size {file->st.size};
+  buf.append("Accept-Ranges: bytes\r\nContent-Length: ");
+  buf.append_dec(size);
+  buf.append("\r\n\r\n");
+
+  if(!head && size) {
+    ret->fd = file->fd;
+    ret->pin = file;
+    ret->segs.push_back({0, buf.size(), 0, size});
+
+    if(!range.empty() &&
+        (if_range.empty() ||
+            if_range_matches(if_range, file->etag, file->last_modified))) {
+      auto result {parse_range(range, size, ranges_)};
+      if(result != RangeResult::Ignore)
+        apply_ranges(*ret, result, ranges_, size, status_end, buf.size());
+    }
+  }
+
+  gRequestPool.push(req);
+  return ret;
+}
+
+} // namespace velocem
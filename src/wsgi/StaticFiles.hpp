@@ -0,0 +1,101 @@
+#ifndef VELOCEM_WSGI_STATICFILES_HPP
+#define VELOCEM_WSGI_STATICFILES_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+#include "plat/plat.hpp"
+#include "util/Hash.hpp"
+
+#include "Range.hpp"
+
+namespace velocem {
+struct WSGIAppRet;
+struct WSGIRequest;
+} // namespace velocem
+
+namespace velocem {
+
+// Directories served under URL prefixes without entering Python. Paths are
+// normalized segment by segment, "." and empty segments are dropped and any
+// ".." is refused, so nothing outside the directory can be named.
+//
+// Open descriptors and their stat results are cached, as are paths which
+// turned out not to exist. An entry is trusted for a second, then revalidated
+// with a stat() of its path, so new and replaced files are picked up without a
+// restart. A "file.gz" next to "file" is sent to clients
+// accepting gzip. Responses carry Last-Modified and an ETag built from the size
+// and modification time, and are conditional on If-None-Match, or failing
+// that an exact If-Modified-Since, and Range.
+class StaticFiles {
+public:
+  StaticFiles() = default;
+  StaticFiles(StaticFiles&) = delete;
+
+  bool empty() const {
+    return dirs_.empty();
+  }
+
+  // Returns false with a Python exception set if root isn't a directory
+  bool add_dir(PyObject* prefix, PyObject* root);
+
+  // The response for a path under one of the prefixes, consuming the request,
+  // or nullptr for paths outside them
+  WSGIAppRet* respond(WSGIRequest* req, int meth, bool keepalive);
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct File {
+    File(int fd, const FileStat& st);
+    File(File&) = delete;
+    ~File();
+
+    int fd;
+    FileStat st;
+    std::string etag;
+    std::string last_modified;
+  };
+
+  // Entries without a plain file record a miss
+  struct Entry {
+    std::string path;
+    std::shared_ptr<File> plain;
+    std::shared_ptr<File> gz;
+    std::string_view content_type;
+    clock::time_point checked;
+  };
+
+  struct Dir {
+    std::string prefix; // Without a trailing slash
+    std::string root;
+  };
+
+  using LRU = std::list<Entry>;
+
+  const Entry* lookup();
+  static std::shared_ptr<File> open(const std::string& path,
+      const std::shared_ptr<File>& cached);
+
+  std::vector<Dir> dirs_; // Longest prefix first
+  LRU lru_; // Most recently used first
+  std::unordered_map<std::string, LRU::iterator, StringHash, std::equal_to<>>
+      index_;
+  std::string path_;
+  std::string gz_path_;
+  std::vector<ByteRange> ranges_;
+};
+
+} // namespace velocem
+
+#endif // VELOCEM_WSGI_STATICFILES_HPP
@@ -0,0 +1,95 @@
+import velocem
+
+router = velocem.Router()
+
+
+@router.get('/')
+def root(req):
+  return b''
+
+
+@router.get('/hello')
+def hello(req):
+  return b'Hello World'
+
+
+@router.get('/tuple')
+def tuple_response(req):
+  return 201, [('Content-Type', 'text/plain')], 'created'
+
+
+@router.get('/response')
+def response(req):
+  return velocem.Response(b'teapot', status=418, headers={'X-Test': 'yes'})
+
+
+@router.get('/users/{id:int}')
+def user(req):
+  return f'user {req.captures["id"]!r}'
+
+
+@router.get('/request')
+def request_info(req):
+  return (200, None,
+          f'{req.method} {req.path} {req.query} {req.version} '
+          f'{req.header("X-Test", "none")}')
+
+
+@router.post('/params')
+def params(req):
+  return repr((req.params.getlist('a'), req.params.get('b'), req.form.items(),
+               req.body))
+
+
+@router.post('/upload')
+def upload(req):
+  return repr([(name, filename, len(value))
+               for name, filename, _, value in velocem.parse_multipart(req)])
+
+
+@router.post('/echo')
+def echo(req):
+  return 200, {'Content-Type': req.header('Content-Type', '')}, req.body
+
+
+@router.get('/big')
+def big(req):
+  return b'x' * (1 << 20)
+
+
+@router.get('/json')
+def json(req):
+  return velocem.json_response(
+      {'a': [1, 2.5, None, True], 's': 'q"\n\u00e9', 1: {}})
+
+
+@router.get('/json_created')
+def json_created(req):
+  return velocem.json_response([], status=201,
+                               headers={'Content-Type': 'application/x-test'})
+
+
+@router.post('/json_echo')
+def json_echo(req):
+  return velocem.json_response(req.json())
+
+
+@router.get('/json_bad')
+def json_bad(req):
+  return velocem.json_response({'obj': object()})
+
+
+@router.get('/bad_status')
+def bad_status(req):
+  return 'OK', None, b''
+
+
+@router.get('/raise')
+def raise_exception(req):
+  raise RuntimeError('Test Exception')
+
+
+app = router
+
+if __name__ == '__main__':
+  velocem.http(app)
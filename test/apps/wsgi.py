@@ -1,3 +1,5 @@
+import json
+
 import velocem
 import nanoroute
 
@@ -32,6 +34,147 @@ def echo(environ, start_response):
   return environ['wsgi.input'].read()
 
 
+@router.post('/echo_readinto')
+def echo_readinto(environ, start_response):
+  length = int(environ['CONTENT_LENGTH'])
+  buf = bytearray(length)
+  view = memoryview(buf)
+  inp = environ['wsgi.input']
+  pos = 0
+  while n := inp.readinto(view[pos:]):
+    pos += n
+  start_response('200 OK', [])
+  return bytes(buf[:pos])
+
+
+@router.post('/echo_getbuffer')
+def echo_getbuffer(environ, start_response):
+  view = environ['wsgi.input'].getbuffer()
+  assert view.readonly
+  start_response('200 OK', [])
+  return view.tobytes()
+
+
+@router.post('/echo_json')
+def echo_json(environ, start_response):
+  try:
+    body = repr(velocem.json_body(environ))
+  except ValueError as e:
+    start_response('400 Bad Request', [])
+    return type(e).__name__.encode()
+  start_response('200 OK', [])
+  return body.encode()
+
+
+@router.post('/form')
+def form(environ, start_response):
+  query = velocem.QueryDict(environ['QUERY_STRING'])
+  form = velocem.QueryDict(environ['wsgi.input'])
+  start_response('200 OK', [])
+  return repr((environ['QUERY_STRING'], query.getlist('a'), query.get('b'),
+               'c' in query, form['x'], form.items())).encode()
+
+
+@router.post('/upload')
+def upload(environ, start_response):
+  try:
+    parts = velocem.parse_multipart(environ, max_field_size=16)
+  except ValueError as e:
+    start_response('400 Bad Request', [])
+    return str(e).encode()
+  start_response('200 OK', [])
+  return repr([(name, filename, ctype,
+                value if isinstance(value, str) else bytes(value))
+               for name, filename, ctype, value in parts]).encode()
+
+
+@router.get('/conlen')
+def conlen(environ, start_response):
+  body = environ['QUERY_STRING'].encode('ascii')
+  start_response('200 OK', [
+      ('Content-Type', 'text/plain'),
+      ('Content-Length', str(len(body))),
+  ])
+  return body
+
+
+# Values arrive as a JSON body so they reach the app byte for byte
+@router.post('/header')
+def header(environ, start_response):
+  spec = json.loads(environ['wsgi.input'].read())
+  status = spec.get('status', '200 OK')
+  start_response(status, [(spec['name'], spec['value'])])
+  return b''
+
+
+BLOB = bytes(range(256)) * 256
+
+
+@router.get('/bytearray')
+def bytearray_(environ, start_response):
+  start_response('200 OK', [])
+  return bytearray(BLOB)
+
+
+@router.get('/memoryview')
+def memoryview_(environ, start_response):
+  start_response('200 OK', [('Content-Length', '1000')])
+  return memoryview(BLOB)[256:]
+
+
+@router.get('/buffer_chunks')
+def buffer_chunks(environ, start_response):
+  start_response('200 OK', [])
+  yield memoryview(BLOB)[:100]
+  yield bytearray(b'Hello')
+  yield memoryview(BLOB)
+
+
+@router.get('/file')
+def file_(environ, start_response):
+  start_response('200 OK', [('Content-Type', 'text/plain')])
+  return environ['wsgi.file_wrapper'](open(__file__, 'rb'))
+
+
+TEXT = b'Hello World\n' * 512
+
+
+@router.get('/text')
+def text(environ, start_response):
+  start_response('200 OK', [('Content-Type', 'text/plain; charset=utf-8')])
+  return TEXT
+
+
+@router.get('/text_stream')
+def text_stream(environ, start_response):
+  start_response('200 OK', [('Content-Type', 'text/plain')])
+  for i in range(0, len(TEXT), 1000):
+    yield TEXT[i:i + 1000]
+
+
+@router.get('/text_written')
+def text_written(environ, start_response):
+  write = start_response('200 OK', [('Content-Type', 'text/plain'),
+                                    ('Content-Length', str(len(TEXT) * 9))])
+  write(TEXT)
+  return TEXT * 8
+
+
+cache_counter = 0
+
+
+@router.get('/cached')
+def cached(environ, start_response):
+  global cache_counter
+  cache_counter += 1
+  start_response('200 OK', [
+      ('Cache-Control', 'public, s-maxage=60'),
+      ('Vary', 'X-Lang'),
+  ])
+  lang = environ.get('HTTP_X_LANG', '')
+  return f'{lang}{cache_counter}'.encode('ascii')
+
+
 @router.get('/list')
 def list_(environ, start_response):
   start_response('200 OK', [])
@@ -132,7 +275,72 @@ def raise_exception_after_sr(environ, start_response):
   raise RuntimeError('Test Exception')
 
 
+subscribers = []
+
+
+@router.get('/subscribe')
+def subscribe(environ, start_response):
+  start_response('200 OK', [('Content-Type', 'text/event-stream')])
+  ch = velocem.Channel()
+  ch.send(b'retry: 1000\n\n')
+  subscribers.append(ch)
+  return ch
+
+
+@router.post('/publish')
+def publish(environ, start_response):
+  msg = environ['wsgi.input'].read()
+  sent = sum(ch.send(b'data: ' + msg + b'\n\n') for ch in subscribers)
+  subscribers[:] = [ch for ch in subscribers if not ch.closed]
+  start_response('200 OK', [])
+  return str(sent).encode()
+
+
+@router.post('/unsubscribe')
+def unsubscribe(environ, start_response):
+  for ch in subscribers:
+    ch.close()
+  subscribers.clear()
+  start_response('200 OK', [])
+  return b''
+
+
 app = router.wsgi_app
 
+native_router = velocem.Router()
+
+
+@native_router.get('/users/{id:int}')
+def user(environ, start_response):
+  start_response('200 OK', [])
+  return f'user {environ["velocem.captures"]["id"]!r}'.encode()
+
+
+@native_router.get('/users/me')
+def user_me(environ, start_response):
+  start_response('200 OK', [])
+  return b'me'
+
+
+@native_router.get('/files/{rest:path}')
+def files(environ, start_response):
+  start_response('200 OK', [])
+  return environ['velocem.captures']['rest'].encode()
+
+
+@native_router.route('/items/{name}', methods=['PUT', 'DELETE'])
+def items(environ, start_response):
+  start_response('200 OK', [])
+  caps = environ['velocem.captures']
+  return f'{environ["REQUEST_METHOD"]} {caps["name"]}'.encode()
+
+
+def mounted(name):
+  def app(environ, start_response):
+    start_response('200 OK', [])
+    return f'{name} {environ["SCRIPT_NAME"]} {environ["PATH_INFO"]}'.encode()
+
+  return app
+
 if __name__ == '__main__':
   velocem.wsgi(app)
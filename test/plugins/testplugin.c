@@ -0,0 +1,60 @@
+/*
+ * Plugin used by test_plugins, compiled by the test suite. Registers:
+ *
+ *   GET /plugin/ping      Exact route, answers "pong"
+ *   /echo...              Prefix route for any method, answers "plugin " and
+ *                         the body. The server declines spilled bodies.
+ *   GET /hello            Declined unless the request has X-Plugin, leaving
+ *                         it to the app
+ *
+ * Built with TESTPLUGIN_BAD_ABI it claims the wrong ABI version.
+ */
+
+#include <velocem/plugin.h>
+
+#ifdef TESTPLUGIN_BAD_ABI
+VELOCEM_PLUGIN_EXPORT uint32_t velocem_plugin_abi(void) {
+  return VELOCEM_PLUGIN_ABI_VERSION + 1;
+}
+#else
+VELOCEM_PLUGIN_DECLARE
+#endif
+
+static const velocem_host* host;
+
+static int ping(void* ctx, const velocem_request* req,
+    velocem_response* resp) {
+  (void) ctx;
+  (void) req;
+  host->add_header(resp, "Content-Type", 12, "text/plain", 10);
+  host->write(resp, "pong", 4);
+  return VELOCEM_HANDLED;
+}
+
+static int echo(void* ctx, const velocem_request* req,
+    velocem_response* resp) {
+  (void) ctx;
+  host->set_status(resp, 201);
+  host->add_header(resp, "X-Path", 6, req->path.data, req->path.len);
+  host->write(resp, "plugin ", 7);
+  host->write(resp, req->body.data, req->body.len);
+  return VELOCEM_HANDLED;
+}
+
+static int maybe(void* ctx, const velocem_request* req,
+    velocem_response* resp) {
+  (void) ctx;
+  if(!host->header(req, "X-Plugin").data)
+    return VELOCEM_DECLINED;
+  host->write(resp, "plugin hello", 12);
+  return VELOCEM_HANDLED;
+}
+
+int velocem_plugin_init(const velocem_host* h, velocem_registrar* reg) {
+  host = h;
+  if(host->add_route(reg, "GET", "/plugin/ping", 0, ping, NULL) ||
+      host->add_route(reg, VELOCEM_ANY_METHOD, "/echo", 1, echo, NULL) ||
+      host->add_route(reg, "GET", "/hello", 0, maybe, NULL))
+    return -1;
+  return 0;
+}
@@ -0,0 +1,167 @@
+import pytest
+import json
+from urllib import request
+
+import velocem
+from apps import native
+
+from util import spawn_server, run_req_test, run_fail_test
+
+URL = 'http://localhost:8006'
+
+
+@pytest.fixture(scope='module')
+def http_server():
+  with spawn_server(velocem.http, native.app, 8006) as p:
+    yield p
+
+
+def test_hello(http_server):
+  def f(resp):
+    assert resp.headers['Content-Length'] == '11'
+    assert resp.headers['Server'] == f'Velocem/{velocem.__version__}'
+    assert resp.read() == b'Hello World'
+
+  run_req_test(f, URL, endpoint='/hello')
+
+  def root(resp):
+    assert resp.headers['Content-Length'] == '0'
+    assert resp.read() == b''
+
+  run_req_test(root, URL, endpoint='/', reps=2)
+
+
+def test_response_forms(http_server):
+  def tup(resp):
+    assert resp.status == 201
+    assert resp.headers['Content-Type'] == 'text/plain'
+    assert resp.read() == b'created'
+
+  run_req_test(tup, URL, endpoint='/tuple', reps=2)
+
+  def native(e):
+    assert e.code == 418
+    assert e.headers['X-Test'] == 'yes'
+    assert e.read() == b'teapot'
+
+  run_fail_test(native, URL, endpoint='/response', reps=2)
+
+
+def test_request(http_server):
+  req = request.Request(f'{URL}/request?a=1', headers={'X-Test': 'value'})
+
+  def f(resp):
+    assert resp.read() == b'GET /request a=1 HTTP/1.1 value'
+
+  run_req_test(f, req, reps=2)
+
+  def caps(resp):
+    assert resp.read() == b'user 42'
+
+  run_req_test(caps, URL, endpoint='/users/42', reps=2)
+
+
+def test_params(http_server):
+  req = request.Request(f'{URL}/params?a=1&b=%2F&a=2', data=b'k=v+w&k2=%41')
+
+  def f(resp):
+    assert resp.read().decode() == repr(
+        (['1', '2'], '/', [('k', 'v w'), ('k2', 'A')], b'k=v+w&k2=%41'))
+
+  run_req_test(f, req, reps=2)
+
+
+def test_multipart(http_server):
+  body = (b'--zz\r\nContent-Disposition: form-data; name="a"\r\n\r\n'
+          b'value\r\n--zz\r\nContent-Disposition: form-data; name="f"; '
+          b'filename="x.bin"\r\n\r\n' + b'\0' * 100000 + b'\r\n--zz--')
+  req = request.Request(
+      f'{URL}/upload', data=body,
+      headers={'Content-Type': 'multipart/form-data; boundary="zz"'})
+
+  def f(resp):
+    assert resp.read() == b"[('a', None, 5), ('f', 'x.bin', 100000)]"
+
+  run_req_test(f, req, reps=2)
+
+
+def test_body(http_server):
+  data = b'{"some": "json"}'
+  req = request.Request(f'{URL}/echo', data=data,
+                        headers={'Content-Type': 'application/json'})
+
+  def f(resp):
+    assert resp.headers['Content-Type'] == 'application/json'
+    assert resp.read() == data
+
+  run_req_test(f, req, reps=2)
+
+
+def test_big_and_head(http_server):
+  def big(resp):
+    assert resp.read() == b'x' * (1 << 20)
+
+  run_req_test(big, URL, endpoint='/big', reps=2)
+
+  def head(resp):
+    assert resp.headers['Content-Length'] == '11'
+    assert resp.read() == b''
+
+  req = request.Request(f'{URL}/hello', method='HEAD')
+  run_req_test(head, req, reps=2)
+
+
+def test_json(http_server):
+  expected = {'a': [1, 2.5, None, True], 's': 'q"\n\u00e9', '1': {}}
+
+  def f(resp):
+    assert resp.headers['Content-Type'] == 'application/json'
+    body = resp.read()
+    assert int(resp.headers['Content-Length']) == len(body)
+    assert json.loads(body) == expected
+
+  run_req_test(f, URL, endpoint='/json', reps=2)
+
+  def created(resp):
+    assert resp.status == 201
+    assert resp.headers['Content-Type'] == 'application/x-test'
+    assert resp.read() == b'[]'
+
+  run_req_test(created, URL, endpoint='/json_created', reps=2)
+
+  def head(resp):
+    assert int(resp.headers['Content-Length']) > 0
+    assert resp.read() == b''
+
+  req = request.Request(f'{URL}/json', method='HEAD')
+  run_req_test(head, req, reps=2)
+
+  def server_error(e):
+    assert e.code == 500
+
+  run_fail_test(server_error, URL, endpoint='/json_bad', reps=1)
+
+
+def test_json_body(http_server):
+  doc = {'key': [{'key': 1}, {'key': 'é'}], 'n': -12.5e3, 'big': 10**30}
+  req = request.Request(f'{URL}/json_echo',
+                        data=json.dumps(doc).encode(),
+                        headers={'Content-Type': 'application/json'})
+
+  def f(resp):
+    assert json.loads(resp.read()) == doc
+
+  run_req_test(f, req, reps=2)
+
+
+def test_errors(http_server):
+  def not_found(e):
+    assert e.code == 404
+
+  run_fail_test(not_found, URL, endpoint='/nope', reps=2)
+
+  def server_error(e):
+    assert e.code == 500
+
+  run_fail_test(server_error, URL, endpoint='/bad_status', reps=1)
+  run_fail_test(server_error, URL, endpoint='/raise', reps=1)
@@ -0,0 +1,99 @@
+import os
+import shutil
+import subprocess
+import sys
+from pathlib import Path
+from urllib import request
+
+import pytest
+
+import velocem
+from apps import wsgi
+
+from util import spawn_server, server_raises, run_req_test
+
+URL = 'http://localhost:8010'
+ROOT = Path(__file__).parent
+PLUGIN_SRC = ROOT / 'plugins' / 'testplugin.c'
+
+
+def build_plugin(out_dir, *defines):
+  cc = shutil.which(os.environ.get('CC', 'cc'))
+  if not cc or sys.platform == 'win32':
+    pytest.skip('No C compiler to build the test plugin with')
+  out = out_dir / 'testplugin.so'
+  subprocess.run([cc, '-shared', '-fPIC', f'-I{ROOT.parent / "include"}',
+                  *(f'-D{define}' for define in defines), '-o', str(out),
+                  str(PLUGIN_SRC)], check=True)
+  return str(out)
+
+
+@pytest.fixture(scope='module')
+def plugin_server(tmp_path_factory):
+  plugin = build_plugin(tmp_path_factory.mktemp('plugin'))
+  with spawn_server(velocem.wsgi, wsgi.app, 8010, plugins=[plugin],
+                    body_spill=1024) as p:
+    yield p
+
+
+def test_plugin_exact(plugin_server):
+  def pong(resp):
+    assert resp.headers['Content-Type'] == 'text/plain'
+    assert resp.read() == b'pong'
+
+  run_req_test(pong, f'{URL}/plugin/ping', reps=2)
+
+  def head(resp):
+    assert resp.headers['Content-Length'] == '4'
+    assert resp.read() == b''
+
+  req = request.Request(f'{URL}/plugin/ping', method='HEAD')
+  run_req_test(head, req, reps=2)
+
+
+def test_plugin_prefix(plugin_server):
+  def echo(path, body):
+    def f(resp):
+      assert resp.status == 201
+      assert resp.headers['X-Path'] == path
+      assert resp.read() == b'plugin ' + body
+
+    return f
+
+  for path in ('/echo', '/echo/a/b'):
+    req = request.Request(f'{URL}{path}', b'data')
+    run_req_test(echo(path, b'data'), req, reps=2)
+
+  req = request.Request(f'{URL}/echo/get')
+  run_req_test(echo('/echo/get', b''), req, reps=2)
+
+
+def test_plugin_declined(plugin_server):
+  def app(resp):
+    assert resp.read() == b'Hello World'
+
+  run_req_test(app, f'{URL}/hello', reps=2)
+
+  def plugin(resp):
+    assert resp.read() == b'plugin hello'
+
+  req = request.Request(f'{URL}/hello', headers={'X-Plugin': '1'})
+  run_req_test(plugin, req, reps=2)
+
+
+def test_plugin_spilled(plugin_server):
+  body = b'x' * 4096
+
+  def app(resp):
+    assert resp.status == 200
+    assert resp.headers['X-Path'] is None
+    assert resp.read() == body
+
+  req = request.Request(f'{URL}/echo', body)
+  run_req_test(app, req, reps=2)
+
+
+def test_plugin_abi(tmp_path):
+  plugin = build_plugin(tmp_path, 'TESTPLUGIN_BAD_ABI')
+  assert server_raises(ImportError, velocem.wsgi, wsgi.app, 8012,
+                       plugins=[plugin])
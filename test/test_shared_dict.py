@@ -0,0 +1,69 @@
+import multiprocessing
+import time
+
+import pytest
+
+import velocem
+
+
+def test_basic():
+  d = velocem.SharedDict(1 << 16)
+  d['a'] = b'bytes'
+  d[b'b'] = 'str'
+  d.set('c', 3)
+  d.set('d', 1.5)
+  assert d['a'] == b'bytes'
+  assert d['b'] == 'str'
+  assert d[b'c'] == 3
+  assert d.get('d') == 1.5
+  assert d.get('missing', 7) == 7
+  assert 'a' in d and 'missing' not in d
+  assert len(d) == 4
+
+  del d['a']
+  assert 'a' not in d
+  assert not d.delete('a')
+  with pytest.raises(KeyError):
+    d['a']
+
+  with pytest.raises(TypeError):
+    d['x'] = [1]
+  with pytest.raises(ValueError):
+    d['x'] = b'x' * 1024
+
+  d.clear()
+  assert len(d) == 0
+
+
+def test_ttl():
+  d = velocem.SharedDict(1 << 16)
+  d.set('a', 1, ttl=0.05)
+  assert d['a'] == 1
+  time.sleep(0.1)
+  assert 'a' not in d
+
+
+def test_incr():
+  d = velocem.SharedDict(1 << 16)
+  assert d.incr('n') == 1
+  assert d.incr('n', 5) == 6
+  assert d.incr('m', init=10) == 11
+  d['s'] = 'str'
+  with pytest.raises(TypeError):
+    d.incr('s')
+
+
+def count(d, n):
+  for _ in range(n):
+    d.incr('hits')
+
+
+def test_shared_across_fork():
+  d = velocem.SharedDict(1 << 16)
+  ctx = multiprocessing.get_context('fork')
+  procs = [ctx.Process(target=count, args=(d, 1000)) for _ in range(4)]
+  for p in procs:
+    p.start()
+  for p in procs:
+    p.join()
+  assert d['hits'] == 4000
@@ -1,11 +1,18 @@
+import gc
+import gzip
+import json
 import pytest
+import socket
+import time
 import multiprocessing
+import weakref
 from urllib import request
 
 import velocem
 from apps import wsgi
 
-from util import wait_for_server, run_req_test, run_fail_test
+from util import (wait_for_server, spawn_server, server_raises, run_req_test,
+                  run_fail_test)
 
 
 def serv():
@@ -21,6 +28,70 @@ def wsgi_server():
   p.kill()
 
 
+@pytest.fixture(scope='module')
+def etag_server():
+  with spawn_server(velocem.wsgi, wsgi.app, 8001, etag=True,
+                    ranges=True) as p:
+    yield p
+
+
+@pytest.fixture(scope='module')
+def compress_server():
+  with spawn_server(velocem.wsgi, wsgi.app, 8002, compress=6) as p:
+    yield p
+
+
+STATIC_ROUTES = {
+    '/health': ('200 OK', [('Content-Type', 'text/plain')], b'ok'),
+    '/hello': ('203 Non-Authoritative Information', [], b'static'),
+    '/empty': ('204 No Content', [('X-Static', 'yes')], b''),
+}
+
+
+@pytest.fixture(scope='module')
+def native_server():
+  with spawn_server(velocem.wsgi, wsgi.app, 8003, microcache=1 << 20,
+                    static_routes=STATIC_ROUTES) as p:
+    yield p
+
+
+@pytest.fixture(scope='module')
+def router_server():
+  with spawn_server(velocem.wsgi, wsgi.native_router, 8005) as p:
+    yield p
+
+
+MOUNTS = {
+    '/api': wsgi.mounted('api'),
+    '/api/v2/': wsgi.mounted('v2'),
+    'Mounts.Test/api': wsgi.mounted('host'),
+    '/r': wsgi.native_router,
+    '/c': wsgi.app,
+}
+
+
+@pytest.fixture(scope='module')
+def mounts_server():
+  with spawn_server(velocem.wsgi, None, 8007, mounts=MOUNTS,
+                    microcache=1 << 20) as p:
+    yield p
+
+
+STATIC_JS = b'console.log("static")'
+
+
+@pytest.fixture(scope='module')
+def static_server(tmp_path_factory):
+  root = tmp_path_factory.mktemp('assets')
+  (root / 'app.js').write_bytes(STATIC_JS)
+  (root / 'app.js.gz').write_bytes(gzip.compress(STATIC_JS))
+  (root / 'css').mkdir()
+  (root / 'css' / 'site.css').write_bytes(b'body {}')
+  with spawn_server(velocem.wsgi, wsgi.app, 8009,
+                    static_dirs={'/assets': str(root)}):
+    yield root
+
+
 def root_OK():
   def f(resp):
     assert resp.read() == b''
@@ -52,6 +123,20 @@ def test_generator(wsgi_server):
   run_req_test(check_hello, endpoint='/generator')
 
 
+def test_buffer_bodies(wsgi_server):
+  blob = wsgi.BLOB
+
+  def check(expected):
+    def f(resp):
+      assert resp.read() == expected
+
+    return f
+
+  run_req_test(check(blob), endpoint='/bytearray')
+  run_req_test(check(blob[256:1256]), endpoint='/memoryview')
+  run_req_test(check(blob[:100] + b'Hello' + blob), endpoint='/buffer_chunks')
+
+
 def test_call_close(wsgi_server):
   run_req_test(check_hello, endpoint='/call_close')
 
@@ -76,6 +161,645 @@ def test_echo(wsgi_server):
   run_req_test(f, req)
 
 
+def test_echo_large(wsgi_server):
+  body = bytes(range(256)) * 1024
+  req = request.Request('http://localhost:8000/echo', body)
+
+  def f(resp):
+    assert resp.read() == body
+
+  run_req_test(f, req)
+
+
+def test_readinto(wsgi_server):
+  req = request.Request('http://localhost:8000/echo_readinto', b'Hello World')
+  run_req_test(check_hello, req)
+
+
+def test_getbuffer(wsgi_server):
+  req = request.Request('http://localhost:8000/echo_getbuffer', b'Hello World')
+  run_req_test(check_hello, req)
+
+
+def test_json_body(wsgi_server):
+  doc = {'a': [1, 2.5, None, True, 'é\n'], 'b': [{'k': 1}, {'k': 2}]}
+  data = json.dumps(doc, ensure_ascii=False).encode()
+  req = request.Request('http://localhost:8000/echo_json', data)
+
+  def f(resp):
+    assert resp.read().decode() == repr(doc)
+
+  run_req_test(f, req)
+
+  req = request.Request('http://localhost:8000/echo_json', b'{"a": 1,}')
+
+  def bad(e):
+    assert e.code == 400
+    assert e.read() == b'JSONDecodeError'
+
+  run_fail_test(bad, req, reps=1)
+
+  # Escaped lone surrogates are accepted as json.loads() does
+  req = request.Request('http://localhost:8000/echo_json', b'"\\ud800"')
+
+  def lone(resp):
+    assert resp.read().decode() == repr('\ud800')
+
+  run_req_test(lone, req, reps=1)
+
+
+def test_query_dict(wsgi_server):
+  req = request.Request('http://localhost:8000/form?a=1&a=%26&b=x+y',
+                        b'x=%C3%A9&y')
+
+  def f(resp):
+    assert resp.read().decode() == repr(
+        ('a=1&a=%26&b=x+y', ['1', '&'], 'x y', False, 'é',
+         [('x', 'é'), ('y', '')]))
+
+  run_req_test(f, req)
+
+
+def multipart(boundary, *parts):
+  body = b''
+  for name, filename, data in parts:
+    body += f'--{boundary}\r\n'.encode()
+    disp = f'Content-Disposition: form-data; name="{name}"'
+    if filename:
+      disp += f'; filename="{filename}"\r\nContent-Type: text/plain'
+    body += disp.encode() + b'\r\n\r\n' + data + b'\r\n'
+  return body + f'--{boundary}--\r\n'.encode()
+
+
+def test_multipart(wsgi_server):
+  data = bytes(range(256)) * 256 + b'\r\n--bound'
+  body = multipart('bound-x', ('field', None, 'é'.encode()),
+                   ('upload', 'a.txt', data))
+  req = request.Request(
+      'http://localhost:8000/upload', body,
+      {'Content-Type': 'multipart/form-data; boundary=bound-x'})
+
+  def f(resp):
+    assert resp.read().decode() == repr(
+        [('field', None, None, 'é'), ('upload', 'a.txt', 'text/plain', data)])
+
+  run_req_test(f, req)
+
+  body = multipart('b', ('field', None, b'x' * 17))
+  req = request.Request('http://localhost:8000/upload', body,
+                        {'Content-Type': 'multipart/form-data; boundary=b'})
+
+  def too_big(e):
+    assert e.code == 400
+    assert e.read() == b'Multipart field exceeds 16 bytes'
+
+  run_fail_test(too_big, req, reps=1)
+
+
+def test_repeated_headers(wsgi_server):
+  for query in ('a', 'bcd', 'a', 'efghij'):
+    def f(resp):
+      assert resp.headers['Content-Type'] == 'text/plain'
+      assert resp.headers['Content-Length'] == str(len(query))
+      assert resp.read() == query.encode('ascii')
+
+    run_req_test(f, endpoint=f'/conlen?{query}')
+
+
+GOOD_HEADERS = [
+    ('X-Test', 'value'),
+    ('X-Test', ''),
+    ('X-Test', 'tab\there'),
+    ('X-Test', 'caf\xe9'),
+    ('X-Test', 'a' * 100),
+    ("!#$%&'*+-.^_`|~09azAZ", 'value'),
+    ('X-' + 'a' * 40, 'value'),
+]
+
+BAD_HEADERS = [
+    ('X-Test', 'a\r\nInjected: yes'),
+    ('X-Test', 'a\nb'),
+    ('X-Test', 'a\rb'),
+    ('X-Test', 'a\x00b'),
+    ('X-Test', 'a\x7fb'),
+    ('X-Test', 'a' * 40 + '\n'),
+    ('X-Test', '\u20ac'),
+    ('', 'value'),
+    ('X Test', 'value'),
+    ('X-Test:', 'value'),
+    ('X-Test\r\nInjected', 'value'),
+    ('X-' + 'a' * 40 + '(', 'value'),
+    ('Content-Length', '0\r\nInjected: yes'),
+]
+
+
+def header_request(**spec):
+  return request.Request('http://localhost:8000/header',
+                         data=json.dumps(spec).encode(), method='POST')
+
+
+@pytest.mark.parametrize('name,value', GOOD_HEADERS)
+def test_header_good(wsgi_server, name, value):
+  req = header_request(name=name, value=value)
+
+  def f(resp):
+    assert resp.headers[name] == value
+
+  run_req_test(f, req, reps=2)
+
+
+@pytest.mark.parametrize('name,value', BAD_HEADERS)
+def test_header_bad(wsgi_server, name, value):
+  req = header_request(name=name, value=value)
+
+  def f(e):
+    assert e.code == 500
+    assert 'Injected' not in e.headers
+
+  run_fail_test(f, req, reps=2)
+
+
+def test_status_bad(wsgi_server):
+  req = header_request(status='200 OK\r\nInjected: yes', name='X-Test',
+                       value='value')
+
+  def f(e):
+    assert e.code == 500
+
+  run_fail_test(f, req, reps=2)
+
+
+def test_head(wsgi_server):
+  req = request.Request('http://localhost:8000/hello', method='HEAD')
+
+  def f(resp):
+    assert resp.headers['Content-Length'] == '11'
+    assert resp.read() == b''
+
+  run_req_test(f, req)
+
+
+def test_etag(etag_server):
+  url = 'http://localhost:8001/hello'
+  with request.urlopen(url) as resp:
+    etag = resp.headers['ETag']
+    assert resp.read() == b'Hello World'
+  assert etag and etag.startswith('"')
+
+  def f(e):
+    assert e.code == 304
+    assert e.headers['ETag'] == etag
+
+  for inm in (etag, f'W/{etag}', f'"nope", {etag}', '*'):
+    req = request.Request(url, headers={'If-None-Match': inm})
+    run_fail_test(f, req, reps=2)
+
+  req = request.Request(url, headers={'If-None-Match': '"nope"'})
+  run_req_test(check_hello, req, reps=2)
+
+
+def test_range(etag_server):
+  blob = wsgi.BLOB
+  url = 'http://localhost:8001/bytearray'
+
+  def part(first, last):
+    def f(resp):
+      assert resp.status == 206
+      crange = f'bytes {first}-{last}/{len(blob)}'
+      assert resp.headers['Content-Range'] == crange
+      assert resp.read() == blob[first:last + 1]
+
+    return f
+
+  end = len(blob) - 1
+  cases = [
+      ('bytes=0-99', 0, 99),
+      ('bytes=-10', end - 9, end),
+      ('bytes=65000-', 65000, end),
+      ('bytes=50-99,0-49', 0, 99),
+      ('bytes=0-59,40-99', 0, 99),
+  ]
+  for rng, first, last in cases:
+    req = request.Request(url, headers={'Range': rng})
+    run_req_test(part(first, last), req, reps=2)
+
+  def multi(resp):
+    assert resp.status == 206
+    ctype = resp.headers['Content-Type']
+    assert ctype.startswith('multipart/byteranges; boundary=')
+    body = resp.read()
+    assert blob[0:10] in body and blob[100:120] in body
+    assert f'Content-Range: bytes 100-119/{len(blob)}'.encode() in body
+
+  req = request.Request(url, headers={'Range': 'bytes=0-9,100-119'})
+  run_req_test(multi, req)
+
+  def unsatisfiable(e):
+    assert e.code == 416
+    assert e.headers['Content-Range'] == f'bytes */{len(blob)}'
+
+  req = request.Request(url, headers={'Range': f'bytes={len(blob)}-'})
+  run_fail_test(unsatisfiable, req)
+
+  def full(resp):
+    assert resp.status == 200
+    assert resp.read() == blob
+
+  req = request.Request(url, headers={'Range': 'bytes=0-9', 'If-Range': '"x"'})
+  run_req_test(full, req)
+
+  overlapping = 'bytes=' + ','.join(['0-'] * 16)
+  req = request.Request(url, headers={'Range': overlapping})
+  run_req_test(full, req)
+
+  # Offsets span write() output and the large body returned after it
+  written = wsgi.TEXT * 9
+  req = request.Request('http://localhost:8001/text_written',
+                        headers={'Range': 'bytes=6100-6199'})
+
+  def spanning(resp):
+    assert resp.status == 206
+    crange = f'bytes 6100-6199/{len(written)}'
+    assert resp.headers['Content-Range'] == crange
+    assert resp.read() == written[6100:6200]
+
+  run_req_test(spanning, req, reps=2)
+
+
+def test_file_wrapper(etag_server):
+  with open(wsgi.__file__, 'rb') as f:
+    data = f.read()
+  url = 'http://localhost:8001/file'
+
+  def f(resp):
+    assert resp.read() == data
+
+  run_req_test(f, request.Request(url), reps=2)
+
+  def part(resp):
+    assert resp.status == 206
+    assert resp.read() == data[10:30]
+
+  run_req_test(part, request.Request(url, headers={'Range': 'bytes=10-29'}))
+
+
+def test_compress(compress_server):
+  def compressed(resp):
+    assert resp.headers['Content-Encoding'] == 'gzip'
+    assert resp.headers['Vary'] == 'Accept-Encoding'
+    body = resp.read()
+    assert len(body) < len(wsgi.TEXT)
+    assert gzip.decompress(body) == wsgi.TEXT
+
+  def identity(resp):
+    assert 'Content-Encoding' not in resp.headers
+    assert resp.headers['Vary'] == 'Accept-Encoding'
+    assert resp.read() == wsgi.TEXT
+
+  for endpoint in ('/text', '/text_stream'):
+    url = f'http://localhost:8002{endpoint}'
+    for enc in ('gzip', 'br, gzip;q=0.5', '*'):
+      req = request.Request(url, headers={'Accept-Encoding': enc})
+      run_req_test(compressed, req, reps=2)
+    for enc in ('identity', 'gzip;q=0', 'br'):
+      req = request.Request(url, headers={'Accept-Encoding': enc})
+      run_req_test(identity, req, reps=2)
+
+  # write() output ahead of a large returned body goes in the same stream
+  def written(resp):
+    assert resp.headers['Content-Encoding'] == 'gzip'
+    assert gzip.decompress(resp.read()) == wsgi.TEXT * 9
+
+  req = request.Request('http://localhost:8002/text_written',
+                        headers={'Accept-Encoding': 'gzip'})
+  run_req_test(written, req, reps=2)
+
+  def untouched(resp):
+    assert 'Content-Encoding' not in resp.headers
+    assert resp.read() == wsgi.BLOB
+
+  req = request.Request('http://localhost:8002/bytearray',
+                        headers={'Accept-Encoding': 'gzip'})
+  run_req_test(untouched, req, reps=2)
+
+
+def test_microcache(native_server):
+  def fetch(url, headers={}):
+    with request.urlopen(request.Request(url, headers=headers)) as resp:
+      return resp.read()
+
+  url = 'http://localhost:8003/cached'
+  first = fetch(url)
+  assert all(fetch(url) == first for _ in range(5))
+
+  en = fetch(url, {'X-Lang': 'en'})
+  assert en.startswith(b'en') and en != first
+  assert fetch(url, {'X-Lang': 'en'}) == en
+  assert fetch(url) == first
+
+  # Query strings are part of the key, conditional requests bypass the cache
+  assert fetch(f'{url}?a') != first
+  assert fetch(url, {'If-None-Match': '"x"'}) != first
+
+
+def test_static_routes(native_server):
+  def health(resp):
+    assert resp.headers['Content-Type'] == 'text/plain'
+    assert resp.headers['Content-Length'] == '2'
+    assert bool(resp.headers['Date'])
+    assert resp.read() == b'ok'
+
+  run_req_test(health, 'http://localhost:8003/health', reps=3)
+
+  def head(resp):
+    assert resp.headers['Content-Length'] == '2'
+    assert resp.read() == b''
+
+  req = request.Request('http://localhost:8003/health?probe', method='HEAD')
+  run_req_test(head, req, reps=2)
+
+  def hello(resp):
+    assert resp.status == 203
+    assert resp.read() == b'static'
+
+  run_req_test(hello, 'http://localhost:8003/hello', reps=2)
+
+  def empty(resp):
+    assert resp.status == 204
+    assert resp.headers['X-Static'] == 'yes'
+    assert 'Content-Length' not in resp.headers
+
+  run_req_test(empty, 'http://localhost:8003/empty', reps=2)
+
+
+def test_static_routes_invalid():
+  bad_header = {'/bad': ('200 OK', [('X', 'a\nb')], b'')}
+  assert server_raises(ValueError, velocem.wsgi, wsgi.app, 8004,
+                       static_routes=bad_header)
+
+  bad_body = {'/bad': ('304 Not Modified', [], b'body')}
+  assert server_raises(ValueError, velocem.wsgi, wsgi.app, 8004,
+                       static_routes=bad_body)
+
+
+def test_router(router_server):
+  def user(resp):
+    assert resp.read() == b'user 42'
+
+  run_req_test(user, 'http://localhost:8005/users/42', reps=2)
+
+  def me(resp):
+    assert resp.read() == b'me'
+
+  run_req_test(me, 'http://localhost:8005/users/me', reps=2)
+
+  def files(resp):
+    assert resp.read() == b'a/b/c.txt'
+
+  run_req_test(files, 'http://localhost:8005/files/a/b/c.txt', reps=2)
+
+  def head(resp):
+    assert resp.status == 200
+    assert resp.read() == b''
+
+  req = request.Request('http://localhost:8005/users/7', method='HEAD')
+  run_req_test(head, req, reps=2)
+
+  def put(resp):
+    assert resp.read() == b'PUT widget'
+
+  req = request.Request('http://localhost:8005/items/widget', method='PUT')
+  run_req_test(put, req, reps=2)
+
+
+def test_router_miss(router_server):
+  def not_found(e):
+    assert e.code == 404
+    assert e.headers['Content-Length'] == '0'
+
+  run_fail_test(not_found, 'http://localhost:8005/users/abc', reps=2)
+  run_fail_test(not_found, 'http://localhost:8005/nope', reps=2)
+
+  def not_allowed(e):
+    assert e.code == 405
+    assert e.headers['Allow'] == 'GET, HEAD'
+
+  req = request.Request('http://localhost:8005/users/42', data=b'',
+                        method='POST')
+  run_fail_test(not_allowed, req, reps=2)
+
+
+def test_router_gc():
+  class Handler:
+    def __init__(self, router):
+      self.router = router
+
+    def __call__(self, environ, start_response):
+      pass
+
+  router = velocem.Router()
+  handler = Handler(router)
+  router.add('/users/{id:int}', handler)
+  ref = weakref.ref(handler)
+  del router, handler
+  gc.collect()
+  assert ref() is None
+
+
+def test_mounts(mounts_server):
+  def expect(body):
+    def f(resp):
+      assert resp.read() == body
+
+    return f
+
+  url = 'http://localhost:8007'
+  run_req_test(expect(b'api /api /users'), f'{url}/api/users', reps=2)
+  run_req_test(expect(b'api /api '), f'{url}/api', reps=2)
+  run_req_test(expect(b'v2 /api/v2 /x/y'), f'{url}/api/v2/x/y', reps=2)
+  run_req_test(expect(b'user 42'), f'{url}/r/users/42', reps=2)
+
+  req = request.Request(f'{url}/api/users', headers={'Host': 'mounts.test:1'})
+  run_req_test(expect(b'host /api /users'), req, reps=2)
+
+  def not_found(e):
+    assert e.code == 404
+
+  run_fail_test(not_found, f'{url}/apix', reps=2)
+  run_fail_test(not_found, f'{url}/', reps=2)
+
+
+def test_mounts_microcache(mounts_server):
+  def fetch(url, headers={}):
+    with request.urlopen(request.Request(url, headers=headers)) as resp:
+      return resp.read()
+
+  # Keys come from the full request, not the PATH_INFO the mounted app sees
+  url = 'http://localhost:8007/c/cached'
+  first = fetch(url)
+  assert fetch(url) == first
+
+  en = fetch(f'{url}?a', {'X-Lang': 'en'})
+  assert en.startswith(b'en') and en != first
+  assert fetch(f'{url}?a', {'X-Lang': 'en'}) == en
+  assert fetch(f'{url}?a') not in (first, en)
+  assert fetch(url) == first
+
+
+def test_mounts_invalid():
+  with pytest.raises(TypeError):
+    velocem.wsgi(None, port='8008')
+  with pytest.raises(TypeError):
+    velocem.wsgi(None, port='8008', mounts={'/x': 'not an app'})
+
+
+def test_static_dirs(static_server):
+  url = 'http://localhost:8009/assets'
+  tags = {}
+
+  def css(resp):
+    assert resp.read() == b'body {}'
+    assert resp.headers['Content-Type'] == 'text/css; charset=utf-8'
+    assert resp.headers['Vary'] is None
+    tags['etag'] = resp.headers['ETag']
+    tags['lm'] = resp.headers['Last-Modified']
+
+  run_req_test(css, f'{url}/css/site.css', reps=2)
+  run_req_test(css, f'{url}//./css/site.css', reps=2)
+
+  def plain(resp):
+    assert resp.read() == STATIC_JS
+    assert resp.headers['Content-Encoding'] is None
+    assert resp.headers['Vary'] == 'Accept-Encoding'
+
+  run_req_test(plain, f'{url}/app.js', reps=2)
+
+  def gzipped(resp):
+    assert gzip.decompress(resp.read()) == STATIC_JS
+    assert resp.headers['Content-Encoding'] == 'gzip'
+
+  req = request.Request(f'{url}/app.js', headers={'Accept-Encoding': 'gzip'})
+  run_req_test(gzipped, req, reps=2)
+
+  def partial(resp):
+    assert resp.status == 206
+    assert resp.read() == STATIC_JS[:7]
+
+  req = request.Request(f'{url}/app.js', headers={'Range': 'bytes=0-6'})
+  run_req_test(partial, req, reps=2)
+
+  def not_modified(e):
+    assert e.code == 304
+
+  for hdr, val in (('If-None-Match', tags['etag']),
+                   ('If-Modified-Since', tags['lm'])):
+    req = request.Request(f'{url}/css/site.css', headers={hdr: val})
+    run_fail_test(not_modified, req, reps=2)
+
+  def not_found(e):
+    assert e.code == 404
+
+  for path in ('/css', '/missing.js', '/%2e%2e/apps/wsgi.py',
+               '/css%5csite.css'):
+    run_fail_test(not_found, f'{url}{path}', reps=2)
+
+  # Misses are cached too, but revalidated like hits
+  run_fail_test(not_found, f'{url}/late.txt', reps=2)
+  (static_server / 'late.txt').write_bytes(b'late')
+  time.sleep(1.5)
+
+  def late(resp):
+    assert resp.read() == b'late'
+
+  run_req_test(late, f'{url}/late.txt', reps=2)
+
+  def not_allowed(e):
+    assert e.code == 405
+
+  req = request.Request(f'{url}/app.js', data=b'', method='POST')
+  run_fail_test(not_allowed, req, reps=2)
+
+  def app(resp):
+    assert resp.read() == b'Hello World'
+
+  run_req_test(app, 'http://localhost:8009/hello', reps=2)
+
+
+def test_channel(wsgi_server):
+  def post(path, body=b''):
+    req = request.Request(f'http://localhost:8000{path}', data=body)
+    with request.urlopen(req) as resp:
+      return resp.read()
+
+  def read_until(sock, buf, marker):
+    while marker not in buf:
+      data = sock.recv(4096)
+      assert data
+      buf += data
+    return buf
+
+  with socket.create_connection(('localhost', 8000)) as sub:
+    sub.sendall(b'GET /subscribe HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    buf = read_until(sub, b'', b'retry: 1000\n\n\r\n')
+    assert b'Transfer-Encoding: chunked' in buf
+    assert b'Content-Length' not in buf
+
+    assert post('/publish', b'one') == b'1'
+    buf = read_until(sub, buf, b'data: one\n\n\r\n')
+
+    # The parked connection is reusable once the channel is closed
+    post('/unsubscribe')
+    buf = read_until(sub, buf, b'\r\n0\r\n\r\n')
+    sub.sendall(b'GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    read_until(sub, buf, b'Hello World')
+
+  # A request pipelined behind the channel is answered once it closes
+  with socket.create_connection(('localhost', 8000)) as sub:
+    sub.sendall(b'GET /subscribe HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    buf = read_until(sub, b'', b'retry: 1000\n\n\r\n')
+    sub.sendall(b'GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    time.sleep(0.1)
+    post('/unsubscribe')
+    buf = read_until(sub, buf, b'\r\n0\r\n\r\n')
+    read_until(sub, buf, b'Hello World')
+
+  # Sending something first doesn't hide the hang up that follows it
+  with socket.create_connection(('localhost', 8000)) as sub:
+    sub.sendall(b'GET /subscribe HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    read_until(sub, b'', b'retry: 1000\n\n\r\n')
+    sub.sendall(b'GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    time.sleep(0.1)
+
+  # The subscriber hung up, so it's dropped on the first publish
+  for _ in range(50):
+    if post('/publish', b'two') == b'0':
+      break
+    time.sleep(0.01)
+  assert post('/publish', b'three') == b'0'
+
+  # A subscriber which never reads is cut off once too far behind
+  with socket.create_connection(('localhost', 8000)) as sub:
+    sub.sendall(b'GET /subscribe HTTP/1.1\r\nHost: localhost\r\n\r\n')
+    read_until(sub, b'', b'retry: 1000\n\n\r\n')
+    chunk = b'x' * (1 << 20)
+    for _ in range(256):
+      if post('/publish', chunk) == b'0':
+        break
+    else:
+      assert False, 'Slow subscriber was never dropped'
+
+
+def test_router_invalid():
+  r = velocem.Router()
+  with pytest.raises(ValueError):
+    r.add('/x/{id:float}', wsgi.user)
+  with pytest.raises(ValueError):
+    r.add('/x', wsgi.user, methods='FETCH')
+  r.add('/x/{id}', wsgi.user)
+  with pytest.raises(ValueError):
+    r.add('/x/{other}', wsgi.user)
+
+
 def test_required_headers(wsgi_server):
   serv = f'Velocem/{velocem.__version__}'
 
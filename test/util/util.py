@@ -1,6 +1,9 @@
+import sys
 import time
 import socket
+import multiprocessing
 
+from contextlib import contextmanager
 from itertools import repeat
 from urllib import request, error
 
@@ -16,6 +19,40 @@ def wait_for_server(server, port, sleep=0.5):
       break
 
 
+@contextmanager
+def spawn_server(serve, app, port, **kwargs):
+  p = multiprocessing.Process(target=serve, args=(app,),
+                              kwargs={'port': str(port), **kwargs})
+  p.start()
+  try:
+    wait_for_server('localhost', port)
+    yield p
+  finally:
+    p.kill()
+
+
+def _expect_raise(serve, app, exc, kwargs):
+  try:
+    serve(app, **kwargs)
+  except exc:
+    sys.exit(0)
+  sys.exit(1)
+
+
+# Servers which are supposed to fail on startup still run in a child, one that
+# starts serving instead is killed after timeout seconds
+def server_raises(exc, serve, app, port, *, timeout=10, **kwargs):
+  p = multiprocessing.Process(target=_expect_raise,
+                              args=(serve, app, exc,
+                                    {'port': str(port), **kwargs}))
+  p.start()
+  p.join(timeout)
+  if p.exitcode is None:
+    p.kill()
+    p.join()
+  return p.exitcode == 0
+
+
 def Empty(resp):
   pass
 